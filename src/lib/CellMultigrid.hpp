@@ -0,0 +1,363 @@
+#pragma once
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/base/utilities.h>
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/lac/dynamic_sparsity_pattern.h>
+#include <deal.II/lac/trilinos_vector.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+#include <deal.II/lac/trilinos_precondition.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+
+
+namespace LinearSolvers
+{
+using namespace dealii;
+
+
+/*
+ * Multigrid preconditioner for the cell-centered (DG0) pressure
+ * operator on the cell hierarchy of the p4est forest.
+ * Coarse cells are the parents of the finest cells: on each level the
+ * cells of the finest remaining refinement level are merged with their
+ * locally owned siblings, coarser cells are kept. Families split between
+ * processes give one coarse cell per process.
+ * The prolongation is the piecewise constant injection smoothed with the
+ * transmissibilities: P = (I - w D^{-1} A) P0, so a fine cell also takes
+ * the values of the neighboring coarse cells in proportion to its face
+ * transmissibilities. Restriction is P^T and the coarse operators are
+ * Galerkin products P^T A P.
+ * The V-cycle uses Chebyshev smoothing in D^{-1} A and one AMG cycle
+ * on the coarsest level. The cycle is symmetric, so it can be used in CG.
+ * The aggregates are built once per mesh (reinit), the level operators
+ * once per matrix (initialize).
+ */
+template <int dim>
+class CellMultigrid
+{
+ public:
+  CellMultigrid(MPI_Comm &mpi_communicator_);
+  // build the cell aggregates of all levels
+  void reinit(const std::vector<typename DoFHandler<dim>::active_cell_iterator> &owned_cells,
+              const std::vector<unsigned int>                                  &cell_dofs,
+              const IndexSet                                                   &locally_owned_dofs);
+  // prolongations, level operators, smoothers, and coarse solver
+  void initialize(const TrilinosWrappers::SparseMatrix &matrix);
+  // one V-cycle with zero initial guess
+  void vmult(TrilinosWrappers::MPI::Vector       &dst,
+             const TrilinosWrappers::MPI::Vector &src) const;
+  unsigned int n_levels() const;
+
+ private:
+  typedef typename DoFHandler<dim>::cell_iterator cell_iterator;
+  // level operator
+  const TrilinosWrappers::SparseMatrix & get_matrix(const unsigned int level) const;
+  // smoothed prolongation from level + 1 to level
+  void build_prolongation(const unsigned int level);
+  // largest eigenvalue of D^{-1} A by power iteration
+  double estimate_max_eigenvalue(const unsigned int level);
+  void v_cycle(const unsigned int level) const;
+
+  MPI_Comm                                                     &mpi_communicator;
+  const TrilinosWrappers::SparseMatrix                         *fine_matrix;
+  // owned dofs on each level; level 0 are the pressure dofs
+  std::vector<IndexSet>                                        owned;
+  // coarse dof (global index) of each owned dof of the finer level
+  std::vector< std::vector<types::global_dof_index> >          aggregates;
+  std::vector< std::unique_ptr<TrilinosWrappers::SparseMatrix> > matrices,
+                                                                 prolongations;
+  std::vector< std::unique_ptr<TrilinosWrappers::PreconditionChebyshev> > smoothers;
+  TrilinosWrappers::PreconditionAMG                            coarse_solver;
+  // level vectors of the cycle
+  mutable std::vector<TrilinosWrappers::MPI::Vector>           x, b, r, t;
+};
+
+
+
+template <int dim>
+CellMultigrid<dim>::CellMultigrid(MPI_Comm &mpi_communicator_)
+    :
+    mpi_communicator(mpi_communicator_),
+    fine_matrix(NULL)
+{}  // eom
+
+
+
+template <int dim>
+void
+CellMultigrid<dim>::
+reinit(const std::vector<typename DoFHandler<dim>::active_cell_iterator> &owned_cells,
+       const std::vector<unsigned int>                                  &cell_dofs,
+       const IndexSet                                                   &locally_owned_dofs)
+{
+  // stop coarsening at this global size or when it gets too slow
+  const types::global_dof_index min_coarse_size = 500;
+  const double min_coarsening_ratio = 1.2;
+
+  owned.assign(1, locally_owned_dofs);
+  aggregates.clear();
+
+  // cells of the current level in the order of the owned dofs
+  std::vector<cell_iterator> cells(owned_cells.size());
+  for (unsigned int k=0; k<owned_cells.size(); ++k)
+    cells[locally_owned_dofs.index_within_set(cell_dofs[k])] = owned_cells[k];
+
+  while (true)
+  {
+    int max_level = 0;
+    for (const auto & cell : cells)
+      max_level = std::max(max_level, cell->level());
+    max_level = Utilities::MPI::max(max_level, mpi_communicator);
+    const types::global_dof_index n_fine = owned.back().size();
+    if (max_level == 0 || n_fine <= min_coarse_size)
+      break;
+
+    // merge the cells of the finest level with their siblings
+    std::map< std::pair<int,int>, unsigned int > coarse_index;
+    std::vector<cell_iterator>                   coarse_cells;
+    std::vector<unsigned int>                    local_aggregate(cells.size());
+    for (unsigned int i=0; i<cells.size(); ++i)
+    {
+      const cell_iterator coarse_cell =
+          (cells[i]->level() == max_level) ? cells[i]->parent() : cells[i];
+      const auto key = std::make_pair(coarse_cell->level(), coarse_cell->index());
+      const auto it = coarse_index.find(key);
+      if (it == coarse_index.end())
+      {
+        local_aggregate[i] = coarse_cells.size();
+        coarse_index[key] = coarse_cells.size();
+        coarse_cells.push_back(coarse_cell);
+      }
+      else
+        local_aggregate[i] = it->second;
+    }
+
+    // contiguous global numbering of the coarse dofs
+    unsigned int n_local = coarse_cells.size(), offset = 0;
+    MPI_Exscan(&n_local, &offset, 1, MPI_UNSIGNED, MPI_SUM, mpi_communicator);
+    if (Utilities::MPI::this_mpi_process(mpi_communicator) == 0)
+      offset = 0;
+    const types::global_dof_index n_coarse =
+        Utilities::MPI::sum(n_local, mpi_communicator);
+    if (n_fine < min_coarsening_ratio*n_coarse)
+      break;
+
+    IndexSet coarse_owned(n_coarse);
+    coarse_owned.add_range(offset, offset + n_local);
+    coarse_owned.compress();
+
+    aggregates.push_back(std::vector<types::global_dof_index>(cells.size()));
+    for (unsigned int i=0; i<cells.size(); ++i)
+      aggregates.back()[i] = offset + local_aggregate[i];
+    owned.push_back(coarse_owned);
+    cells.swap(coarse_cells);
+  }
+
+  const unsigned int n = owned.size();
+  matrices.resize(n);
+  prolongations.resize(n - 1);
+  smoothers.resize(n - 1);
+  for (auto * V : {&x, &b, &r, &t})
+  {
+    V->resize(n);
+    for (unsigned int l=0; l<n; ++l)
+      (*V)[l].reinit(owned[l], mpi_communicator);
+  }
+  fine_matrix = NULL;
+}  // eom
+
+
+
+template <int dim>
+inline
+unsigned int
+CellMultigrid<dim>::n_levels() const
+{
+  return owned.size();
+}  // eom
+
+
+
+template <int dim>
+inline
+const TrilinosWrappers::SparseMatrix &
+CellMultigrid<dim>::get_matrix(const unsigned int level) const
+{
+  return (level == 0) ? *fine_matrix : *matrices[level];
+}  // eom
+
+
+
+template <int dim>
+void
+CellMultigrid<dim>::build_prolongation(const unsigned int level)
+{
+  // Jacobi weight of the prolongation smoothing
+  const double omega = 2./3.;
+  const TrilinosWrappers::SparseMatrix &A = get_matrix(level);
+  const IndexSet &fine = owned[level];
+  const IndexSet &coarse = owned[level+1];
+
+  // coarse dofs of the ghost neighbors
+  IndexSet relevant(fine.size());
+  relevant.add_indices(fine);
+  for (auto i = fine.begin(); i != fine.end(); ++i)
+    for (auto entry = A.begin(*i); entry != A.end(*i); ++entry)
+      relevant.add_index(entry->column());
+  relevant.compress();
+  TrilinosWrappers::MPI::Vector aggregate(fine, mpi_communicator),
+                                relevant_aggregate(fine, relevant, mpi_communicator);
+  for (unsigned int i=0; i<fine.n_elements(); ++i)
+    aggregate[fine.nth_index_in_set(i)] = aggregates[level][i];
+  aggregate.compress(VectorOperation::insert);
+  relevant_aggregate = aggregate;
+
+  // rows of P: e_{agg(i)} - omega/A_ii sum_j A_ij e_{agg(j)}
+  std::vector<types::global_dof_index> rows, columns;
+  std::vector<double>                  values;
+  std::map<types::global_dof_index, double> row_entries;
+  DynamicSparsityPattern pattern(fine.size(), coarse.size(), fine);
+  for (auto i = fine.begin(); i != fine.end(); ++i)
+  {
+    row_entries.clear();
+    const double scale = -omega / A.diag_element(*i);
+    row_entries[aggregates[level][fine.index_within_set(*i)]] = 1;
+    for (auto entry = A.begin(*i); entry != A.end(*i); ++entry)
+    {
+      const auto J = static_cast<types::global_dof_index>
+          (relevant_aggregate[entry->column()]);
+      row_entries[J] += scale*entry->value();
+    }
+    for (const auto & it : row_entries)
+    {
+      pattern.add(*i, it.first);
+      rows.push_back(*i);
+      columns.push_back(it.first);
+      values.push_back(it.second);
+    }
+  }
+
+  if (!prolongations[level])
+    prolongations[level].reset(new TrilinosWrappers::SparseMatrix);
+  TrilinosWrappers::SparseMatrix &P = *prolongations[level];
+  P.reinit(fine, coarse, pattern, mpi_communicator);
+  for (unsigned int k=0; k<rows.size(); ++k)
+    P.set(rows[k], columns[k], values[k]);
+  P.compress(VectorOperation::insert);
+
+  // Galerkin operator P^T A P
+  TrilinosWrappers::SparseMatrix AP;
+  A.mmult(AP, P);
+  if (!matrices[level+1])
+    matrices[level+1].reset(new TrilinosWrappers::SparseMatrix);
+  P.Tmmult(*matrices[level+1], AP);
+}  // eom
+
+
+
+template <int dim>
+double
+CellMultigrid<dim>::estimate_max_eigenvalue(const unsigned int level)
+{
+  const TrilinosWrappers::SparseMatrix &A = get_matrix(level);
+  const IndexSet &dofs = owned[level];
+  TrilinosWrappers::MPI::Vector &v = x[level], &Av = r[level],
+                                &diagonal_inverse = t[level];
+  for (auto i = dofs.begin(); i != dofs.end(); ++i)
+  {
+    diagonal_inverse[*i] = 1./A.diag_element(*i);
+    v[*i] = 1. + (*i % 7)/7.;
+  }
+  diagonal_inverse.compress(VectorOperation::insert);
+  v.compress(VectorOperation::insert);
+
+  double lambda = 0;
+  for (unsigned int it=0; it<10; ++it)
+  {
+    v /= v.l2_norm();
+    A.vmult(Av, v);
+    Av.scale(diagonal_inverse);
+    lambda = Av.l2_norm();
+    v = Av;
+  }
+  return lambda;
+}  // eom
+
+
+
+template <int dim>
+void
+CellMultigrid<dim>::initialize(const TrilinosWrappers::SparseMatrix &matrix)
+{
+  AssertThrow(!owned.empty(), ExcMessage("Call reinit first"));
+  AssertThrow(matrix.m() == owned[0].size(),
+              ExcDimensionMismatch(matrix.m(), owned[0].size()));
+  fine_matrix = &matrix;
+  const unsigned int coarsest = owned.size() - 1;
+
+  for (unsigned int l=0; l<coarsest; ++l)
+  {
+    build_prolongation(l);
+
+    // the eigenvalue interval that the smoother damps
+    const double max_eigenvalue = 1.1*estimate_max_eigenvalue(l);
+    TrilinosWrappers::PreconditionChebyshev::AdditionalData
+        data(/* degree= */ 2, max_eigenvalue, /* eigenvalue_ratio= */ 30.);
+    if (!smoothers[l])
+      smoothers[l].reset(new TrilinosWrappers::PreconditionChebyshev);
+    smoothers[l]->initialize(get_matrix(l), data);
+  }
+
+  TrilinosWrappers::PreconditionAMG::AdditionalData data_amg;
+  data_amg.elliptic = true;
+  coarse_solver.initialize(get_matrix(coarsest), data_amg);
+}  // eom
+
+
+
+template <int dim>
+void
+CellMultigrid<dim>::v_cycle(const unsigned int level) const
+{
+  if (level == owned.size() - 1)
+  {
+    coarse_solver.vmult(x[level], b[level]);
+    return;
+  }
+
+  const TrilinosWrappers::SparseMatrix &A = get_matrix(level);
+  const TrilinosWrappers::SparseMatrix &P = *prolongations[level];
+
+  // pre-smoothing from zero
+  smoothers[level]->vmult(x[level], b[level]);
+
+  // coarse-grid correction
+  A.residual(r[level], x[level], b[level]);
+  P.Tvmult(b[level+1], r[level]);
+  v_cycle(level + 1);
+  P.vmult(t[level], x[level+1]);
+  x[level] += t[level];
+
+  // post-smoothing
+  A.residual(r[level], x[level], b[level]);
+  smoothers[level]->vmult(t[level], r[level]);
+  x[level] += t[level];
+}  // eom
+
+
+
+template <int dim>
+void
+CellMultigrid<dim>::vmult(TrilinosWrappers::MPI::Vector       &dst,
+                          const TrilinosWrappers::MPI::Vector &src) const
+{
+  AssertThrow(fine_matrix != NULL, ExcMessage("Call initialize first"));
+  b[0] = src;
+  v_cycle(0);
+  dst = x[0];
+}  // eom
+
+}  // end of namespace
@@ -4,10 +4,6 @@
 #include <Math.hpp>
 // #include <DefaultValues.cc>
 
-#if defined(__GNUC__)
-#pragma GCC diagnostic ignored "-Woverloaded-virtual"
-#endif  // defined(__GNUC__)
-
 namespace CellValues
 {
   using namespace dealii;
@@ -16,13 +12,21 @@ namespace CellValues
   using CellIterator = typename dealii::DoFHandler<dim>::active_cell_iterator;
 
 
-  template <int dim>
+  /*
+   * The fluid model type is a template parameter: the branches on the
+   * phases and the model type in the cell and face kernels are
+   * resolved at compile time. The Simulator picks the instantiation
+   * once for the model in the input file.
+   */
+  template <int dim, Model::ModelType type>
   class CellValuesBase
   {
    public:
+    typedef Model::ModelTraits<type> Traits;
+
     CellValuesBase(const Model::Model<dim> &model_);
     /* Update storage vectors and values for the current cell */
-    virtual void update(const CellIterator<dim> &cell,
+    void update(const CellIterator<dim> &cell,
                         const double pressure,
                         const std::vector<double> &extra_values);
     /* Update wellbore rates and j-indices.
@@ -30,38 +34,50 @@ namespace CellValues
      * pressure-controled wells,
      * Q-vector rather gets the value j_ind*BHP
      */
-    virtual void update_wells(const CellIterator<dim> &cell);
+    void update_wells(const CellIterator<dim> &cell);
     /* Update wellbore rates.
      * This method actually gets real rates for both flow- and pressure-
      * controlled wellbores.
      */
-    virtual void update_wells(const CellIterator<dim> &cell,
+    void update_wells(const CellIterator<dim> &cell,
                               const double pressure);
     /* Update storage vectors and values for the current face */
-    virtual void update_face_values(const CellValuesBase<dim> &neighbor_data,
+    void update_face_values(const CellValuesBase<dim,type> &neighbor_data,
                                     const Tensor<1,dim>       &face_normal,
                                     const double               dS);
+    /* Set volumetric strain of the cell from the current
+     * fixed-stress iteration and from the previous time step.
+     * should be called after update() in coupled models
+     */
+    void update_strain(const double volumetric_strain,
+                       const double old_volumetric_strain);
     // methods for pressure solver
     /* Get a matrix entry corresponding to the cell.
      * should be called once after update_values()
      */
-    virtual double get_matrix_cell_entry(const double time_step) const;
+    double get_matrix_cell_entry(const double time_step) const;
     /* Get a rhs entry corresponding to the cell.
      * should be called once after update_values()
      */
-    virtual double get_rhs_cell_entry(const double time_step,
+    double get_rhs_cell_entry(const double time_step,
                               const double old_solution) const;
+    /* Get the mass coefficient B of the cell (B/dt*p_old in the rhs),
+     * without the fixed-stress terms.
+     * should be called once after update_values()
+     */
+    double get_mass_matrix_entry() const;
     /* Get a matrix entry corresponding to the cell.
      * should be called once after update_values()
      */
-    virtual double get_matrix_face_entry() const;
+    double get_matrix_face_entry() const;
     /* Get a rhs entry corresponding to the face.
      * should be called once per face after update_face_values()
      */
-    virtual double get_rhs_face_entry() const;
+    double get_rhs_face_entry() const;
 
    public:
     const Model::Model<dim> & model;      // reference to the model object
+    const bool                mechanics;  // coupled to geomechanics
     Vector<double>            k;  // absolute permeability
     std::vector<double>       rel_perm;  // relative permeabilities
     Vector<double>            saturation;  // phase saturations
@@ -84,16 +100,32 @@ namespace CellValues
            c3g, c3o, c3w, c3p, c3e;
     double T_w_face, T_o_face, T_g_face;  // cell phase transmissibilities
     double G_w_face, G_o_face, G_g_face;  // cell phase gravity vectors
+    // face transmissibilities and gravity terms for unit relative permeability
+    double T_w_unit_face, T_o_unit_face,
+           G_w_unit_face, G_o_unit_face;
     double Sw, So, Sg;                    // cell saturations
+    // geomechanics
+    double alpha, bulk_modulus;           // Biot coefficient, drained bulk modulus
+    double strain, old_strain;            // cell volumetric strains
+    /* fixed-stress term alpha/K*(p - p_k); off when the strain is
+     * extrapolated and not iterated (it would count the volume change twice)
+     */
+    bool   fixed_stress;
 
+   protected:
+    /* Coefficient at the volumetric strain rate in the pressure equation
+     * (combination of c1e, c2e like the mass coefficients)
+     */
+    double get_strain_coefficient() const;
   };
 
 
 
-template <int dim>
-CellValuesBase<dim>::CellValuesBase(const Model::Model<dim> &model_)
+template <int dim, Model::ModelType type>
+CellValuesBase<dim,type>::CellValuesBase(const Model::Model<dim> &model_)
     :
     model(model_),
+    mechanics(model_.has_mechanics()),
     k(dim),
     rel_perm(model.n_phases()),
     saturation(model.n_phases()),
@@ -101,21 +133,29 @@ CellValuesBase<dim>::CellValuesBase(const Model::Model<dim> &model_)
     pvt_values_oil(model.n_pvt_oil_columns - 1), // cause p not really an entry
     pvt_values_gas(model.n_pvt_gas_columns - 1), // cause p not really an entry
     vector_J_phase(model.n_phases()),
-    vector_Q_phase(model.n_phases())
-{}
+    vector_Q_phase(model.n_phases()),
+    alpha(0),
+    bulk_modulus(0),
+    strain(0),
+    old_strain(0),
+    fixed_stress(true)
+{
+  AssertThrow(model_.fluid_model_type() == type,
+              ExcMessage("Cell values instantiated for a wrong model type"));
+}
 
 
 
-template <int dim>
+template <int dim, Model::ModelType type>
 void
-CellValuesBase<dim>::update(const CellIterator<dim> &cell,
+CellValuesBase<dim,type>::update(const CellIterator<dim> &cell,
                             const double pressure,
                             const std::vector<double> &extra_values)
 {
   const auto & model = this->model;
-  AssertThrow(extra_values.size() == model.n_phases()-1,
+  AssertThrow(extra_values.size() == Traits::n_phases-1,
               ExcDimensionMismatch(extra_values.size(),
-                                   model.n_phases()-1));
+                                   Traits::n_phases-1));
 
   this->cell_coord = cell->center();
   this->phi = model.get_porosity->value(cell->center());
@@ -128,9 +168,9 @@ CellValuesBase<dim>::update(const CellIterator<dim> &cell,
   this->So = 0;
   this->Sg = 0;
 
-  if (model.has_phase(Model::Phase::Water))
+  if (Traits::has_water)
   {
-    if (model.n_phases() > 1)
+    if (Traits::n_phases > 1)
     {
       this->Sw = extra_values[0];
       saturation[0] = this->Sw;
@@ -141,26 +181,26 @@ CellValuesBase<dim>::update(const CellIterator<dim> &cell,
     }
   }
 
-  if (model.has_phase(Model::Phase::Oil))
+  if (Traits::has_oil)
   {
-    if (model.type == Model::ModelType::WaterOil)
+    if (type == Model::ModelType::WaterOil)
       this->So = 1.0 - this->Sw;
-    else if (model.type == Model::ModelType::Blackoil)
+    else if (type == Model::ModelType::Blackoil)
       this->So = extra_values[1];
     saturation[1] = this->So;
   }
 
-  if (model.has_phase(Model::Phase::Gas))
+  if (Traits::has_gas)
   {
     this->Sg = 1 - this->Sw - this->So;
-    if (model.type == Model::ModelType::WaterGas)
+    if (type == Model::ModelType::WaterGas)
       saturation[1] = this->Sg;
-    else if (model.type == Model::ModelType::Blackoil)
+    else if (type == Model::ModelType::Blackoil)
       saturation[2] = this->Sg;
   }
 
   // Phase-dependent values
-  if (model.has_phase(Model::Phase::Water))
+  if (Traits::has_water)
   {
     model.get_pvt_water(pressure, pvt_values_water);
     this->B_w = pvt_values_water[0];
@@ -184,7 +224,7 @@ CellValuesBase<dim>::update(const CellIterator<dim> &cell,
     // }
 
   }
-  if (model.has_phase(Model::Phase::Oil))
+  if (Traits::has_oil)
   {
     model.get_pvt_oil(pressure, pvt_values_oil);
     this->B_o = pvt_values_oil[0];
@@ -199,7 +239,7 @@ CellValuesBase<dim>::update(const CellIterator<dim> &cell,
     c2p = this->phi * So * this->C_o * this->cell_volume / this->B_o;
     c2e = 0;
   }
-  if (model.has_phase(Model::Phase::Gas))
+  if (Traits::has_gas)
   {
     AssertThrow(false, ExcNotImplemented());
     // c3p = 0;
@@ -209,24 +249,37 @@ CellValuesBase<dim>::update(const CellIterator<dim> &cell,
     // c3o = Rgo*c2o;
   }
 
+  // Porosity change due to volumetric strain
+  if (mechanics)
+  {
+    alpha = model.biot_coefficient;
+    const double E = model.get_young_modulus->value(cell->center());
+    const double nu = model.get_poisson_ratio->value(cell->center());
+    bulk_modulus = E/3.0/(1.0 - 2.0*nu);
+    if (Traits::has_water)
+      c1e = alpha * this->Sw * this->cell_volume / this->B_w;
+    if (Traits::has_oil)
+      c2e = alpha * this->So * this->cell_volume / this->B_o;
+  }
+
   // Rel perm
-  if (model.n_phases() == 1)
+  if (Traits::n_phases == 1)
     this->rel_perm[0] = 1;
-  if (model.n_phases() == 2)
+  if (Traits::n_phases == 2)
     model.get_relative_permeability(saturation, this->rel_perm);
 
 } // eom
 
 
 
-template <int dim>
+template <int dim, Model::ModelType type>
 void
-CellValuesBase<dim>::update_wells(const CellIterator<dim> &cell)
+CellValuesBase<dim,type>::update_wells(const CellIterator<dim> &cell)
 {
   vector_J_phase = 0;
   vector_Q_phase = 0;
 
-  for (unsigned int phase = 0; phase < this->model.n_phases(); ++phase)
+  for (unsigned int phase = 0; phase < Traits::n_phases; ++phase)
     for (const auto & well : model.wells)
     {
       std::pair<double,double> J_and_Q = well.get_J_and_Q(cell, phase);
@@ -238,15 +291,15 @@ CellValuesBase<dim>::update_wells(const CellIterator<dim> &cell)
 
 
 
-template <int dim>
+template <int dim, Model::ModelType type>
 void
-CellValuesBase<dim>::
+CellValuesBase<dim,type>::
 update_wells(const CellIterator<dim> &cell,
              const double             pressure)
 {
   vector_Q_phase = 0;
 
-  for (unsigned int phase = 0; phase < this->model.n_phases(); ++phase)
+  for (unsigned int phase = 0; phase < Traits::n_phases; ++phase)
     for (const auto & well : model.wells)
     {
       vector_Q_phase[phase] += well.get_flow_rate(cell, pressure, phase);
@@ -258,10 +311,10 @@ update_wells(const CellIterator<dim> &cell,
 
 
 
-template <int dim>
+template <int dim, Model::ModelType type>
 void
-CellValuesBase<dim>::
-update_face_values(const CellValuesBase<dim> &neighbor_data,
+CellValuesBase<dim,type>::
+update_face_values(const CellValuesBase<dim,type> &neighbor_data,
                    const Tensor<1,dim>     &face_normal,
                    const double            face_area)
 {
@@ -272,7 +325,7 @@ update_face_values(const CellValuesBase<dim> &neighbor_data,
   const double distance = dx.norm();
 
   // obtain face absolute transmissibility
-  Vector<double> k_face(dim);
+  Tensor<1,dim> k_face;
   // Math::harmonic_mean(this->k, neighbor_data.k, k_face);
   // dirty hack to make harmonic mean work with irregular grid
   const double dx1 = cell_volume/face_area;
@@ -289,7 +342,7 @@ update_face_values(const CellValuesBase<dim> &neighbor_data,
   //             ExcMessage("Cells too close"));
 
   // face relative permeabilities
-  if (model.has_phase(Model::Phase::Water))
+  if (Traits::has_water)
   {
     const double mu_w_face = Math::arithmetic_mean(this->mu_w, neighbor_data.mu_w);
     const double B_w_face = Math::arithmetic_mean(this->B_w, neighbor_data.B_w);
@@ -313,17 +366,19 @@ update_face_values(const CellValuesBase<dim> &neighbor_data,
     //   std::cout << "krw" << " = " << k_rw_face << std::flush << std::endl;
     // }
 
-    T_w_face = T_abs_face*k_rw_face/mu_w_face/B_w_face;
+    T_w_unit_face = T_abs_face/mu_w_face/B_w_face;
+    T_w_face = T_w_unit_face*k_rw_face;
     // for (int d=0; d<dim; ++d)
     //   if (abs(dx[d]/distance) > DefaultValues::small_number)
     //     T_w_face += 1./mu_w_face/B_w_face *
     //         (k_face[d]*k_rw_face*abs(face_normal[d]/dx[d]))*face_area;
 
-    G_w_face = model.density_sc_water()/B_w_face/B_w_face/mu_w_face *
-        model.gravity()*k_face[2]*k_rw_face*face_normal[2]*face_area;
+    G_w_unit_face = model.density_sc_water()/B_w_face/B_w_face/mu_w_face *
+        model.gravity()*k_face[2]*face_normal[2]*face_area;
+    G_w_face = G_w_unit_face*k_rw_face;
   }
 
-  if (model.has_phase(Model::Phase::Oil))
+  if (Traits::has_oil)
   {
     const double mu_o_face = Math::arithmetic_mean(this->mu_o, neighbor_data.mu_o);
     const double B_o_face = Math::arithmetic_mean(this->B_o, neighbor_data.B_o);
@@ -345,13 +400,15 @@ update_face_values(const CellValuesBase<dim> &neighbor_data,
                                           neighbor_data.rel_perm[1],
                                           pot_o, pot_o_neighbor);
 
-    T_o_face = T_abs_face*k_ro_face/mu_o_face/B_o_face;
+    T_o_unit_face = T_abs_face/mu_o_face/B_o_face;
+    T_o_face = T_o_unit_face*k_ro_face;
     // for (int d=0; d<dim; ++d)
     //   if (abs(dx[d]/distance) > DefaultValues::small_number)
     //     T_o_face += 1./mu_o_face/B_o_face *
     //         (k_face[d]*k_ro_face*abs(face_normal[d]/dx[d]))*face_area;
-    G_o_face = model.density_sc_oil()/B_o_face/B_o_face/mu_o_face *
-        model.gravity()*k_face[2]*k_ro_face*face_normal[2]*face_area;
+    G_o_unit_face = model.density_sc_oil()/B_o_face/B_o_face/mu_o_face *
+        model.gravity()*k_face[2]*face_normal[2]*face_area;
+    G_o_face = G_o_unit_face*k_ro_face;
 
     // if (cell_coord[0] < 1.5)
     // if (cell_coord[0] > 1.5 && cell_coord[0] < 3.0)
@@ -367,7 +424,7 @@ update_face_values(const CellValuesBase<dim> &neighbor_data,
     // }
   }
 
-  if (model.has_phase(Model::Phase::Gas))
+  if (Traits::has_gas)
   {
     AssertThrow(false, ExcNotImplemented());
     T_g_face = 0;
@@ -377,21 +434,21 @@ update_face_values(const CellValuesBase<dim> &neighbor_data,
 
 
 
-template <int dim>
+template <int dim, Model::ModelType type>
 double
-CellValuesBase<dim>::
+CellValuesBase<dim,type>::
 get_matrix_cell_entry(const double time_step) const
 {
   double entry = 0;
   const auto & model = this->model;
-  if (model.type == Model::ModelType::SingleLiquid)
+  if (type == Model::ModelType::SingleLiquid)
   {
     // B_mass = c1p;
     // J = vector_J_phase[0];
     entry += c1p/time_step;
     entry += vector_J_phase[0];
   }
-  else if (model.type == Model::ModelType::WaterOil)
+  else if (type == Model::ModelType::WaterOil)
   {
     // B_mass = c2o/c1w * c1p + c2p;
     // J = +c2o/c1w*vector_J_phase[0] + vector_J_phase[1];
@@ -399,7 +456,7 @@ get_matrix_cell_entry(const double time_step) const
     entry += +c2o/c1w*vector_J_phase[0] + vector_J_phase[1];
 
   }
-  else if (model.type == Model::ModelType::Blackoil)
+  else if (type == Model::ModelType::Blackoil)
   {
     const double A = c2o/c1w * (c3g-c3w)/(c3g-c3o);
     const double B = c2o / (c3g - c3o);
@@ -409,28 +466,34 @@ get_matrix_cell_entry(const double time_step) const
     // need to get equations for J
     AssertThrow(false, ExcNotImplemented());
   }
+
+  if (mechanics && fixed_stress)
+  {
+    // fixed-stress split: strain increment estimated from pressure increment
+    entry += get_strain_coefficient()*alpha/bulk_modulus/time_step;
+  }
   return entry;
 } // eom
 
 
 
-template <int dim>
+template <int dim, Model::ModelType type>
 double
-CellValuesBase<dim>::
+CellValuesBase<dim,type>::
 get_rhs_cell_entry(const double time_step,
                    const double old_solution) const
 {
   // double rhs_i = B_ii/time_step*p_old + cell_values.get_Q();
   double entry = 0;
   const auto & model = this->model;
-  if (model.type == Model::ModelType::SingleLiquid)
+  if (type == Model::ModelType::SingleLiquid)
   {
     // B_mass = c1p;
     // J = vector_J_phase[0];
     entry += c1p * old_solution/time_step; // B matrix
     entry += vector_Q_phase[0];  // Q vector
   }
-  else if (model.type == Model::ModelType::WaterOil)
+  else if (type == Model::ModelType::WaterOil)
   {
     // B_mass = c2o/c1w * c1p + c2p;
     // J = +c2o/c1w*vector_J_phase[0] + vector_J_phase[1];
@@ -438,7 +501,7 @@ get_rhs_cell_entry(const double time_step,
     entry += +c2o/c1w*vector_Q_phase[0] + vector_Q_phase[1]; // Q vector
 
   }
-  else if (model.type == Model::ModelType::Blackoil)
+  else if (type == Model::ModelType::Blackoil)
   {
     const double A = c2o/c1w * (c3g-c3w)/(c3g-c3o);
     const double B = c2o / (c3g - c3o);
@@ -448,20 +511,80 @@ get_rhs_cell_entry(const double time_step,
     // need to get equations for J and Q
     AssertThrow(false, ExcNotImplemented());
   }
+
+  if (mechanics)
+  {
+    // fixed-stress split: last strain iterate + alpha/K*(p - p_k)
+    const double E = get_strain_coefficient();
+    if (fixed_stress)
+      entry += E*alpha/bulk_modulus*this->pressure/time_step;
+    entry -= E*(strain - old_strain)/time_step;
+  }
   return entry;
 } // eom
 
 
 
-template <int dim>
+template <int dim, Model::ModelType type>
+double
+CellValuesBase<dim,type>::
+get_mass_matrix_entry() const
+{
+  if (type == Model::ModelType::SingleLiquid)
+    return c1p;
+  else if (type == Model::ModelType::WaterOil)
+    return c2o/c1w * c1p + c2p;
+  else if (type == Model::ModelType::Blackoil)
+  {
+    const double A = c2o/c1w * (c3g-c3w)/(c3g-c3o);
+    const double B = c2o / (c3g - c3o);
+    return A*c1p + c2p + B*c3p;
+  }
+
+  AssertThrow(false, ExcNotImplemented());
+  return 0;
+} // eom
+
+
+
+template <int dim, Model::ModelType type>
+inline
+void
+CellValuesBase<dim,type>::update_strain(const double volumetric_strain,
+                                   const double old_volumetric_strain)
+{
+  strain = volumetric_strain;
+  old_strain = old_volumetric_strain;
+}  // eom
+
+
+
+template <int dim, Model::ModelType type>
+inline
+double
+CellValuesBase<dim,type>::get_strain_coefficient() const
+{
+  if (type == Model::ModelType::SingleLiquid)
+    return c1e;
+  else if (type == Model::ModelType::WaterOil)
+    return c2o/c1w * c1e + c2e;
+  else
+    AssertThrow(false, ExcNotImplemented());
+
+  return 0;
+} // eom
+
+
+
+template <int dim, Model::ModelType type>
 inline
 double
-CellValuesBase<dim>::get_matrix_face_entry() const
+CellValuesBase<dim,type>::get_matrix_face_entry() const
 {
   double entry = 0;
-  if (model.type == Model::ModelType::SingleLiquid)
+  if (type == Model::ModelType::SingleLiquid)
     entry += T_w_face;
-  else if (model.type == Model::ModelType::WaterOil)
+  else if (type == Model::ModelType::WaterOil)
   {
     entry += +c2o/c1w * T_w_face + T_o_face;
   }
@@ -473,15 +596,15 @@ CellValuesBase<dim>::get_matrix_face_entry() const
 
 
 
-template <int dim>
+template <int dim, Model::ModelType type>
 inline
 double
-CellValuesBase<dim>::get_rhs_face_entry() const
+CellValuesBase<dim,type>::get_rhs_face_entry() const
 {
   double entry = 0;
-  if (model.type == Model::ModelType::SingleLiquid)
+  if (type == Model::ModelType::SingleLiquid)
     entry += G_w_face;
-  else if (model.type == Model::ModelType::WaterOil)
+  else if (type == Model::ModelType::WaterOil)
   {
     entry += +c2o/c1w * G_w_face + G_o_face;
   }
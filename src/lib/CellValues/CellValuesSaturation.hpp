@@ -13,26 +13,26 @@ using namespace dealii;
  * methods to update rhs vector for the
  * IMPES saturation solver
  */
-template <int dim>
-class CellValuesSaturation : public CellValuesBase<dim>
+template <int dim, Model::ModelType type>
+class CellValuesSaturation : public CellValuesBase<dim,type>
 {
  public:
   CellValuesSaturation(const Model::Model<dim> &model);
   /* Update storage vectors and values for the current face */
-  virtual void update_face_values(const CellValuesBase<dim> &neighbor_data,
+  void update_face_values(const CellValuesBase<dim,type> &neighbor_data,
                                   const Tensor<1,dim>       &face_normal,
                                   const double               dS);
   /* Get a rhs entry corresponding to the cell.
    * should be called once after update_values()
    */
-  virtual double get_rhs_cell_entry(const double time_step,
+  double get_rhs_cell_entry(const double time_step,
                                     const double pressure,
                                     const double old_pressure,
                                     const int phase) const;
   /* Get a rhs entry corresponding to the face.
    * should be called once per face after update_face_values()
    */
-  virtual double get_rhs_face_entry(const double time_step,
+  double get_rhs_face_entry(const double time_step,
                                     const int phase) const;
   // Variables
  private:
@@ -41,22 +41,22 @@ class CellValuesSaturation : public CellValuesBase<dim>
 
 
 
-template <int dim>
-CellValuesSaturation<dim>::CellValuesSaturation(const Model::Model<dim> &model_)
+template <int dim, Model::ModelType type>
+CellValuesSaturation<dim,type>::CellValuesSaturation(const Model::Model<dim> &model_)
     :
-    CellValuesBase<dim>::CellValuesBase(model_)
+    CellValuesBase<dim,type>::CellValuesBase(model_)
 {}
 
 
 
-template<int dim>
+template<int dim, Model::ModelType type>
 void
-CellValuesSaturation<dim>::update_face_values(const CellValuesBase<dim> &neighbor_data,
-                                              const Tensor<1,dim>       &face_normal,
-                                              const double               dS)
+CellValuesSaturation<dim,type>::update_face_values(const CellValuesBase<dim,type> &neighbor_data,
+                                                   const Tensor<1,dim>            &face_normal,
+                                                   const double                    dS)
 {
-  CellValuesBase<dim>::update_face_values(neighbor_data, face_normal, dS);
-  pressure_difference = CellValuesBase<dim>::pressure - neighbor_data.pressure;
+  CellValuesBase<dim,type>::update_face_values(neighbor_data, face_normal, dS);
+  pressure_difference = CellValuesBase<dim,type>::pressure - neighbor_data.pressure;
 }  // end update_face_values
 
 
@@ -167,28 +167,28 @@ CellValuesSaturation<dim>::update_face_values(const CellValuesBase<dim> &neighbo
 
 
 
-template<int dim>
+template<int dim, Model::ModelType type>
 inline
 double
-CellValuesSaturation<dim>::get_rhs_face_entry(const double time_step,
+CellValuesSaturation<dim,type>::get_rhs_face_entry(const double time_step,
                                               const int phase) const
 {
   double result = 0;
-  if (CellValuesBase<dim>::model.type == Model::ModelType::SingleLiquid)
+  if (type == Model::ModelType::SingleLiquid)
   {
     AssertThrow(false, ExcMessage("Cannot solve for single phase"));
   }
-  else if (CellValuesBase<dim>::model.type == Model::ModelType::WaterOil)
+  else if (type == Model::ModelType::WaterOil)
   {
     if (phase == 0)
     {
-      result += - CellValuesBase<dim>::T_w_face * pressure_difference / CellValuesBase<dim>::c1w;
-      result += CellValuesBase<dim>::G_w_face / CellValuesBase<dim>::c1w;
+      result += - CellValuesBase<dim,type>::T_w_face * pressure_difference / CellValuesBase<dim,type>::c1w;
+      result += CellValuesBase<dim,type>::G_w_face / CellValuesBase<dim,type>::c1w;
     }
     else
     {
-      result += - CellValuesBase<dim>::T_o_face * pressure_difference / CellValuesBase<dim>::c2o;
-      result += CellValuesBase<dim>::G_o_face / CellValuesBase<dim>::c2o;
+      result += - CellValuesBase<dim,type>::T_o_face * pressure_difference / CellValuesBase<dim,type>::c2o;
+      result += CellValuesBase<dim,type>::G_o_face / CellValuesBase<dim,type>::c2o;
     }
   }
   else
@@ -199,34 +199,39 @@ CellValuesSaturation<dim>::get_rhs_face_entry(const double time_step,
 
 
 
-template<int dim>
+template<int dim, Model::ModelType type>
 inline
 double
-CellValuesSaturation<dim>::get_rhs_cell_entry(const double time_step,
+CellValuesSaturation<dim,type>::get_rhs_cell_entry(const double time_step,
                                               const double pressure,
                                               const double old_pressure,
                                               const int phase) const
 {
   double result = 0;
-  if (CellValuesBase<dim>::model.type == Model::ModelType::SingleLiquid)
+  if (type == Model::ModelType::SingleLiquid)
   {
     AssertThrow(false, ExcMessage("Cannot solve for single phase"));
   }
-  else if (CellValuesBase<dim>::model.type == Model::ModelType::WaterOil)
+  else if (type == Model::ModelType::WaterOil)
   {
     if (phase == 0)
     {
-      result += CellValuesBase<dim>::vector_Q_phase[0] / CellValuesBase<dim>::c1w *
+      result += CellValuesBase<dim,type>::vector_Q_phase[0] / CellValuesBase<dim,type>::c1w *
           time_step;
-      result += CellValuesBase<dim>::c1p / CellValuesBase<dim>::c1w *
+      result += CellValuesBase<dim,type>::c1p / CellValuesBase<dim,type>::c1w *
       (pressure - old_pressure);
+      // porosity change due to deformation
+      result -= CellValuesBase<dim,type>::c1e / CellValuesBase<dim,type>::c1w *
+          (CellValuesBase<dim,type>::strain - CellValuesBase<dim,type>::old_strain);
     }
     else
     {
-      result += CellValuesBase<dim>::vector_Q_phase[1] / CellValuesBase<dim>::c2o *
+      result += CellValuesBase<dim,type>::vector_Q_phase[1] / CellValuesBase<dim,type>::c2o *
           time_step;
-      result += CellValuesBase<dim>::c2p / CellValuesBase<dim>::c2o *
+      result += CellValuesBase<dim,type>::c2p / CellValuesBase<dim,type>::c2o *
           (pressure - old_pressure);
+      result -= CellValuesBase<dim,type>::c2e / CellValuesBase<dim,type>::c2o *
+          (CellValuesBase<dim,type>::strain - CellValuesBase<dim,type>::old_strain);
     }
   }
   else
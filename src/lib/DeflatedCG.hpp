@@ -0,0 +1,331 @@
+#pragma once
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/lac/solver_control.h>
+#include <deal.II/lac/lapack_full_matrix.h>
+#include <deal.II/lac/vector.h>
+#include <deal.II/lac/trilinos_vector.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+
+namespace LinearSolvers
+{
+using namespace dealii;
+
+
+/*
+ * Deflated preconditioned CG with a deflation space that is recycled
+ * between the solves of a sequence of slowly changing SPD systems
+ * (Saad, Yeung, Erhel, Guyomarc'h, SISC 21, 2000).
+ * Only the single-phase pressure matrix is symmetric; the water-oil
+ * rows are scaled per cell, so it is solved with DeflatedGMRES.
+ * The iterates are kept A-orthogonal to the deflation vectors W, so
+ * the eigenvalues that W approximates do not slow the convergence.
+ * W is recomputed every few solves from the harmonic Ritz vectors of
+ * the span of W and of the first search directions of the last solve
+ * that belong to the smallest harmonic Ritz values.
+ */
+class DeflatedCG
+{
+ public:
+  DeflatedCG();
+  // allocate vectors and forget the deflation space
+  void reinit(const IndexSet     &locally_owned_dofs,
+              MPI_Comm           &mpi_communicator,
+              const unsigned int  max_vectors,
+              const unsigned int  refresh_interval);
+  // MatrixType is a sparse matrix or an operator with vmult and residual
+  template <typename MatrixType, typename Preconditioner>
+  void solve(const MatrixType                     &matrix,
+             TrilinosWrappers::MPI::Vector        &solution,
+             const TrilinosWrappers::MPI::Vector  &rhs,
+             const Preconditioner                 &preconditioner,
+             SolverControl                        &solver_control);
+  // size of the current deflation space
+  unsigned int n_deflation_vectors() const;
+
+ private:
+  // mu = (W^T A W)^{-1} V^T v
+  void coarse_solve(const std::vector<TrilinosWrappers::MPI::Vector> &V,
+                    const TrilinosWrappers::MPI::Vector              &v);
+  // dst += factor * V mu
+  void add_coarse(const double                                      factor,
+                  const std::vector<TrilinosWrappers::MPI::Vector> &V,
+                  TrilinosWrappers::MPI::Vector                    &dst) const;
+  // W^T A W with the matrix of the current solve
+  template <typename MatrixType>
+  void setup_coarse_matrix(const MatrixType &matrix);
+  // new W from the harmonic Ritz vectors of span[W, P]
+  void refresh_deflation_space();
+
+  unsigned int                               max_vectors,
+                                             refresh_interval,
+                                             n_solves,
+                                             n_active,
+                                             n_directions;
+  // deflation vectors, stored search directions, and their products with A
+  std::vector<TrilinosWrappers::MPI::Vector> W, AW, P, AP, new_W, new_AW;
+  TrilinosWrappers::MPI::Vector              r, z, p, Ap;
+  LAPACKFullMatrix<double>                   coarse_matrix;
+  Vector<double>                             coarse_rhs, mu;
+};
+
+
+
+inline
+DeflatedCG::DeflatedCG()
+    :
+    max_vectors(0),
+    refresh_interval(1),
+    n_solves(0),
+    n_active(0),
+    n_directions(0)
+{}  // eom
+
+
+
+inline
+void
+DeflatedCG::reinit(const IndexSet     &locally_owned_dofs,
+                   MPI_Comm           &mpi_communicator,
+                   const unsigned int  max_vectors_,
+                   const unsigned int  refresh_interval_)
+{
+  max_vectors = max_vectors_;
+  refresh_interval = std::max(refresh_interval_, 1u);
+
+  for (auto * V : {&W, &AW, &P, &AP, &new_W, &new_AW})
+  {
+    V->resize(max_vectors);
+    for (auto & v : *V)
+      v.reinit(locally_owned_dofs, mpi_communicator);
+  }
+  r.reinit(locally_owned_dofs, mpi_communicator);
+  z.reinit(locally_owned_dofs, mpi_communicator);
+  p.reinit(locally_owned_dofs, mpi_communicator);
+  Ap.reinit(locally_owned_dofs, mpi_communicator);
+
+  n_solves = 0;
+  n_active = 0;
+  n_directions = 0;
+}  // eom
+
+
+
+inline
+unsigned int
+DeflatedCG::n_deflation_vectors() const
+{
+  return n_active;
+}  // eom
+
+
+
+inline
+void
+DeflatedCG::
+coarse_solve(const std::vector<TrilinosWrappers::MPI::Vector> &V,
+             const TrilinosWrappers::MPI::Vector              &v)
+{
+  for (unsigned int i=0; i<n_active; ++i)
+    coarse_rhs[i] = V[i]*v;
+  coarse_matrix.vmult(mu, coarse_rhs);
+}  // eom
+
+
+
+inline
+void
+DeflatedCG::
+add_coarse(const double                                      factor,
+           const std::vector<TrilinosWrappers::MPI::Vector> &V,
+           TrilinosWrappers::MPI::Vector                    &dst) const
+{
+  for (unsigned int i=0; i<n_active; ++i)
+    dst.add(factor*mu[i], V[i]);
+}  // eom
+
+
+
+template <typename MatrixType>
+void
+DeflatedCG::setup_coarse_matrix(const MatrixType &matrix)
+{
+  coarse_rhs.reinit(n_active);
+  mu.reinit(n_active);
+  if (n_active == 0)
+    return;
+
+  coarse_matrix.reinit(n_active);
+  for (unsigned int i=0; i<n_active; ++i)
+    matrix.vmult(AW[i], W[i]);
+  for (unsigned int i=0; i<n_active; ++i)
+    for (unsigned int j=0; j<=i; ++j)
+    {
+      const double value = W[i]*AW[j];
+      coarse_matrix(i, j) = value;
+      coarse_matrix(j, i) = value;
+    }
+  // explicit inverse: the coarse matrix is tiny
+  coarse_matrix.invert();
+}  // eom
+
+
+
+inline
+void
+DeflatedCG::refresh_deflation_space()
+{
+  const unsigned int m = n_active + n_directions;
+  if (m == 0)
+    return;
+
+  // Z = [W, P]
+  std::vector<const TrilinosWrappers::MPI::Vector*> Z(m), AZ(m);
+  for (unsigned int i=0; i<n_active; ++i)
+  {
+    Z[i] = &W[i];
+    AZ[i] = &AW[i];
+  }
+  for (unsigned int i=0; i<n_directions; ++i)
+  {
+    Z[n_active + i] = &P[i];
+    AZ[n_active + i] = &AP[i];
+  }
+
+  // harmonic Ritz pairs: (AZ)^T AZ y = theta Z^T AZ y
+  LAPACKFullMatrix<double> G(m), F(m);
+  for (unsigned int i=0; i<m; ++i)
+    for (unsigned int j=0; j<=i; ++j)
+    {
+      G(i, j) = G(j, i) = (*AZ[i])*(*AZ[j]);
+      // symmetric up to rounding for a symmetric matrix
+      F(i, j) = F(j, i) = 0.5*((*Z[i])*(*AZ[j]) + (*Z[j])*(*AZ[i]));
+    }
+
+  std::vector< Vector<double> > eigenvectors(m, Vector<double>(m));
+  try
+  {
+    G.compute_generalized_eigenvalues_symmetric(F, eigenvectors);
+  }
+  catch (std::exception &)
+  { // nearly dependent directions: keep the current space
+    n_directions = 0;
+    return;
+  }
+
+  std::vector<unsigned int> order(m);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&G](const unsigned int a, const unsigned int b)
+            {return G.eigenvalue(a).real() < G.eigenvalue(b).real();});
+
+  const unsigned int n_new = std::min(m, max_vectors);
+  for (unsigned int k=0; k<n_new; ++k)
+  {
+    const Vector<double> &y = eigenvectors[order[k]];
+    new_W[k] = 0;
+    new_AW[k] = 0;
+    for (unsigned int j=0; j<m; ++j)
+    {
+      new_W[k].add(y[j], *Z[j]);
+      new_AW[k].add(y[j], *AZ[j]);
+    }
+  }
+
+  for (unsigned int k=0; k<n_new; ++k)
+  {
+    W[k].swap(new_W[k]);
+    AW[k].swap(new_AW[k]);
+  }
+  n_active = n_new;
+  n_directions = 0;
+}  // eom
+
+
+
+template <typename MatrixType, typename Preconditioner>
+void
+DeflatedCG::solve(const MatrixType                     &matrix,
+                  TrilinosWrappers::MPI::Vector        &solution,
+                  const TrilinosWrappers::MPI::Vector  &rhs,
+                  const Preconditioner                 &preconditioner,
+                  SolverControl                        &solver_control)
+{
+  AssertThrow(r.size() == rhs.size(), ExcMessage("Call reinit first"));
+  setup_coarse_matrix(matrix);
+
+  // the search directions of this solve refresh the space
+  const bool collect = (max_vectors > 0 &&
+                        (n_active == 0 || (n_solves + 1) % refresh_interval == 0));
+  n_directions = 0;
+
+  // initial residual orthogonal to W
+  matrix.residual(r, solution, rhs);
+  if (n_active > 0)
+  {
+    coarse_solve(W, r);
+    add_coarse(1.0, W, solution);
+    add_coarse(-1.0, AW, r);
+  }
+
+  SolverControl::State state = solver_control.check(0, r.l2_norm());
+  if (state == SolverControl::iterate)
+  {
+    preconditioner.vmult(z, r);
+    p = z;
+    if (n_active > 0)
+    {
+      coarse_solve(AW, z);
+      add_coarse(-1.0, W, p);
+    }
+    double rz = r*z;
+
+    for (unsigned int step=1; state == SolverControl::iterate; ++step)
+    {
+      matrix.vmult(Ap, p);
+      const double pAp = p*Ap;
+      if (collect && n_directions < max_vectors && pAp > 0)
+      {
+        const double scale = 1./std::sqrt(pAp);
+        P[n_directions].equ(scale, p);
+        AP[n_directions].equ(scale, Ap);
+        n_directions++;
+      }
+
+      const double alpha = rz / pAp;
+      solution.add(alpha, p);
+      r.add(-alpha, Ap);
+
+      state = solver_control.check(step, r.l2_norm());
+      if (state != SolverControl::iterate)
+        break;
+
+      preconditioner.vmult(z, r);
+      const double rz_new = r*z;
+      const double beta = rz_new / rz;
+      rz = rz_new;
+
+      // p = z + beta p - W (W^T A W)^{-1} (AW)^T z
+      p.sadd(beta, z);
+      if (n_active > 0)
+      {
+        coarse_solve(AW, z);
+        add_coarse(-1.0, W, p);
+      }
+    }
+  }
+
+  if (collect)
+    refresh_deflation_space();
+  n_solves++;
+
+  AssertThrow(state == SolverControl::success,
+              SolverControl::NoConvergence(solver_control.last_step(),
+                                           solver_control.last_value()));
+}  // eom
+
+}  // end of namespace
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/lac/solver_control.h>
+#include <deal.II/lac/full_matrix.h>
+#include <deal.II/lac/lapack_full_matrix.h>
+#include <deal.II/lac/vector.h>
+#include <deal.II/lac/trilinos_vector.h>
+#include <algorithm>
+#include <cmath>
+
+
+namespace LinearSolvers
+{
+using namespace dealii;
+
+
+/*
+ * Restarted right-preconditioned GMRES with a recycled subspace for a
+ * sequence of slowly changing nonsymmetric systems, in the GCRO form
+ * of GCRO-DR (Parks, de Sturler, Mackey, Johnson, Maiti, SISC 28, 2006):
+ * the recycled vectors U are scaled so that C = A U is orthonormal,
+ * the residual is kept orthogonal to C, and the Arnoldi process runs
+ * on (I - C C^T) A M^{-1}.
+ * The water-oil pressure rows are scaled per cell, so the matrix is
+ * not symmetric and the deflated CG does not apply.
+ * Every few solves U is recomputed from span[U, Z] of the last cycle
+ * (Z the preconditioned Arnoldi vectors): it takes the right singular
+ * vectors of the projected operator [[I, B], [0, H]] that belong to
+ * its smallest singular values (B = C^T A Z, H the Hessenberg matrix).
+ * GCRO-DR uses harmonic Ritz vectors there; the singular vectors need
+ * only a symmetric eigensolver and pick the same slow directions.
+ */
+class DeflatedGMRES
+{
+ public:
+  DeflatedGMRES();
+  // allocate vectors and forget the recycled space
+  void reinit(const IndexSet     &locally_owned_dofs,
+              MPI_Comm           &mpi_communicator,
+              const unsigned int  max_vectors,
+              const unsigned int  refresh_interval);
+  // MatrixType is a sparse matrix or an operator with vmult and residual
+  template <typename MatrixType, typename Preconditioner>
+  void solve(const MatrixType                     &matrix,
+             TrilinosWrappers::MPI::Vector        &solution,
+             const TrilinosWrappers::MPI::Vector  &rhs,
+             const Preconditioner                 &preconditioner,
+             SolverControl                        &solver_control);
+  // size of the current recycled space
+  unsigned int n_deflation_vectors() const;
+
+ private:
+  // C = A U orthonormal, U scaled with it; dependent vectors are dropped
+  template <typename MatrixType>
+  void setup_recycled_space(const MatrixType &matrix);
+  // solution += U C^T r, r -= C C^T r
+  void project_residual(TrilinosWrappers::MPI::Vector &solution);
+  // new U from the singular vectors of the last cycle
+  void refresh_recycled_space(const unsigned int n_steps);
+
+  // Krylov vectors per restart cycle
+  static const unsigned int                  restart = 30;
+  unsigned int                               max_vectors,
+                                             refresh_interval,
+                                             n_solves,
+                                             n_active;
+  // recycled space and its image, Arnoldi and preconditioned vectors
+  std::vector<TrilinosWrappers::MPI::Vector> U, C, V, Z, new_U;
+  TrilinosWrappers::MPI::Vector              r, w;
+  // Hessenberg matrix before the rotations and B = C^T A Z of a cycle
+  FullMatrix<double>                         hessenberg, projection;
+};
+
+
+
+inline
+DeflatedGMRES::DeflatedGMRES()
+    :
+    max_vectors(0),
+    refresh_interval(1),
+    n_solves(0),
+    n_active(0)
+{}  // eom
+
+
+
+inline
+void
+DeflatedGMRES::reinit(const IndexSet     &locally_owned_dofs,
+                      MPI_Comm           &mpi_communicator,
+                      const unsigned int  max_vectors_,
+                      const unsigned int  refresh_interval_)
+{
+  max_vectors = max_vectors_;
+  refresh_interval = std::max(refresh_interval_, 1u);
+
+  U.resize(max_vectors);
+  C.resize(max_vectors);
+  new_U.resize(max_vectors);
+  V.resize(restart + 1);
+  Z.resize(restart);
+  for (auto * X : {&U, &C, &V, &Z, &new_U})
+    for (auto & v : *X)
+      v.reinit(locally_owned_dofs, mpi_communicator);
+  r.reinit(locally_owned_dofs, mpi_communicator);
+  w.reinit(locally_owned_dofs, mpi_communicator);
+  hessenberg.reinit(restart + 1, restart);
+  projection.reinit(max_vectors, restart);
+
+  n_solves = 0;
+  n_active = 0;
+}  // eom
+
+
+
+inline
+unsigned int
+DeflatedGMRES::n_deflation_vectors() const
+{
+  return n_active;
+}  // eom
+
+
+
+template <typename MatrixType>
+void
+DeflatedGMRES::setup_recycled_space(const MatrixType &matrix)
+{
+  // modified Gram-Schmidt on C = A U with the same operations on U
+  unsigned int n_kept = 0;
+  for (unsigned int i=0; i<n_active; ++i)
+  {
+    if (n_kept != i)
+      U[n_kept].swap(U[i]);
+    matrix.vmult(C[n_kept], U[n_kept]);
+    const double norm = C[n_kept].l2_norm();
+    for (unsigned int j=0; j<n_kept; ++j)
+    {
+      const double factor = C[j]*C[n_kept];
+      C[n_kept].add(-factor, C[j]);
+      U[n_kept].add(-factor, U[j]);
+    }
+    const double new_norm = C[n_kept].l2_norm();
+    if (new_norm <= 1e-10*norm || new_norm == 0)
+      continue;
+    C[n_kept] /= new_norm;
+    U[n_kept] /= new_norm;
+    n_kept++;
+  }
+  n_active = n_kept;
+}  // eom
+
+
+
+inline
+void
+DeflatedGMRES::project_residual(TrilinosWrappers::MPI::Vector &solution)
+{
+  for (unsigned int i=0; i<n_active; ++i)
+  {
+    const double factor = C[i]*r;
+    solution.add(factor, U[i]);
+    r.add(-factor, C[i]);
+  }
+}  // eom
+
+
+
+inline
+void
+DeflatedGMRES::refresh_recycled_space(const unsigned int n_steps)
+{
+  const unsigned int k = n_active;
+  const unsigned int m = k + n_steps;
+  if (n_steps == 0)
+    return;
+
+  /* A [U, Z] = [C, V] G with G = [[I, B], [0, H]] and orthonormal
+   * [C, V], so the singular values of G are those of A on span[U, Z]
+   * in the coefficients of U and Z
+   */
+  FullMatrix<double> G(m + 1, m), GG(m, m);
+  for (unsigned int i=0; i<k; ++i)
+  {
+    G(i, i) = 1;
+    for (unsigned int j=0; j<n_steps; ++j)
+      G(i, k + j) = projection(i, j);
+  }
+  for (unsigned int i=0; i<=n_steps; ++i)
+    for (unsigned int j=0; j<n_steps; ++j)
+      G(k + i, k + j) = hessenberg(i, j);
+  G.Tmmult(GG, G);
+
+  LAPACKFullMatrix<double> F(m);
+  F = GG;
+  Vector<double>     singular_values;
+  FullMatrix<double> singular_vectors;
+  try
+  {
+    F.compute_eigenvalues_symmetric(-1.0, 1.0 + GG.frobenius_norm(),
+                                    1e-12*GG.frobenius_norm(),
+                                    singular_values, singular_vectors);
+  }
+  catch (std::exception &)
+  { // nearly dependent directions: keep the current space
+    return;
+  }
+
+  // the eigenvalues come in ascending order
+  const unsigned int n_new =
+      std::min(static_cast<unsigned int>(singular_values.size()), max_vectors);
+  for (unsigned int q=0; q<n_new; ++q)
+  {
+    new_U[q] = 0;
+    for (unsigned int i=0; i<k; ++i)
+      new_U[q].add(singular_vectors(i, q), U[i]);
+    for (unsigned int j=0; j<n_steps; ++j)
+      new_U[q].add(singular_vectors(k + j, q), Z[j]);
+  }
+  for (unsigned int q=0; q<n_new; ++q)
+    U[q].swap(new_U[q]);
+  n_active = n_new;
+}  // eom
+
+
+
+template <typename MatrixType, typename Preconditioner>
+void
+DeflatedGMRES::solve(const MatrixType                     &matrix,
+                     TrilinosWrappers::MPI::Vector        &solution,
+                     const TrilinosWrappers::MPI::Vector  &rhs,
+                     const Preconditioner                 &preconditioner,
+                     SolverControl                        &solver_control)
+{
+  AssertThrow(r.size() == rhs.size(), ExcMessage("Call reinit first"));
+  // the matrix has changed since the last solve
+  setup_recycled_space(matrix);
+
+  // the Arnoldi vectors of the last cycle refresh the space
+  const bool refresh = (max_vectors > 0 &&
+                        (n_active == 0 || (n_solves + 1) % refresh_interval == 0));
+
+  // initial residual orthogonal to C
+  matrix.residual(r, solution, rhs);
+  project_residual(solution);
+
+  std::vector<double> g(restart + 1), cs(restart), sn(restart), y(restart);
+  FullMatrix<double>  R(restart + 1, restart);
+  unsigned int n_steps = 0, step = 0;
+  SolverControl::State state = solver_control.check(step, r.l2_norm());
+
+  while (state == SolverControl::iterate)
+  { // restart cycle
+    std::fill(g.begin(), g.end(), 0);
+    g[0] = r.l2_norm();
+    V[0].equ(1./g[0], r);
+    hessenberg = 0;
+    projection = 0;
+
+    n_steps = 0;
+    for (unsigned int j=0; j<restart && state == SolverControl::iterate; ++j)
+    {
+      preconditioner.vmult(Z[j], V[j]);
+      matrix.vmult(w, Z[j]);
+      for (unsigned int i=0; i<n_active; ++i)
+      {
+        projection(i, j) = C[i]*w;
+        w.add(-projection(i, j), C[i]);
+      }
+      for (unsigned int i=0; i<=j; ++i)
+      {
+        hessenberg(i, j) = V[i]*w;
+        w.add(-hessenberg(i, j), V[i]);
+      }
+      hessenberg(j+1, j) = w.l2_norm();
+      n_steps = j + 1;
+
+      // least-squares problem by Givens rotations
+      for (unsigned int i=0; i<=j+1; ++i)
+        R(i, j) = hessenberg(i, j);
+      for (unsigned int i=0; i<j; ++i)
+      {
+        const double a = R(i, j), b = R(i+1, j);
+        R(i, j)   =  cs[i]*a + sn[i]*b;
+        R(i+1, j) = -sn[i]*a + cs[i]*b;
+      }
+      const double rho = std::sqrt(R(j, j)*R(j, j) + R(j+1, j)*R(j+1, j));
+      cs[j] = R(j, j)/rho;
+      sn[j] = R(j+1, j)/rho;
+      R(j, j) = rho;
+      R(j+1, j) = 0;
+      g[j+1] = -sn[j]*g[j];
+      g[j]   =  cs[j]*g[j];
+
+      state = solver_control.check(++step, std::abs(g[j+1]));
+      // a zero subdiagonal entry means the Krylov space is invariant
+      if (hessenberg(j+1, j) == 0)
+        break;
+      V[j+1].equ(1./hessenberg(j+1, j), w);
+    }
+
+    // solution += Z y - U B y
+    for (int i=n_steps-1; i>=0; --i)
+    {
+      double sum = g[i];
+      for (unsigned int l=i+1; l<n_steps; ++l)
+        sum -= R(i, l)*y[l];
+      y[i] = sum/R(i, i);
+    }
+    for (unsigned int j=0; j<n_steps; ++j)
+      solution.add(y[j], Z[j]);
+    for (unsigned int i=0; i<n_active; ++i)
+    {
+      double by = 0;
+      for (unsigned int j=0; j<n_steps; ++j)
+        by += projection(i, j)*y[j];
+      solution.add(-by, U[i]);
+    }
+
+    // true residual for the next cycle and the final check
+    matrix.residual(r, solution, rhs);
+    project_residual(solution);
+    if (state == SolverControl::success)
+      state = solver_control.check(step, r.l2_norm());
+  }
+
+  if (refresh)
+    refresh_recycled_space(n_steps);
+  n_solves++;
+
+  AssertThrow(state == SolverControl::success,
+              SolverControl::NoConvergence(solver_control.last_step(),
+                                           solver_control.last_value()));
+}  // eom
+
+}  // end of namespace
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <deal.II/lac/trilinos_vector.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+#include <Amesos.h>
+#include <Amesos_BaseSolver.h>
+#include <Epetra_LinearProblem.h>
+#include <memory>
+#include <string>
+
+
+namespace LinearSolvers
+{
+using namespace dealii;
+
+
+/*
+ * Sparse direct solver through Amesos (Amesos_Klu, Amesos_Mumps,
+ * Amesos_Superludist, ...).
+ * The ordering and symbolic factorization depend only on the sparsity
+ * pattern: they are computed at the first solve after reinit and
+ * reused, each solve only redoes the numeric factorization.
+ * reinit must be called whenever the matrix is reinitialized.
+ */
+class DirectSolver
+{
+ public:
+  DirectSolver();
+  // forget the factorization and set the Amesos solver name
+  void reinit(const std::string &solver_name_);
+  void solve(const TrilinosWrappers::SparseMatrix &matrix,
+             TrilinosWrappers::MPI::Vector        &solution,
+             const TrilinosWrappers::MPI::Vector  &rhs);
+
+ private:
+  std::string                         solver_name;
+  std::unique_ptr<Epetra_LinearProblem> problem;
+  std::unique_ptr<Amesos_BaseSolver>  solver;
+};
+
+
+
+inline
+DirectSolver::DirectSolver()
+    :
+    solver_name("Amesos_Klu")
+{}  // eom
+
+
+
+inline
+void
+DirectSolver::reinit(const std::string &solver_name_)
+{
+  solver_name = solver_name_;
+  // the solver references the problem
+  solver.reset();
+  problem.reset();
+}  // eom
+
+
+
+inline
+void
+DirectSolver::solve(const TrilinosWrappers::SparseMatrix &matrix,
+                    TrilinosWrappers::MPI::Vector        &solution,
+                    const TrilinosWrappers::MPI::Vector  &rhs)
+{
+  // Amesos takes non-const pointers but does not modify the matrix or rhs
+  Epetra_CrsMatrix &A = const_cast<Epetra_CrsMatrix&>(matrix.trilinos_matrix());
+
+  if (!solver)
+  { // ordering and symbolic factorization of the sparsity pattern
+    problem.reset(new Epetra_LinearProblem);
+    problem->SetOperator(&A);
+    Amesos factory;
+    AssertThrow(factory.Query(solver_name.c_str()),
+                ExcMessage("Direct solver " + solver_name + " is not available"));
+    solver.reset(factory.Create(solver_name.c_str(), *problem));
+    const int ierr = solver->SymbolicFactorization();
+    AssertThrow(ierr == 0, ExcTrilinosError(ierr));
+  }
+
+  AssertThrow(problem->GetMatrix() == &A,
+              ExcMessage("Matrix changed since the symbolic factorization"));
+  problem->SetLHS(&solution.trilinos_vector());
+  problem->SetRHS(const_cast<Epetra_FEVector*>(&rhs.trilinos_vector()));
+
+  int ierr = solver->NumericFactorization();
+  AssertThrow(ierr == 0, ExcTrilinosError(ierr));
+  ierr = solver->Solve();
+  AssertThrow(ierr == 0, ExcTrilinosError(ierr));
+}  // eom
+
+}  // end of namespace
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <deal.II/base/config.h>
+
+#if DEAL_II_VERSION_GTE(9,0,0)
+
+#include <deal.II/base/function.h>
+#include <deal.II/base/table.h>
+#include <deal.II/base/vectorization.h>
+#include <deal.II/lac/la_parallel_vector.h>
+#include <deal.II/lac/diagonal_matrix.h>
+#include <deal.II/matrix_free/matrix_free.h>
+#include <deal.II/matrix_free/fe_evaluation.h>
+#include <deal.II/matrix_free/operators.h>
+
+
+namespace SolidSolvers
+{
+using namespace dealii;
+
+
+/*
+ * Isotropic linear elasticity operator applied without a matrix:
+ * (2*mu*eps(u) + lambda*div(u)*I, eps(v)).
+ * The cell integrals are computed with sum factorization,
+ * vectorized over batches of cells.
+ * Lame parameters are stored per cell batch and quadrature point,
+ * so the same class serves the active level (double)
+ * and the multigrid levels (float).
+ */
+template <int dim, int fe_degree, typename number>
+class ElasticOperator
+    :
+    public MatrixFreeOperators::Base<dim, LinearAlgebra::distributed::Vector<number> >
+{
+ public:
+  typedef LinearAlgebra::distributed::Vector<number> VectorType;
+  typedef FEEvaluation<dim, fe_degree, fe_degree+1, dim, number> FEEval;
+
+  ElasticOperator();
+  void clear();
+  // tabulate lambda and mu in the quadrature points of the matrix-free object
+  void evaluate_coefficients(const Function<dim> &young_modulus,
+                             const Function<dim> &poisson_ratio);
+  virtual void compute_diagonal();
+
+ private:
+  virtual void apply_add(VectorType       &dst,
+                         const VectorType &src) const;
+  void local_apply(const MatrixFree<dim, number>               &data,
+                   VectorType                                  &dst,
+                   const VectorType                            &src,
+                   const std::pair<unsigned int, unsigned int> &cell_range) const;
+  void local_compute_diagonal(const MatrixFree<dim, number>               &data,
+                              VectorType                                  &dst,
+                              const unsigned int                          &dummy,
+                              const std::pair<unsigned int, unsigned int> &cell_range) const;
+  // stress in a quadrature point
+  void apply_quadrature_point(FEEval &phi,
+                              const unsigned int cell,
+                              const unsigned int q) const;
+
+  Table<2, VectorizedArray<number> > lambda, mu;
+};
+
+
+
+template <int dim, int fe_degree, typename number>
+ElasticOperator<dim, fe_degree, number>::ElasticOperator()
+    :
+    MatrixFreeOperators::Base<dim, VectorType>()
+{}  // eom
+
+
+
+template <int dim, int fe_degree, typename number>
+void
+ElasticOperator<dim, fe_degree, number>::clear()
+{
+  lambda.reinit(0, 0);
+  mu.reinit(0, 0);
+  MatrixFreeOperators::Base<dim, VectorType>::clear();
+}  // eom
+
+
+
+template <int dim, int fe_degree, typename number>
+void
+ElasticOperator<dim, fe_degree, number>::
+evaluate_coefficients(const Function<dim> &young_modulus,
+                      const Function<dim> &poisson_ratio)
+{
+  const unsigned int n_cells = this->data->n_macro_cells();
+  FEEval phi(*this->data);
+
+  lambda.reinit(n_cells, phi.n_q_points);
+  mu.reinit(n_cells, phi.n_q_points);
+
+  for (unsigned int cell=0; cell<n_cells; ++cell)
+  {
+    phi.reinit(cell);
+    for (unsigned int q=0; q<phi.n_q_points; ++q)
+    {
+      const Point<dim, VectorizedArray<number> > x = phi.quadrature_point(q);
+      // unpack the vectorized point lane by lane
+      for (unsigned int v=0; v<VectorizedArray<number>::n_array_elements; ++v)
+      {
+        Point<dim> p;
+        for (int d=0; d<dim; ++d)
+          p[d] = x[d][v];
+        const double E = young_modulus.value(p);
+        const double nu = poisson_ratio.value(p);
+        lambda(cell, q)[v] = E*nu/((1.0 + nu)*(1.0 - 2.0*nu));
+        mu(cell, q)[v] = 0.5*E/(1.0 + nu);
+      }
+    }
+  }  // end cell loop
+}  // eom
+
+
+
+template <int dim, int fe_degree, typename number>
+inline
+void
+ElasticOperator<dim, fe_degree, number>::
+apply_quadrature_point(FEEval &phi,
+                       const unsigned int cell,
+                       const unsigned int q) const
+{
+  SymmetricTensor<2, dim, VectorizedArray<number> >
+      stress = phi.get_symmetric_gradient(q);
+  const VectorizedArray<number> div = trace(stress);
+  stress *= 2.0*mu(cell, q);
+  for (int d=0; d<dim; ++d)
+    stress[d][d] += lambda(cell, q)*div;
+  phi.submit_symmetric_gradient(stress, q);
+}  // eom
+
+
+
+template <int dim, int fe_degree, typename number>
+void
+ElasticOperator<dim, fe_degree, number>::
+local_apply(const MatrixFree<dim, number>               &data,
+            VectorType                                  &dst,
+            const VectorType                            &src,
+            const std::pair<unsigned int, unsigned int> &cell_range) const
+{
+  FEEval phi(data);
+
+  for (unsigned int cell=cell_range.first; cell<cell_range.second; ++cell)
+  {
+    phi.reinit(cell);
+    phi.read_dof_values(src);
+    phi.evaluate(/* values = */ false, /* gradients = */ true);
+    for (unsigned int q=0; q<phi.n_q_points; ++q)
+      apply_quadrature_point(phi, cell, q);
+    phi.integrate(/* values = */ false, /* gradients = */ true);
+    phi.distribute_local_to_global(dst);
+  }
+}  // eom
+
+
+
+template <int dim, int fe_degree, typename number>
+void
+ElasticOperator<dim, fe_degree, number>::
+apply_add(VectorType       &dst,
+          const VectorType &src) const
+{
+  this->data->cell_loop(&ElasticOperator::local_apply, this, dst, src);
+}  // eom
+
+
+
+template <int dim, int fe_degree, typename number>
+void
+ElasticOperator<dim, fe_degree, number>::compute_diagonal()
+{
+  this->inverse_diagonal_entries.reset(new DiagonalMatrix<VectorType>());
+  VectorType &inverse_diagonal = this->inverse_diagonal_entries->get_vector();
+  this->data->initialize_dof_vector(inverse_diagonal);
+
+  unsigned int dummy = 0;
+  this->data->cell_loop(&ElasticOperator::local_compute_diagonal, this,
+                        inverse_diagonal, dummy);
+
+  this->set_constrained_entries_to_one(inverse_diagonal);
+
+  for (unsigned int i=0; i<inverse_diagonal.local_size(); ++i)
+  {
+    Assert(inverse_diagonal.local_element(i) > 0.,
+           ExcMessage("No diagonal entry in a positive definite operator"));
+    inverse_diagonal.local_element(i) = 1./inverse_diagonal.local_element(i);
+  }
+}  // eom
+
+
+
+template <int dim, int fe_degree, typename number>
+void
+ElasticOperator<dim, fe_degree, number>::
+local_compute_diagonal(const MatrixFree<dim, number>               &data,
+                       VectorType                                  &dst,
+                       const unsigned int                          &,
+                       const std::pair<unsigned int, unsigned int> &cell_range) const
+{
+  FEEval phi(data);
+  std::vector< VectorizedArray<number> > diagonal(phi.dofs_per_cell);
+
+  for (unsigned int cell=cell_range.first; cell<cell_range.second; ++cell)
+  {
+    phi.reinit(cell);
+    // apply the cell operator to the unit vectors
+    for (unsigned int i=0; i<phi.dofs_per_cell; ++i)
+    {
+      for (unsigned int j=0; j<phi.dofs_per_cell; ++j)
+        phi.begin_dof_values()[j] = VectorizedArray<number>();
+      phi.begin_dof_values()[i] = make_vectorized_array<number>(1.);
+      phi.evaluate(false, true);
+      for (unsigned int q=0; q<phi.n_q_points; ++q)
+        apply_quadrature_point(phi, cell, q);
+      phi.integrate(false, true);
+      diagonal[i] = phi.begin_dof_values()[i];
+    }
+    for (unsigned int i=0; i<phi.dofs_per_cell; ++i)
+      phi.begin_dof_values()[i] = diagonal[i];
+    phi.distribute_local_to_global(dst);
+  }
+}  // eom
+
+}  // end of namespace
+
+#endif
@@ -0,0 +1,841 @@
+#pragma once
+
+#include <deal.II/base/conditional_ostream.h>
+#include <deal.II/base/quadrature_lib.h>
+#include <deal.II/base/utilities.h>
+#include <deal.II/distributed/tria.h>
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/dofs/dof_tools.h>
+#include <deal.II/fe/fe_q.h>
+#include <deal.II/fe/fe_system.h>
+#include <deal.II/fe/fe_values.h>
+#include <deal.II/fe/mapping_q1.h>
+#include <deal.II/lac/constraint_matrix.h>
+#include <deal.II/lac/dynamic_sparsity_pattern.h>
+#include <deal.II/lac/sparsity_tools.h>
+#include <deal.II/lac/full_matrix.h>
+#include <deal.II/lac/trilinos_vector.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+#include <deal.II/lac/trilinos_solver.h>
+#include <deal.II/lac/trilinos_precondition.h>
+#include <deal.II/numerics/vector_tools.h>
+
+#include <Teuchos_ParameterList.hpp>
+#include <ml_MultiLevelPreconditioner.h>
+
+// Custom modules
+#include <Model.hpp>
+#include <ExtraFEData.hpp>
+#include <MatrixFreeElasticSolver.hpp>
+
+
+namespace SolidSolvers
+{
+using namespace dealii;
+
+
+/*
+ * Linear poroelasticity with Qk displacements:
+ * div(C:eps(u)) = div(alpha*(p - p_ref)*I).
+ * The roller condition (zero normal displacement) is imposed
+ * on the whole boundary.
+ * The stiffness matrix does not change in time, so it is assembled
+ * together with the AMG preconditioner once per setup_dofs;
+ * only the Biot load is assembled in every coupling iteration.
+ * With the matrix-free solver type no matrix is stored: the operator
+ * is applied cell by cell and preconditioned with geometric multigrid
+ * (see MatrixFreeElasticSolver).
+ * With a mechanics level the displacements live on the level cells of
+ * that (uniform) level of the flow forest. The Biot load is then
+ * integrated over the descendant flow cells and the strain is
+ * evaluated in the centers of the descendants, so flow and mechanics
+ * share the triangulation but not the cells.
+ */
+template <int dim>
+class ElasticSolver
+{
+ public:
+  ElasticSolver(MPI_Comm                                  &mpi_communicator_,
+                parallel::distributed::Triangulation<dim> &triangulation_,
+                const Model::Model<dim>                   &model_,
+                ConditionalOStream                        &pcout_);
+  ~ElasticSolver();
+  /* setup degrees of freedom and constraints for the current
+   * triangulation, allocate vectors, and assemble the stiffness matrix
+   * and the preconditioner
+   */
+  void setup_dofs();
+  /* Fill rhs vector with the Biot load.
+   * The pressure lives on a DG0 dof handler on the same triangulation.
+   */
+  void assemble_rhs(const DoFHandler<dim>               &pressure_dof_handler,
+                    const TrilinosWrappers::MPI::Vector &pressure,
+                    const TrilinosWrappers::MPI::Vector &reference_pressure);
+  // solve linear system system_matrix*solution = rhs_vector
+  unsigned int solve();
+  /* Compute divergence of the displacement in the centers of the
+   * locally owned cells and write it into a DG0 vector of the flow
+   * dof handler
+   */
+  void get_volumetric_strain(const DoFHandler<dim>         &flow_dof_handler,
+                             TrilinosWrappers::MPI::Vector &volumetric_strain);
+  // accessing private members
+  const DoFHandler<dim> & get_dof_handler();
+  // displacements on the level cells of model.mechanics_level
+  bool on_coarse_level() const;
+
+ private:
+  typedef typename DoFHandler<dim>::active_cell_iterator active_cell_iterator;
+  typedef typename DoFHandler<dim>::level_cell_iterator  level_cell_iterator;
+
+  void assemble_matrix();
+  template <typename Iterator>
+  void assemble_matrix(Iterator cell, const Iterator endc);
+  // rigid body modes of the owned dofs for the aggregation AMG
+  template <typename Iterator>
+  void compute_rigid_body_modes(Iterator cell, const Iterator endc);
+  bool is_owned(const active_cell_iterator &cell) const;
+  bool is_owned(const level_cell_iterator &cell) const;
+  // rollers on the mechanics level: zero normal component
+  void make_level_constraints();
+  // Biot load and strain for the mechanics level
+  void assemble_rhs_coarse(const DoFHandler<dim>               &pressure_dof_handler,
+                           const TrilinosWrappers::MPI::Vector &pressure,
+                           const TrilinosWrappers::MPI::Vector &reference_pressure);
+  void get_volumetric_strain_coarse(const DoFHandler<dim>         &flow_dof_handler,
+                                    TrilinosWrappers::MPI::Vector &volumetric_strain);
+  /* ancestor of a flow cell on the mechanics level and the index of the
+   * descendant center in the quadrature of get_descendant_fe_values
+   */
+  level_cell_iterator get_ancestor(const active_cell_iterator &flow_cell,
+                                   unsigned int               &descendant) const;
+  /* FEValues in the centers of the descendants of a mechanics cell
+   * that are depth levels finer. The center quadrature is exact for
+   * the divergence of Q1 functions on parallelepipeds.
+   */
+  FEValues<dim> & get_descendant_fe_values(const unsigned int depth);
+
+  MPI_Comm                                  &mpi_communicator;
+  parallel::distributed::Triangulation<dim> &triangulation;
+  DoFHandler<dim>                           dof_handler;
+  // degree is known after the input is read
+  std::unique_ptr< FESystem<dim> >          fe;
+  const Model::Model<dim>                   &model;
+  ConditionalOStream                        &pcout;
+  ConstraintMatrix                          constraints;
+
+  TrilinosWrappers::SparseMatrix            system_matrix;
+  TrilinosWrappers::PreconditionAMG         preconditioner;
+  // mode-major: n_modes blocks of locally owned dofs
+  std::vector<double>                       rigid_body_modes;
+  std::unique_ptr< MatrixFreeElasticSolverBase<dim> > matrix_free_solver;
+  std::vector< std::unique_ptr< FEValues<dim> > > descendant_fe_values;
+
+ public:
+  TrilinosWrappers::MPI::Vector solution, relevant_solution, rhs_vector;
+  IndexSet                      locally_owned_dofs, locally_relevant_dofs;
+};
+
+
+
+template <int dim>
+ElasticSolver<dim>::
+ElasticSolver(MPI_Comm                                  &mpi_communicator_,
+              parallel::distributed::Triangulation<dim> &triangulation_,
+              const Model::Model<dim>                   &model_,
+              ConditionalOStream                        &pcout_)
+    :
+    mpi_communicator(mpi_communicator_),
+    triangulation(triangulation_),
+    dof_handler(triangulation_),
+    model(model_),
+    pcout(pcout_)
+{}  // eom
+
+
+
+template <int dim>
+ElasticSolver<dim>::~ElasticSolver()
+{
+  dof_handler.clear();
+}  // eom
+
+
+
+template <int dim>
+void ElasticSolver<dim>::setup_dofs()
+{
+  if (!fe || static_cast<int>(fe->degree) != model.displacement_degree)
+    fe.reset(new FESystem<dim>(FE_Q<dim>(model.displacement_degree), dim));
+  const bool matrix_free =
+      (model.elastic_solver_type == Model::ElasticSolverType::MatrixFreeGMG);
+  AssertThrow(!(matrix_free && on_coarse_level()),
+              ExcMessage("Matrix-free elasticity works on the active cells only"));
+  descendant_fe_values.clear();
+
+  dof_handler.distribute_dofs(*fe);
+  if (matrix_free || on_coarse_level())
+    dof_handler.distribute_mg_dofs();
+
+  if (on_coarse_level())
+  {
+    const unsigned int level = model.mechanics_level;
+    { // the level must cover the whole domain
+      unsigned int min_level = triangulation.n_global_levels();
+      typename Triangulation<dim>::active_cell_iterator
+          cell = triangulation.begin_active(),
+          endc = triangulation.end();
+      for (; cell!=endc; ++cell)
+        if (cell->is_locally_owned())
+          min_level = std::min(min_level, static_cast<unsigned int>(cell->level()));
+      min_level = Utilities::MPI::min(min_level, mpi_communicator);
+      AssertThrow(level <= min_level,
+                  ExcMessage("Mechanics level is finer than the coarsest flow cells"));
+    }
+    locally_owned_dofs = dof_handler.locally_owned_mg_dofs(level);
+    DoFTools::extract_locally_relevant_level_dofs(dof_handler, level,
+                                                  locally_relevant_dofs);
+    make_level_constraints();
+  }
+  else
+  {
+    locally_owned_dofs = dof_handler.locally_owned_dofs();
+    DoFTools::extract_locally_relevant_dofs(dof_handler,
+                                            locally_relevant_dofs);
+    constraints.clear();
+    constraints.reinit(locally_relevant_dofs);
+    DoFTools::make_hanging_node_constraints(dof_handler, constraints);
+    // rollers on all boundaries
+    std::set<types::boundary_id> boundary_ids;
+    for (const auto & id : triangulation.get_boundary_ids())
+      boundary_ids.insert(id);
+    VectorTools::compute_no_normal_flux_constraints(dof_handler,
+                                                    /* first_component = */ 0,
+                                                    boundary_ids,
+                                                    constraints);
+    constraints.close();
+  }
+
+  { // vectors
+    solution.reinit(locally_owned_dofs, mpi_communicator);
+    relevant_solution.reinit(locally_relevant_dofs, mpi_communicator);
+    if (on_coarse_level()) // flow cells add to the dofs of non-owned ancestors
+      rhs_vector.reinit(locally_owned_dofs, locally_relevant_dofs,
+                        mpi_communicator, /* omit-zeros=*/ true);
+    else
+      rhs_vector.reinit(locally_owned_dofs, mpi_communicator);
+  }
+
+  system_matrix.clear();
+  if (matrix_free)
+  {
+    if (!matrix_free_solver)
+      matrix_free_solver.reset(create_matrix_free_solver(mpi_communicator,
+                                                         model, pcout));
+    matrix_free_solver->setup(dof_handler, constraints);
+    return;
+  }
+
+  { // system matrix
+    DynamicSparsityPattern dsp(locally_relevant_dofs);
+    if (on_coarse_level())
+    {
+      const unsigned int level = model.mechanics_level;
+      std::vector<types::global_dof_index> local_dof_indices(fe->dofs_per_cell);
+      level_cell_iterator
+          cell = dof_handler.begin_mg(level),
+          endc = dof_handler.end_mg(level);
+      for (; cell!=endc; ++cell)
+        if (is_owned(cell))
+        {
+          cell->get_dof_indices(local_dof_indices);
+          constraints.add_entries_local_to_global(local_dof_indices, dsp,
+                                                  /* keep_constrained_dofs = */ false);
+        }
+      SparsityTools::distribute_sparsity_pattern
+          (dsp, dof_handler.locally_owned_mg_dofs_per_processor(level),
+           mpi_communicator, locally_relevant_dofs);
+    }
+    else
+    {
+      DoFTools::make_sparsity_pattern(dof_handler, dsp, constraints,
+                                      /* keep_constrained_dofs = */ false);
+      SparsityTools::distribute_sparsity_pattern
+          (dsp, dof_handler.n_locally_owned_dofs_per_processor(),
+           mpi_communicator, locally_relevant_dofs);
+    }
+    system_matrix.reinit(locally_owned_dofs, locally_owned_dofs,
+                         dsp, mpi_communicator);
+  }
+
+  assemble_matrix();
+
+  if (on_coarse_level())
+    compute_rigid_body_modes(dof_handler.begin_mg(model.mechanics_level),
+                             dof_handler.end_mg(model.mechanics_level));
+  else
+    compute_rigid_body_modes(dof_handler.begin_active(),
+                             active_cell_iterator(dof_handler.end()));
+
+  { // preconditioner
+    Teuchos::ParameterList parameter_list;
+    ML_Epetra::SetDefaults("SA", parameter_list);
+    parameter_list.set("smoother: type", "Chebyshev");
+    parameter_list.set("smoother: sweeps", 2);
+    parameter_list.set("aggregation: type", "Uncoupled");
+    parameter_list.set("coarse: max size", 2000);
+    parameter_list.set("PDE equations", dim);
+    parameter_list.set("null space: type", "pre-computed");
+    parameter_list.set("null space: dimension", (dim == 3) ? 6 : 3);
+    parameter_list.set("null space: vectors", rigid_body_modes.data());
+    preconditioner.initialize(system_matrix, parameter_list);
+  }
+}  // eom
+
+
+
+template <int dim>
+inline
+bool
+ElasticSolver<dim>::is_owned(const active_cell_iterator &cell) const
+{
+  return cell->is_locally_owned();
+}  // eom
+
+
+
+template <int dim>
+inline
+bool
+ElasticSolver<dim>::is_owned(const level_cell_iterator &cell) const
+{
+  return cell->level_subdomain_id() == triangulation.locally_owned_subdomain();
+}  // eom
+
+
+
+template <int dim>
+void ElasticSolver<dim>::make_level_constraints()
+{
+  const unsigned int level = model.mechanics_level;
+  constraints.clear();
+  constraints.reinit(locally_relevant_dofs);
+
+  std::vector<types::global_dof_index> face_dof_indices(fe->dofs_per_face);
+
+  level_cell_iterator
+      cell = dof_handler.begin_mg(level),
+      endc = dof_handler.end_mg(level);
+
+  for (; cell!=endc; ++cell)
+    if (cell->level_subdomain_id() != numbers::artificial_subdomain_id &&
+        cell->at_boundary())
+      for (unsigned int f=0; f<GeometryInfo<dim>::faces_per_cell; ++f)
+        if (cell->at_boundary(f))
+        {
+          // normal direction of the face
+          const Tensor<1,dim> d = cell->face(f)->center() - cell->center();
+          unsigned int normal_component = 0;
+          for (int c=1; c<dim; ++c)
+            if (std::abs(d[c]) > std::abs(d[normal_component]))
+              normal_component = c;
+          for (int c=0; c<dim; ++c)
+            AssertThrow(c == static_cast<int>(normal_component) ||
+                        std::abs(d[c]) < 1e-10*d.norm(),
+                        ExcMessage("Mechanics level requires "
+                                   "boundaries normal to the coordinate axes"));
+
+          cell->face(f)->get_mg_dof_indices(level, face_dof_indices);
+          for (unsigned int i=0; i<fe->dofs_per_face; ++i)
+            if (fe->face_system_to_component_index(i).first == normal_component &&
+                locally_relevant_dofs.is_element(face_dof_indices[i]))
+              constraints.add_line(face_dof_indices[i]);
+        }
+
+  constraints.close();
+}  // eom
+
+
+
+template <int dim>
+void ElasticSolver<dim>::assemble_matrix()
+{
+  system_matrix = 0;
+
+  if (on_coarse_level())
+    assemble_matrix(dof_handler.begin_mg(model.mechanics_level),
+                    dof_handler.end_mg(model.mechanics_level));
+  else
+    assemble_matrix(dof_handler.begin_active(),
+                    active_cell_iterator(dof_handler.end()));
+
+  system_matrix.compress(VectorOperation::add);
+}  // eom
+
+
+
+template <int dim>
+template <typename Iterator>
+void ElasticSolver<dim>::assemble_matrix(Iterator cell, const Iterator endc)
+{
+  const QGauss<dim> quadrature_formula(fe->degree + 1);
+  FEValues<dim> fe_values(*fe, quadrature_formula,
+                          update_gradients | update_quadrature_points |
+                          update_JxW_values);
+
+  const unsigned int dofs_per_cell = fe->dofs_per_cell;
+  const unsigned int n_q_points = quadrature_formula.size();
+  const FEValuesExtractors::Vector displacement(0);
+
+  FullMatrix<double>                   cell_matrix(dofs_per_cell, dofs_per_cell);
+  std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+  std::vector<SymmetricTensor<2,dim>>  eps_phi(dofs_per_cell);
+  std::vector<double>                  div_phi(dofs_per_cell);
+
+  for (; cell!=endc; ++cell)
+    if (is_owned(cell))
+    {
+      fe_values.reinit(cell);
+      cell_matrix = 0;
+
+      for (unsigned int q=0; q<n_q_points; ++q)
+      {
+        const Point<dim> & x = fe_values.quadrature_point(q);
+        const double E = model.get_young_modulus->value(x);
+        const double nu = model.get_poisson_ratio->value(x);
+        // Lame parameters
+        const double lambda = E*nu/((1.0 + nu)*(1.0 - 2.0*nu));
+        const double mu = 0.5*E/(1.0 + nu);
+
+        for (unsigned int i=0; i<dofs_per_cell; ++i)
+        {
+          eps_phi[i] = fe_values[displacement].symmetric_gradient(i, q);
+          div_phi[i] = fe_values[displacement].divergence(i, q);
+        }
+
+        for (unsigned int i=0; i<dofs_per_cell; ++i)
+          for (unsigned int j=0; j<dofs_per_cell; ++j)
+            cell_matrix(i, j) +=
+                (2*mu*eps_phi[i]*eps_phi[j] + lambda*div_phi[i]*div_phi[j]) *
+                fe_values.JxW(q);
+      }  // end q_point loop
+
+      cell->get_dof_indices(local_dof_indices);
+      constraints.distribute_local_to_global(cell_matrix, local_dof_indices,
+                                             system_matrix);
+    }  // end cell loop
+}  // eom
+
+
+
+template <int dim>
+template <typename Iterator>
+void ElasticSolver<dim>::compute_rigid_body_modes(Iterator cell, const Iterator endc)
+{
+  /*
+   * Translations in each direction and rotations around the axes:
+   * dim + 1 modes in 2d, 2*dim modes in 3d.
+   * The modes are evaluated in the support points of the dofs.
+   */
+  const unsigned int n_rotations = (dim == 3) ? 3 : 1;
+  const unsigned int n_modes = dim + n_rotations;
+  const unsigned int n_owned = locally_owned_dofs.n_elements();
+  rigid_body_modes.assign(n_modes*n_owned, 0.0);
+
+  const unsigned int dofs_per_cell = fe->dofs_per_cell;
+  std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+
+  const MappingQ1<dim> mapping;
+  const std::vector< Point<dim> > & unit_support_points =
+      fe->get_unit_support_points();
+
+  for (; cell!=endc; ++cell)
+    if (is_owned(cell))
+    {
+      cell->get_dof_indices(local_dof_indices);
+      for (unsigned int i=0; i<dofs_per_cell; ++i)
+      {
+        if (!locally_owned_dofs.is_element(local_dof_indices[i]))
+          continue;
+
+        const unsigned int row =
+            locally_owned_dofs.index_within_set(local_dof_indices[i]);
+        const unsigned int component = fe->system_to_component_index(i).first;
+        const Point<dim> x =
+            mapping.transform_unit_to_real_cell(cell, unit_support_points[i]);
+
+        // translation
+        rigid_body_modes[component*n_owned + row] = 1.0;
+
+        // rotations: (-y, x, 0), (0, -z, y), (z, 0, -x)
+        double * rotation = &rigid_body_modes[dim*n_owned + row];
+        if (component == 0)
+        {
+          rotation[0] = -x[1];
+          if (dim == 3)
+            rotation[2*n_owned] = x[2];
+        }
+        else if (component == 1)
+        {
+          rotation[0] = x[0];
+          if (dim == 3)
+            rotation[n_owned] = -x[2];
+        }
+        else if (component == 2)
+        {
+          rotation[n_owned] = x[1];
+          rotation[2*n_owned] = -x[0];
+        }
+      }  // end dof loop
+    }  // end cell loop
+}  // eom
+
+
+
+template <int dim>
+void
+ElasticSolver<dim>::
+assemble_rhs(const DoFHandler<dim>               &pressure_dof_handler,
+             const TrilinosWrappers::MPI::Vector &pressure,
+             const TrilinosWrappers::MPI::Vector &reference_pressure)
+{
+  if (on_coarse_level())
+  {
+    assemble_rhs_coarse(pressure_dof_handler, pressure, reference_pressure);
+    return;
+  }
+
+  const QGauss<dim> quadrature_formula(fe->degree + 1);
+  FEValues<dim> fe_values(*fe, quadrature_formula,
+                          update_gradients | update_JxW_values);
+
+  const unsigned int dofs_per_cell = fe->dofs_per_cell;
+  const unsigned int n_q_points = quadrature_formula.size();
+  const FEValuesExtractors::Vector displacement(0);
+
+  Vector<double>                       cell_rhs(dofs_per_cell);
+  std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+  std::vector<types::global_dof_index>
+      pressure_dof_indices(pressure_dof_handler.get_fe().dofs_per_cell);
+
+  rhs_vector = 0;
+
+  typename DoFHandler<dim>::active_cell_iterator
+      cell = dof_handler.begin_active(),
+      endc = dof_handler.end();
+
+  for (; cell!=endc; ++cell)
+    if (cell->is_locally_owned())
+    {
+      // same cell in the flow dof handler
+      const typename DoFHandler<dim>::active_cell_iterator
+          pressure_cell(&triangulation, cell->level(), cell->index(),
+                        &pressure_dof_handler);
+      pressure_cell->get_dof_indices(pressure_dof_indices);
+      const double dp = pressure(pressure_dof_indices[0]) -
+          reference_pressure(pressure_dof_indices[0]);
+
+      fe_values.reinit(cell);
+      cell_rhs = 0;
+      for (unsigned int q=0; q<n_q_points; ++q)
+        for (unsigned int i=0; i<dofs_per_cell; ++i)
+          cell_rhs(i) += model.biot_coefficient * dp *
+              fe_values[displacement].divergence(i, q) * fe_values.JxW(q);
+
+      cell->get_dof_indices(local_dof_indices);
+      constraints.distribute_local_to_global(cell_rhs, local_dof_indices,
+                                             rhs_vector);
+    }  // end cell loop
+
+  rhs_vector.compress(VectorOperation::add);
+}  // eom
+
+
+
+template <int dim>
+unsigned int
+ElasticSolver<dim>::solve()
+{
+  double tol = 1e-10*rhs_vector.l2_norm();
+  if (tol == 0.0)
+    tol = 1e-10;
+
+  unsigned int n_iterations = 0;
+  if (matrix_free_solver &&
+      model.elastic_solver_type == Model::ElasticSolverType::MatrixFreeGMG)
+    n_iterations = matrix_free_solver->solve(solution, rhs_vector, tol);
+  else
+  {
+    SolverControl solver_control(1000, tol);
+
+    TrilinosWrappers::SolverCG::AdditionalData additional_data_cg;
+    TrilinosWrappers::SolverCG solver(solver_control, additional_data_cg);
+    solver.solve(system_matrix, solution, rhs_vector, preconditioner);
+    n_iterations = solver_control.last_step();
+  }
+
+  constraints.distribute(solution);
+  relevant_solution = solution;
+
+  return n_iterations;
+}  // eom
+
+
+
+template <int dim>
+void
+ElasticSolver<dim>::
+get_volumetric_strain(const DoFHandler<dim>         &flow_dof_handler,
+                      TrilinosWrappers::MPI::Vector &volumetric_strain)
+{
+  if (on_coarse_level())
+  {
+    get_volumetric_strain_coarse(flow_dof_handler, volumetric_strain);
+    return;
+  }
+
+  // the two dof handlers are traversed in lockstep
+  std::vector<unsigned int> vectors_per_dof_handler = {1};
+  std::vector< const DoFHandler<dim>* > dof_handlers = {&dof_handler};
+  std::vector< std::vector<TrilinosWrappers::MPI::Vector*> >
+      vectors = {{&relevant_solution}};
+  std::vector< std::vector<ExtraFEData::FEDerivativeOrder> >
+      derivative_orders = {{ExtraFEData::FEDerivativeOrder::divergence}};
+
+  // cell-center value
+  QGauss<dim> quadrature_formula(1);
+  ExtraFEData::ExtraFEData<dim> extra_data(vectors_per_dof_handler,
+                                           quadrature_formula.size());
+  extra_data.set_data(dof_handlers, vectors, derivative_orders);
+  extra_data.make_fe_values(quadrature_formula);
+
+  std::vector<types::global_dof_index>
+      dof_indices(flow_dof_handler.get_fe().dofs_per_cell);
+
+  extra_data.cells_begin();
+  typename DoFHandler<dim>::active_cell_iterator
+      cell = flow_dof_handler.begin_active(),
+      endc = flow_dof_handler.end();
+
+  for (; cell!=endc; ++cell, extra_data.increment_cells())
+    if (cell->is_locally_owned())
+    {
+      extra_data.reinit();
+      extra_data.update_fe_values();
+      cell->get_dof_indices(dof_indices);
+      volumetric_strain[dof_indices[0]] = extra_data.get_values(0)[0];
+    }
+
+  volumetric_strain.compress(VectorOperation::insert);
+}  // eom
+
+
+
+template <int dim>
+typename DoFHandler<dim>::level_cell_iterator
+ElasticSolver<dim>::get_ancestor(const active_cell_iterator &flow_cell,
+                                 unsigned int               &descendant) const
+{
+  const int level = model.mechanics_level;
+  const unsigned int n_children = GeometryInfo<dim>::max_children_per_cell;
+
+  // child indices from the flow cell upwards
+  descendant = 0;
+  unsigned int weight = 1;
+  typename Triangulation<dim>::cell_iterator
+      cell(&triangulation, flow_cell->level(), flow_cell->index());
+  while (cell->level() > level)
+  {
+    const auto parent = cell->parent();
+    unsigned int c = 0;
+    while (parent->child(c) != cell)
+      ++c;
+    descendant += c*weight;
+    weight *= n_children;
+    cell = parent;
+  }
+
+  return level_cell_iterator(&triangulation, cell->level(), cell->index(),
+                             &dof_handler);
+}  // eom
+
+
+
+template <int dim>
+FEValues<dim> &
+ElasticSolver<dim>::get_descendant_fe_values(const unsigned int depth)
+{
+  if (descendant_fe_values.size() <= depth)
+    descendant_fe_values.resize(depth + 1);
+
+  if (!descendant_fe_values[depth])
+  {
+    /* Centers of the descendants in the unit cell;
+     * the child index on the first level below is the most significant digit.
+     * Children are numbered lexicographically in the unit cell.
+     */
+    const unsigned int n_children = GeometryInfo<dim>::max_children_per_cell;
+    unsigned int n_points = 1;
+    for (unsigned int k=0; k<depth; ++k)
+      n_points *= n_children;
+
+    std::vector< Point<dim> > points(n_points);
+    std::vector<double>       weights(n_points, 1.0/n_points);
+    for (unsigned int q=0; q<n_points; ++q)
+    {
+      unsigned int digits = q;
+      double h = std::pow(0.5, static_cast<double>(depth));
+      for (int d=0; d<dim; ++d)
+        points[q][d] = 0.5*h;
+      for (unsigned int k=0; k<depth; ++k, h*=2)
+      {
+        const unsigned int child = digits % n_children;
+        digits /= n_children;
+        for (int d=0; d<dim; ++d)
+          if (child & (1 << d))
+            points[q][d] += h;
+      }
+    }
+
+    descendant_fe_values[depth].reset
+        (new FEValues<dim>(*fe, Quadrature<dim>(points, weights),
+                           update_gradients | update_JxW_values));
+  }
+
+  return *descendant_fe_values[depth];
+}  // eom
+
+
+
+template <int dim>
+void
+ElasticSolver<dim>::
+assemble_rhs_coarse(const DoFHandler<dim>               &pressure_dof_handler,
+                    const TrilinosWrappers::MPI::Vector &pressure,
+                    const TrilinosWrappers::MPI::Vector &reference_pressure)
+{
+  /*
+   * Each process integrates the Biot load over its flow cells:
+   * the pressure is constant in a flow cell, so the load on the ancestor
+   * dofs is alpha*dp*div(phi)*|flow cell| in the flow cell center
+   */
+  const unsigned int dofs_per_cell = fe->dofs_per_cell;
+  const FEValuesExtractors::Vector displacement(0);
+
+  Vector<double>                       cell_rhs(dofs_per_cell);
+  std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+  std::vector<types::global_dof_index>
+      pressure_dof_indices(pressure_dof_handler.get_fe().dofs_per_cell);
+
+  rhs_vector = 0;
+
+  std::vector<level_cell_iterator>     current_ancestors;
+
+  typename DoFHandler<dim>::active_cell_iterator
+      cell = pressure_dof_handler.begin_active(),
+      endc = pressure_dof_handler.end();
+
+  for (; cell!=endc; ++cell)
+    if (cell->is_locally_owned())
+    {
+      cell->get_dof_indices(pressure_dof_indices);
+      const double dp = pressure(pressure_dof_indices[0]) -
+          reference_pressure(pressure_dof_indices[0]);
+
+      unsigned int q = 0;
+      const level_cell_iterator ancestor = get_ancestor(cell, q);
+      const unsigned int depth = cell->level() - ancestor->level();
+      FEValues<dim> & fe_values = get_descendant_fe_values(depth);
+      // consecutive flow cells mostly share the ancestor
+      if (current_ancestors.size() <= depth)
+        current_ancestors.resize(depth + 1);
+      if (current_ancestors[depth] != ancestor)
+      {
+        fe_values.reinit(ancestor);
+        current_ancestors[depth] = ancestor;
+      }
+
+      // descendant weights sum up to the ancestor volume
+      for (unsigned int i=0; i<dofs_per_cell; ++i)
+        cell_rhs(i) = model.biot_coefficient * dp *
+            fe_values[displacement].divergence(i, q) * fe_values.JxW(q);
+
+      ancestor->get_dof_indices(local_dof_indices);
+      constraints.distribute_local_to_global(cell_rhs, local_dof_indices,
+                                             rhs_vector);
+    }  // end cell loop
+
+  rhs_vector.compress(VectorOperation::add);
+}  // eom
+
+
+
+template <int dim>
+void
+ElasticSolver<dim>::
+get_volumetric_strain_coarse(const DoFHandler<dim>         &flow_dof_handler,
+                             TrilinosWrappers::MPI::Vector &volumetric_strain)
+{
+  const unsigned int dofs_per_cell = fe->dofs_per_cell;
+  const FEValuesExtractors::Vector displacement(0);
+
+  std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+  std::vector<types::global_dof_index>
+      dof_indices(flow_dof_handler.get_fe().dofs_per_cell);
+
+  std::vector<level_cell_iterator>     current_ancestors;
+
+  typename DoFHandler<dim>::active_cell_iterator
+      cell = flow_dof_handler.begin_active(),
+      endc = flow_dof_handler.end();
+
+  for (; cell!=endc; ++cell)
+    if (cell->is_locally_owned())
+    {
+      unsigned int q = 0;
+      const level_cell_iterator ancestor = get_ancestor(cell, q);
+      const unsigned int depth = cell->level() - ancestor->level();
+      FEValues<dim> & fe_values = get_descendant_fe_values(depth);
+      // consecutive flow cells mostly share the ancestor
+      if (current_ancestors.size() <= depth)
+        current_ancestors.resize(depth + 1);
+      if (current_ancestors[depth] != ancestor)
+      {
+        fe_values.reinit(ancestor);
+        current_ancestors[depth] = ancestor;
+      }
+      ancestor->get_dof_indices(local_dof_indices);
+
+      // divergence of the coarse displacement in the flow cell center
+      double strain = 0;
+      for (unsigned int i=0; i<dofs_per_cell; ++i)
+        strain += relevant_solution(local_dof_indices[i]) *
+            fe_values[displacement].divergence(i, q);
+
+      cell->get_dof_indices(dof_indices);
+      volumetric_strain[dof_indices[0]] = strain;
+    }
+
+  volumetric_strain.compress(VectorOperation::insert);
+}  // eom
+
+
+
+template <int dim>
+const DoFHandler<dim> &
+ElasticSolver<dim>::get_dof_handler()
+{
+  return dof_handler;
+}  // eom
+
+
+
+template <int dim>
+inline
+bool
+ElasticSolver<dim>::on_coarse_level() const
+{
+  return model.mechanics_level >= 0;
+}  // eom
+
+}  // end of namespace
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <deal.II/fe/fe_values.h>
+
 namespace ExtraFEData
 {
 using namespace dealii;
@@ -52,20 +54,21 @@ ExtraFEData(const std::vector<unsigned int> vectors_per_dof_handler,
 {
   const unsigned int n_dof_handlers = vectors_per_dof_handler.size();
   this->n_quadrature_points = n_quadrature_points;
+  unsigned int n_values = 0;
   for (unsigned int i=0; i<n_dof_handlers; ++i)
   {
     const unsigned int n_vectors = vectors_per_dof_handler[i];
-    unsigned int n_values = 0;
     vectors[i].resize(n_vectors);
     derivative_orders[i].resize(n_vectors);
     values[i].resize(n_vectors);
     for (unsigned int j=0; j<n_vectors; ++j)
     {
       values[i][j].resize(n_quadrature_points);
-      n_values += n_quadrature_points;
+      n_values++;
     }
-    unpacked_values.resize(n_values);
   }
+  // one value per vector at the requested quadrature point
+  unpacked_values.resize(n_values);
 }  // eom
 
 
@@ -99,8 +102,12 @@ make_fe_values(QGauss<dim> &quadrature_formula)
   for (unsigned int i=0; i<dof_handlers.size(); ++i)
   {
     const auto & fe = dof_handlers[i]->get_fe();
+    UpdateFlags flags = update_values;
+    for (const auto & order : derivative_orders[i])
+      if (order == FEDerivativeOrder::divergence)
+        flags = flags | update_gradients;
     fe_values[i] =
-        new FEValues<dim>(fe, quadrature_formula, update_values);
+        new FEValues<dim>(fe, quadrature_formula, flags);
   }
 }  // eom
 
@@ -160,6 +167,13 @@ void ExtraFEData<dim>::update_fe_values()
     {
       if (derivative_orders[i][j] == FEDerivativeOrder::values)
         fe_values[i]->get_function_values(*(vectors[i][j]), values[i][j]);
+      else if (derivative_orders[i][j] == FEDerivativeOrder::divergence)
+      {
+        // divergence of the first dim components (e.g. displacement)
+        const FEValuesExtractors::Vector vector_field(0);
+        (*fe_values[i])[vector_field].get_function_divergences(*(vectors[i][j]),
+                                                               values[i][j]);
+      }
       else
         AssertThrow(false, ExcNotImplemented());
     }
@@ -172,9 +186,13 @@ template<int dim>
 const std::vector<double> &
 ExtraFEData<dim>::get_values(const unsigned int q_point)
 {
+  unsigned int k = 0;
   for (unsigned int i=0; i<values.size(); ++i)
-    for (unsigned int j=0; j<values.size(); ++j)
-      unpacked_values[i+j] = values[i][j][q_point];
+    for (unsigned int j=0; j<values[i].size(); ++j)
+    {
+      unpacked_values[k] = values[i][j][q_point];
+      k++;
+    }
   return unpacked_values;
 } // eom
 
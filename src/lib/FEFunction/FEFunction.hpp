@@ -14,6 +14,11 @@ namespace FEFunction
 using namespace dealii;
 
 
+/*
+ * Evaluate a cell-wise constant (FE_DGQ(0)) field at a point.
+ * The value of the cell containing the point is read from the vector
+ * directly, so an evaluation does not allocate memory
+ */
 template <int dim, typename VectorType>
 class FEFunction : public Function<dim>
 {
@@ -33,6 +38,7 @@ class FEFunction : public Function<dim>
   const VectorType               dummy; // to supress compilation warning
   const std::vector<VectorType>  dummy_std;
   const VectorType               &single_vector;
+  mutable std::vector<types::global_dof_index> dof_indices;
 };
 
 
@@ -70,12 +76,8 @@ FEFunction<dim,VectorType>::value(const Point<dim> &p,
   AssertThrow(dof_handler.has_active_dofs(), ExcMessage("DofHandler is empty"));
   AssertThrow(vectors.size() == 0, ExcMessage("Either vectors or single_vector should be empty"));
   AssertThrow(component == 0, ExcNotImplemented());
-
-  const auto & fe = dof_handler.get_fe();
-
-  QGauss<dim>   quadrature_formula(1);
-  FEValues<dim> fe_values(fe, quadrature_formula, update_values);
-  std::vector<double>  v_values(quadrature_formula.size());
+  AssertThrow(dof_handler.get_fe().dofs_per_cell == 1, ExcNotImplemented());
+  dof_indices.resize(1);
 
   double result = 0;
 
@@ -87,9 +89,8 @@ FEFunction<dim,VectorType>::value(const Point<dim> &p,
     if (!cell->is_artificial())
       if (cell->point_inside(p))
       {
-        fe_values.reinit(cell);
-        fe_values.get_function_values(single_vector, v_values);
-        result = v_values[0];
+        cell->get_dof_indices(dof_indices);
+        result = single_vector[dof_indices[0]];
         break;
       }  // end cell loop
 
@@ -105,13 +106,8 @@ FEFunction<dim,VectorType>::vector_value(const Point<dim> &p,
 {
   /* Don't call this function before setup_dofs */
   AssertThrow(dof_handler.has_active_dofs(), ExcMessage("DofHandler is empty"));
-
-  const auto & fe = dof_handler.get_fe();
-
-  QGauss<dim>   quadrature_formula(1);
-  FEValues<dim> fe_values(fe, quadrature_formula, update_values);
-
-  std::vector<double>  v_values(quadrature_formula.size());
+  AssertThrow(dof_handler.get_fe().dofs_per_cell == 1, ExcNotImplemented());
+  dof_indices.resize(1);
 
   // set vector to zero
   for (auto & value: dst)
@@ -125,12 +121,9 @@ FEFunction<dim,VectorType>::vector_value(const Point<dim> &p,
     if (!cell->is_artificial())
       if (cell->point_inside(p))
       {
-        fe_values.reinit(cell);
+        cell->get_dof_indices(dof_indices);
         for (unsigned int c=0; c<vectors.size(); ++c)
-        {
-          fe_values.get_function_values(vectors[c], v_values);
-          dst[c] = v_values[0];
-        }
+          dst[c] = vectors[c][dof_indices[0]];
         break;
       }  // end cell loop
 
@@ -0,0 +1,450 @@
+#pragma once
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/dofs/dof_accessor.h>
+#include <deal.II/base/quadrature_lib.h>
+#include <deal.II/fe/fe_values.h>
+#include <deal.II/lac/trilinos_vector.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+
+
+/*
+ * Helper functions for cell-centered finite volumes (FE_DGQ(0))
+ * on distributed meshes
+ */
+namespace FVTools
+{
+using namespace dealii;
+
+
+
+/*
+ * Storage for the TPFA cell loops of a solver. It is created once per
+ * dof distribution and reused in every time step, so the loops do not
+ * allocate. Only the face geometry is evaluated with FE objects:
+ * values of the FE_DGQ(0) fields are read from the vectors by the
+ * cell dof index.
+ */
+template <int dim>
+struct ScratchData
+{
+  ScratchData(const FiniteElement<dim> &fe,
+              const unsigned int        n_phases);
+
+  QGauss<dim-1>                        face_quadrature_formula;
+  FEFaceValues<dim>                    fe_face_values;
+  // We need JxW flag for subfaces since there is no
+  // method to determine sub face area in triangulation class
+  FESubfaceValues<dim>                 fe_subface_values;
+  // saturations of the cell and the neighbor (all phases but the last)
+  std::vector<double>                  extra_values;
+};
+
+
+
+template <int dim>
+ScratchData<dim>::ScratchData(const FiniteElement<dim> &fe,
+                              const unsigned int        n_phases)
+    :
+    face_quadrature_formula(1),
+    fe_face_values(fe, face_quadrature_formula,
+                   update_normal_vectors),
+    fe_subface_values(fe, face_quadrature_formula,
+                      update_normal_vectors | update_JxW_values),
+    extra_values(n_phases - 1)
+{}  // eom
+
+
+
+template <int dim>
+void extract_face_relevant_dofs(const DoFHandler<dim> &dof_handler,
+                                IndexSet              &relevant_dofs)
+{
+  /*
+   * The TPFA stencil only couples cells that share a face,
+   * so ghost values are needed only for the face neighbors
+   * of the locally owned cells (unlike
+   * DoFTools::extract_locally_relevant_dofs that takes all
+   * cells sharing a vertex with the subdomain).
+   * Handles neighbors on the same level, coarser neighbors,
+   * and the children of finer neighbors
+   */
+  const unsigned int dofs_per_cell = dof_handler.get_fe().dofs_per_cell;
+  std::vector<types::global_dof_index> dof_indices(dofs_per_cell);
+  std::vector<types::global_dof_index> ghost_dofs;
+
+  typename DoFHandler<dim>::active_cell_iterator
+      cell = dof_handler.begin_active(),
+      endc = dof_handler.end();
+
+  for (; cell!=endc; ++cell)
+    if (cell->is_locally_owned())
+      for (unsigned int f=0; f<GeometryInfo<dim>::faces_per_cell; ++f)
+      {
+        if (cell->at_boundary(f))
+          continue;
+
+        if (cell->neighbor(f)->has_children())
+        {
+          for (unsigned int subface=0;
+               subface<cell->face(f)->n_children(); ++subface)
+          {
+            const auto & neighbor = cell->neighbor_child_on_subface(f, subface);
+            if (!neighbor->is_locally_owned())
+            {
+              neighbor->get_dof_indices(dof_indices);
+              ghost_dofs.insert(ghost_dofs.end(),
+                                dof_indices.begin(), dof_indices.end());
+            }
+          }
+        }
+        else
+        {
+          // same level or coarser neighbor
+          const auto & neighbor = cell->neighbor(f);
+          if (!neighbor->is_locally_owned())
+          {
+            neighbor->get_dof_indices(dof_indices);
+            ghost_dofs.insert(ghost_dofs.end(),
+                              dof_indices.begin(), dof_indices.end());
+          }
+        }
+      }  // end face loop
+
+  std::sort(ghost_dofs.begin(), ghost_dofs.end());
+  ghost_dofs.erase(std::unique(ghost_dofs.begin(), ghost_dofs.end()),
+                   ghost_dofs.end());
+
+  relevant_dofs.clear();
+  relevant_dofs = dof_handler.locally_owned_dofs();
+  relevant_dofs.add_indices(ghost_dofs.begin(), ghost_dofs.end());
+  relevant_dofs.compress();
+}  // eom
+
+
+
+template <int dim>
+unsigned int
+sort_subdomain_cells(const DoFHandler<dim> &dof_handler,
+                     std::vector<typename DoFHandler<dim>::active_cell_iterator>
+                     &owned_cells)
+{
+  /*
+   * Fill owned_cells with the locally owned cells: first the interior
+   * cells, whose face neighbors are all locally owned, then the
+   * subdomain boundary cells, which have at least one ghost
+   * face neighbor. Returns the number of interior cells.
+   * Interior cells can be processed before ghost values arrive.
+   * Both groups keep the order of the active cell iteration
+   */
+  std::vector<typename DoFHandler<dim>::active_cell_iterator> boundary_cells;
+  owned_cells.clear();
+
+  typename DoFHandler<dim>::active_cell_iterator
+      cell = dof_handler.begin_active(),
+      endc = dof_handler.end();
+
+  for (; cell!=endc; ++cell)
+    if (cell->is_locally_owned())
+    {
+      bool has_ghost_neighbor = false;
+      for (unsigned int f=0; f<GeometryInfo<dim>::faces_per_cell; ++f)
+      {
+        if (cell->at_boundary(f))
+          continue;
+
+        if (cell->neighbor(f)->has_children())
+        {
+          for (unsigned int subface=0;
+               subface<cell->face(f)->n_children(); ++subface)
+            if (!cell->neighbor_child_on_subface(f, subface)->is_locally_owned())
+              has_ghost_neighbor = true;
+        }
+        else if (!cell->neighbor(f)->is_locally_owned())
+          has_ghost_neighbor = true;
+
+        if (has_ghost_neighbor)
+          break;
+      }  // end face loop
+
+      if (has_ghost_neighbor)
+        boundary_cells.push_back(cell);
+      else
+        owned_cells.push_back(cell);
+    }
+
+  const unsigned int n_interior_cells = owned_cells.size();
+  owned_cells.insert(owned_cells.end(),
+                     boundary_cells.begin(), boundary_cells.end());
+  return n_interior_cells;
+}  // eom
+
+
+
+/*
+ * Dof indices of the cells and face neighbors visited by the TPFA
+ * loops of a solver, in the order of owned_cells and, within a cell,
+ * in the order of the faces and subfaces. Besides the global index,
+ * every dof has its position in the local array of a vector on the
+ * locally relevant dofs (owned and ghost entries), and every owned cell
+ * its position in a vector on the locally owned dofs. The local
+ * arrays are read through the pointers from local_values().
+ */
+struct LocalIndexMap
+{
+  std::vector<types::global_dof_index> cell_dofs;
+  std::vector<unsigned int>            cell_relevant,
+                                       cell_owned;
+  // neighbors of cell k are in [neighbor_offsets[k], neighbor_offsets[k+1])
+  std::vector<unsigned int>            neighbor_offsets;
+  std::vector<types::global_dof_index> neighbor_dofs;
+  std::vector<unsigned int>            neighbor_relevant;
+};
+
+
+
+template <int dim>
+void
+build_local_index_map(const std::vector<typename DoFHandler<dim>::active_cell_iterator>
+                      &owned_cells,
+                      const IndexSet &locally_owned_dofs,
+                      const IndexSet &locally_relevant_dofs,
+                      LocalIndexMap  &index_map)
+{
+  /*
+   * Trilinos maps are built from the index sets with the elements in
+   * increasing order, so a local index is the position in the set.
+   * Neighbors are listed the same way as the solvers visit them:
+   * the children of a finer neighbor, otherwise the neighbor itself
+   */
+  std::vector<types::global_dof_index> dof_indices(1);
+  const unsigned int n_cells = owned_cells.size();
+
+  index_map.cell_dofs.resize(n_cells);
+  index_map.cell_relevant.resize(n_cells);
+  index_map.cell_owned.resize(n_cells);
+  index_map.neighbor_offsets.resize(n_cells + 1);
+  index_map.neighbor_dofs.clear();
+  index_map.neighbor_relevant.clear();
+
+  for (unsigned int k=0; k<n_cells; ++k)
+  {
+    const auto & cell = owned_cells[k];
+    AssertThrow(cell->get_fe().dofs_per_cell == 1, ExcNotImplemented());
+    cell->get_dof_indices(dof_indices);
+    index_map.cell_dofs[k] = dof_indices[0];
+    index_map.cell_relevant[k] = locally_relevant_dofs.index_within_set(dof_indices[0]);
+    index_map.cell_owned[k] = locally_owned_dofs.index_within_set(dof_indices[0]);
+    index_map.neighbor_offsets[k] = index_map.neighbor_dofs.size();
+
+    for (unsigned int f=0; f<GeometryInfo<dim>::faces_per_cell; ++f)
+    {
+      if (cell->at_boundary(f))
+        continue;
+
+      if (cell->neighbor(f)->has_children())
+        for (unsigned int subface=0;
+             subface<cell->face(f)->n_children(); ++subface)
+        {
+          cell->neighbor_child_on_subface(f, subface)->get_dof_indices(dof_indices);
+          index_map.neighbor_dofs.push_back(dof_indices[0]);
+        }
+      else
+      {
+        cell->neighbor(f)->get_dof_indices(dof_indices);
+        index_map.neighbor_dofs.push_back(dof_indices[0]);
+      }
+    }  // end face loop
+  }  // end cell loop
+  index_map.neighbor_offsets[n_cells] = index_map.neighbor_dofs.size();
+
+  index_map.neighbor_relevant.resize(index_map.neighbor_dofs.size());
+  for (unsigned int n=0; n<index_map.neighbor_dofs.size(); ++n)
+  {
+    AssertThrow(locally_relevant_dofs.is_element(index_map.neighbor_dofs[n]),
+                ExcMessage("Face neighbor is not a ghost"));
+    index_map.neighbor_relevant[n] =
+        locally_relevant_dofs.index_within_set(index_map.neighbor_dofs[n]);
+  }
+}  // eom
+
+
+
+/*
+ * Interior faces of the TPFA stencil of the locally owned cells, each
+ * face stored once. The side of the face seen from the cell with the
+ * smaller global dof is the one stored, so that processes sharing a
+ * face store the same values and the fluxes are conservative.
+ * The pressure assembly fills the phase transmissibilities and gravity
+ * terms, and the transport computes the phase fluxes from them:
+ * flux = T*(p_first - p_second) - G, positive from first to second.
+ */
+struct FaceList
+{
+  // cells on the two sides, as positions in the local arrays of
+  // vectors on the relevant dofs
+  std::vector<unsigned int>          first, second;
+  // faces with both cells locally owned come first
+  unsigned int                       n_interior_faces;
+  /* face stored from each neighbor entry of LocalIndexMap;
+   * invalid if the owned neighbor stores it from its own side.
+   * A reversed entry stores the face as seen from its (ghost) neighbor
+   */
+  std::vector<unsigned int>          neighbor_face;
+  std::vector<bool>                  neighbor_reversed;
+  // [phase][face]
+  std::vector< std::vector<double> > transmissibility,
+                                     gravity;
+  // [phase][face] for unit relative permeability (implicit transport)
+  std::vector< std::vector<double> > unit_transmissibility,
+                                     unit_gravity;
+};
+
+
+
+inline
+void
+build_face_list(const LocalIndexMap &index_map,
+                const IndexSet      &locally_owned_dofs,
+                const unsigned int   n_phases,
+                FaceList            &faces)
+{
+  const unsigned int n_entries = index_map.neighbor_dofs.size();
+  faces.neighbor_face.assign(n_entries, numbers::invalid_unsigned_int);
+  faces.neighbor_reversed.assign(n_entries, false);
+
+  // (neighbor entry, cell) pairs that store a face
+  std::vector< std::pair<unsigned int,unsigned int> > interior_faces,
+                                                      boundary_faces;
+  for (unsigned int k=0; k<index_map.cell_dofs.size(); ++k)
+    for (unsigned int n=index_map.neighbor_offsets[k];
+         n<index_map.neighbor_offsets[k+1]; ++n)
+    {
+      const bool ghost = !locally_owned_dofs.is_element(index_map.neighbor_dofs[n]);
+      if (index_map.cell_dofs[k] < index_map.neighbor_dofs[n])
+      {
+        if (ghost)
+          boundary_faces.push_back(std::make_pair(n, k));
+        else
+          interior_faces.push_back(std::make_pair(n, k));
+      }
+      else if (ghost)
+      {
+        faces.neighbor_reversed[n] = true;
+        boundary_faces.push_back(std::make_pair(n, k));
+      }
+    }
+
+  faces.n_interior_faces = interior_faces.size();
+  std::vector< std::pair<unsigned int,unsigned int> > &stored_faces = interior_faces;
+  stored_faces.insert(stored_faces.end(),
+                      boundary_faces.begin(), boundary_faces.end());
+
+  const unsigned int n_faces = stored_faces.size();
+  faces.first.resize(n_faces);
+  faces.second.resize(n_faces);
+  for (unsigned int f=0; f<n_faces; ++f)
+  {
+    const unsigned int n = stored_faces[f].first;
+    const unsigned int k = stored_faces[f].second;
+    faces.neighbor_face[n] = f;
+    if (faces.neighbor_reversed[n])
+    {
+      faces.first[f] = index_map.neighbor_relevant[n];
+      faces.second[f] = index_map.cell_relevant[k];
+    }
+    else
+    {
+      faces.first[f] = index_map.cell_relevant[k];
+      faces.second[f] = index_map.neighbor_relevant[n];
+    }
+  }
+
+  faces.transmissibility.assign(n_phases, std::vector<double>(n_faces));
+  faces.gravity.assign(n_phases, std::vector<double>(n_faces));
+  faces.unit_transmissibility.assign(n_phases, std::vector<double>(n_faces));
+  faces.unit_gravity.assign(n_phases, std::vector<double>(n_faces));
+}  // eom
+
+
+
+/*
+ * Positions of the TPFA entries in the CSR value array of the
+ * system matrix, in the order of LocalIndexMap. The sparsity pattern
+ * is fixed between setup_dofs calls, so the assembly adds the entries
+ * in place instead of going through the global-to-local index
+ * translation of SparseMatrix::add.
+ */
+struct MatrixPositions
+{
+  // values of the row of each owned cell
+  std::vector<double*>      rows;
+  // position of the diagonal in the row
+  std::vector<unsigned int> diagonal;
+  // position of each neighbor entry in the row of its cell
+  std::vector<unsigned int> neighbor;
+};
+
+
+
+inline
+void
+build_matrix_positions(const TrilinosWrappers::SparseMatrix &matrix,
+                       const LocalIndexMap                  &index_map,
+                       MatrixPositions                      &positions)
+{
+  typedef TrilinosWrappers::types::int_type int_type;
+  const Epetra_CrsMatrix &epetra_matrix = matrix.trilinos_matrix();
+  AssertThrow(epetra_matrix.StorageOptimized(),
+              ExcMessage("Matrix storage is not contiguous"));
+
+  const unsigned int n_cells = index_map.cell_dofs.size();
+  positions.rows.resize(n_cells);
+  positions.diagonal.resize(n_cells);
+  positions.neighbor.resize(index_map.neighbor_dofs.size());
+
+  for (unsigned int k=0; k<n_cells; ++k)
+  {
+    const int row =
+        epetra_matrix.RowMap().LID(static_cast<int_type>(index_map.cell_dofs[k]));
+    AssertThrow(row >= 0, ExcMessage("Cell row is not locally owned"));
+
+    // a view on the stored values: writing through it is how
+    // Epetra gives direct access to the CSR arrays
+    int n_entries;
+    double *values;
+    int *columns;
+    epetra_matrix.ExtractMyRowView(row, n_entries, values, columns);
+    positions.rows[k] = values;
+
+    // position of a column in the row (the rows are short)
+    const auto position = [&](const types::global_dof_index dof)
+    {
+      const int column =
+          epetra_matrix.ColMap().LID(static_cast<int_type>(dof));
+      for (int e=0; e<n_entries; ++e)
+        if (columns[e] == column)
+          return static_cast<unsigned int>(e);
+      AssertThrow(false, ExcMessage("Entry is not in the sparsity pattern"));
+      return numbers::invalid_unsigned_int;
+    };
+
+    positions.diagonal[k] = position(index_map.cell_dofs[k]);
+    for (unsigned int n=index_map.neighbor_offsets[k];
+         n<index_map.neighbor_offsets[k+1]; ++n)
+      positions.neighbor[n] = position(index_map.neighbor_dofs[n]);
+  }
+}  // eom
+
+
+
+inline
+const double *
+local_values(const TrilinosWrappers::MPI::Vector &vector)
+{
+  // entries in the order of the index set the vector was created with
+  return vector.trilinos_vector()[0];
+}  // eom
+
+}  // end of namespace
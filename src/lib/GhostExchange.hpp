@@ -0,0 +1,338 @@
+#pragma once
+
+#include <deal.II/lac/trilinos_vector.h>
+#include <Epetra_Import.h>
+#include <Epetra_MpiComm.h>
+#include <Epetra_MpiDistributor.h>
+#include <Epetra_Map.h>
+#include <mpi.h>
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+
+namespace Communication
+{
+using namespace dealii;
+
+
+/*
+ * Ghost update for several vectors that share the same
+ * owned and relevant partitionings.
+ * The plan is built once per partitioning from the send and receive
+ * lists of an Epetra_Import, and the values of all registered vectors
+ * are shipped in one message per neighbor process.
+ * The messages use persistent requests (MPI_Send_init/MPI_Recv_init):
+ * start() packs the values and starts them, finish() waits for them.
+ * Neither synchronizes the processes (Epetra_Distributor::DoPosts
+ * has a barrier and blocking sends), so work placed between start()
+ * and finish() really overlaps with the messages.
+ */
+class GhostExchange
+{
+ public:
+  GhostExchange();
+  ~GhostExchange();
+  // owns MPI requests and a communicator
+  GhostExchange(const GhostExchange&) = delete;
+  GhostExchange& operator=(const GhostExchange&) = delete;
+  // build the communication plan; vectors are unregistered
+  void reinit(const TrilinosWrappers::MPI::Vector &owned_vector,
+              const TrilinosWrappers::MPI::Vector &relevant_vector);
+  // register a pair of vectors with the partitionings given in reinit
+  void add_vector(const TrilinosWrappers::MPI::Vector &owned_vector,
+                  TrilinosWrappers::MPI::Vector       &relevant_vector);
+  // start sends and receives; locally-owned entries are copied right away
+  void start();
+  // wait for the messages and write the ghost entries
+  void finish();
+  // blocking update: start() + finish()
+  void update_ghosts();
+  // true between start() and finish()
+  bool in_progress() const;
+
+ private:
+  // persistent requests for the buffers of the registered vectors
+  void setup_requests();
+  void free_requests();
+
+  std::shared_ptr<Epetra_Import>                     importer;
+  std::vector<const TrilinosWrappers::MPI::Vector*>  owned_vectors;
+  std::vector<TrilinosWrappers::MPI::Vector*>        relevant_vectors;
+  // own communicator, so that the messages of exchanges never match
+  MPI_Comm                                           communicator;
+  /* plan: neighbor processes and the offsets of their blocks (in
+   * entries) in the send and receive buffers, and the local indices
+   * of the sent entries grouped by process
+   */
+  std::vector<int>                                   send_processes, send_offsets,
+                                                     receive_processes, receive_offsets,
+                                                     send_ids;
+  std::vector<double>                                send_buffer, receive_buffer;
+  std::vector<MPI_Request>                           requests;
+  // number of vectors the requests were set up for
+  unsigned int                                       n_request_vectors;
+  bool                                               started;
+};
+
+
+
+inline
+GhostExchange::GhostExchange()
+    :
+    communicator(MPI_COMM_NULL),
+    n_request_vectors(0),
+    started(false)
+{}  // eom
+
+
+
+inline
+GhostExchange::~GhostExchange()
+{
+  int finalized = 0;
+  MPI_Finalized(&finalized);
+  if (finalized)
+    return;
+  free_requests();
+  if (communicator != MPI_COMM_NULL)
+    MPI_Comm_free(&communicator);
+}  // eom
+
+
+
+inline
+void
+GhostExchange::reinit(const TrilinosWrappers::MPI::Vector &owned_vector,
+                      const TrilinosWrappers::MPI::Vector &relevant_vector)
+{
+  AssertThrow(!started, ExcMessage("Ghost exchange is in progress"));
+  importer = std::make_shared<Epetra_Import>
+      (relevant_vector.vector_partitioner(),
+       owned_vector.vector_partitioner());
+  owned_vectors.clear();
+  relevant_vectors.clear();
+  free_requests();
+
+  if (communicator == MPI_COMM_NULL)
+  {
+    const Epetra_MpiComm *comm =
+        dynamic_cast<const Epetra_MpiComm*>(&importer->SourceMap().Comm());
+    AssertThrow(comm != NULL, ExcMessage("Ghost exchange needs an MPI communicator"));
+    MPI_Comm_dup(comm->Comm(), &communicator);
+  }
+
+  { // sends: exported entries grouped by process, in the importer order
+    const int n_export = importer->NumExportIDs();
+    const int *export_ids = importer->ExportLIDs();
+    const int *export_processes = importer->ExportPIDs();
+    std::vector< std::pair<int,int> > exports(n_export);
+    for (int k=0; k<n_export; ++k)
+      exports[k] = std::make_pair(export_processes[k], k);
+    std::stable_sort(exports.begin(), exports.end(),
+                     [](const std::pair<int,int> &a, const std::pair<int,int> &b)
+                     {return a.first < b.first;});
+
+    send_processes.clear();
+    send_offsets.clear();
+    send_ids.resize(n_export);
+    for (int k=0; k<n_export; ++k)
+    {
+      if (send_processes.empty() || send_processes.back() != exports[k].first)
+      {
+        send_processes.push_back(exports[k].first);
+        send_offsets.push_back(k);
+      }
+      send_ids[k] = export_ids[exports[k].second];
+    }
+    send_offsets.push_back(n_export);
+  }
+
+  { // receives: the remote entries are sorted by their owner
+    const Epetra_MpiDistributor *distributor =
+        dynamic_cast<const Epetra_MpiDistributor*>(&importer->Distributor());
+    AssertThrow(distributor != NULL,
+                ExcMessage("Ghost exchange needs an MPI distributor"));
+    std::vector< std::pair<int,int> > receives(distributor->NumReceives());
+    for (unsigned int i=0; i<receives.size(); ++i)
+      receives[i] = std::make_pair(distributor->ProcsFrom()[i],
+                                   distributor->LengthsFrom()[i]);
+    std::sort(receives.begin(), receives.end());
+
+    receive_processes.resize(receives.size());
+    receive_offsets.resize(receives.size() + 1);
+    receive_offsets[0] = 0;
+    for (unsigned int i=0; i<receives.size(); ++i)
+    {
+      receive_processes[i] = receives[i].first;
+      receive_offsets[i+1] = receive_offsets[i] + receives[i].second;
+    }
+    AssertThrow(receive_offsets.back() == importer->NumRemoteIDs(),
+                ExcMessage("Receive lists do not match the remote entries"));
+  }
+}  // eom
+
+
+
+inline
+void
+GhostExchange::reinit(const GhostExchange &other)
+{
+  AssertThrow(!started, ExcMessage("Ghost exchange is in progress"));
+  AssertThrow(other.importer, ExcMessage("Ghost exchange has no plan"));
+  importer = other.importer;
+  owned_vectors.clear();
+  relevant_vectors.clear();
+  free_requests();
+
+  // the exchanges may be in flight together, so each keeps its communicator
+  if (communicator == MPI_COMM_NULL)
+    MPI_Comm_dup(other.communicator, &communicator);
+
+  send_processes = other.send_processes;
+  send_offsets = other.send_offsets;
+  send_ids = other.send_ids;
+  receive_processes = other.receive_processes;
+  receive_offsets = other.receive_offsets;
+}  // eom
+
+
+
+inline
+void
+GhostExchange::free_requests()
+{
+  for (auto & request : requests)
+    if (request != MPI_REQUEST_NULL)
+      MPI_Request_free(&request);
+  requests.clear();
+  n_request_vectors = 0;
+}  // eom
+
+
+
+inline
+void
+GhostExchange::setup_requests()
+{
+  free_requests();
+  const unsigned int n_vectors = owned_vectors.size();
+  send_buffer.resize(send_ids.size()*n_vectors);
+  receive_buffer.resize(receive_offsets.back()*n_vectors);
+
+  // the buffers must not move while the requests exist
+  const int tag = 0;
+  requests.resize(receive_processes.size() + send_processes.size());
+  for (unsigned int i=0; i<receive_processes.size(); ++i)
+    MPI_Recv_init(receive_buffer.data() + receive_offsets[i]*n_vectors,
+                  (receive_offsets[i+1] - receive_offsets[i])*n_vectors,
+                  MPI_DOUBLE, receive_processes[i], tag, communicator,
+                  &requests[i]);
+  for (unsigned int i=0; i<send_processes.size(); ++i)
+    MPI_Send_init(send_buffer.data() + send_offsets[i]*n_vectors,
+                  (send_offsets[i+1] - send_offsets[i])*n_vectors,
+                  MPI_DOUBLE, send_processes[i], tag, communicator,
+                  &requests[receive_processes.size() + i]);
+  n_request_vectors = n_vectors;
+}  // eom
+
+
+
+inline
+void
+GhostExchange::add_vector(const TrilinosWrappers::MPI::Vector &owned_vector,
+                          TrilinosWrappers::MPI::Vector       &relevant_vector)
+{
+  AssertThrow(importer.get() != NULL,
+              ExcMessage("Ghost exchange is not initialized"));
+  AssertThrow(owned_vector.vector_partitioner().SameAs(importer->SourceMap()),
+              ExcMessage("Owned vector has a different partitioning"));
+  AssertThrow(relevant_vector.vector_partitioner().SameAs(importer->TargetMap()),
+              ExcMessage("Relevant vector has a different partitioning"));
+  owned_vectors.push_back(&owned_vector);
+  relevant_vectors.push_back(&relevant_vector);
+}  // eom
+
+
+
+inline
+void
+GhostExchange::start()
+{
+  AssertThrow(!started, ExcMessage("Ghost exchange is in progress"));
+  const unsigned int n_vectors = owned_vectors.size();
+
+  // entries that stay on this process
+  const int n_same = importer->NumSameIDs();
+  const int n_permute = importer->NumPermuteIDs();
+  const int *permute_from = importer->PermuteFromLIDs();
+  const int *permute_to = importer->PermuteToLIDs();
+  for (unsigned int v=0; v<n_vectors; ++v)
+  {
+    const double *source = owned_vectors[v]->trilinos_vector()[0];
+    double *target = relevant_vectors[v]->trilinos_vector()[0];
+    std::copy(source, source + n_same, target);
+    for (int k=0; k<n_permute; ++k)
+      target[permute_to[k]] = source[permute_from[k]];
+  }
+
+  if (n_request_vectors != n_vectors)
+    setup_requests();
+
+  // pack all vectors entry by entry: one packet per sent index
+  const unsigned int n_send = send_ids.size();
+  for (unsigned int v=0; v<n_vectors; ++v)
+  {
+    const double *source = owned_vectors[v]->trilinos_vector()[0];
+    for (unsigned int k=0; k<n_send; ++k)
+      send_buffer[k*n_vectors + v] = source[send_ids[k]];
+  }
+
+  if (!requests.empty())
+    MPI_Startall(requests.size(), requests.data());
+  started = true;
+}  // eom
+
+
+
+inline
+void
+GhostExchange::finish()
+{
+  AssertThrow(started, ExcMessage("Ghost exchange has not been started"));
+  if (!requests.empty())
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+  const unsigned int n_vectors = owned_vectors.size();
+  const int n_remote = importer->NumRemoteIDs();
+  const int *remote_ids = importer->RemoteLIDs();
+  const double *imports = receive_buffer.data();
+  for (unsigned int v=0; v<n_vectors; ++v)
+  {
+    double *target = relevant_vectors[v]->trilinos_vector()[0];
+    for (int k=0; k<n_remote; ++k)
+      target[remote_ids[k]] = imports[k*n_vectors + v];
+  }
+  started = false;
+}  // eom
+
+
+
+inline
+void
+GhostExchange::update_ghosts()
+{
+  start();
+  finish();
+}  // eom
+
+
+
+inline
+bool
+GhostExchange::in_progress() const
+{
+  return started;
+}  // eom
+
+}  // end of namespace
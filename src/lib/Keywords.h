@@ -16,6 +16,17 @@ namespace Keywords
     global_refinement_steps = "Global refinement steps",
     adaptive_refinement_steps = "Adaptive refinement steps",
     local_refinement_regions = "Local refinement regions",
+    box_refinement_steps = "Box refinement steps",
+    well_refinement = "Well refinement",
+    contact_refinement = "Contact refinement",
+    load_balancing = "Load balancing",
+    load_balancing_none = "None",
+    load_balancing_model = "Model",
+    load_balancing_measured = "Measured",
+    cell_weights = "Cell weights",
+    imbalance_threshold = "Imbalance threshold",
+    balancing_window = "Balancing window",
+    group_well_cells = "Group well cells",
 
   section_wells = "Well data" ,
     well_parameters = "Wells",
@@ -38,6 +49,7 @@ namespace Keywords
     field_units = "Field",
     young_modulus = "Young modulus",
     poisson_ratio = "Poisson ratio",
+    biot_coefficient = "Biot coefficient",
     volume_factor_water = "Volume factor water",
     // volume_factor_oil = "Volume factor oil",
     // volume_factor_gas = "Volume factor gas",
@@ -61,7 +73,49 @@ namespace Keywords
     time_stepping = "Time stepping",
     minimum_time_step = "Minimum time step",
     fss_tolerance = "FSS tolerance",
-    max_fss_steps = "Max FSS steps";
+    max_fss_steps = "Max FSS steps",
+    sfi_tolerance = "SFI tolerance",
+    sfi_saturation_tolerance = "SFI saturation tolerance",
+    max_sfi_steps = "Max SFI steps",
+    elastic_solver = "Elasticity solver",
+    elastic_solver_amg = "AMG",
+    elastic_solver_matrix_free = "MatrixFree",
+    pressure_solver = "Pressure solver",
+    pressure_solver_cg = "CG",
+    pressure_solver_deflated_cg = "DeflatedCG",
+    pressure_solver_direct = "Direct",
+    direct_solver = "Direct solver",
+    direct_solver_klu = "KLU",
+    direct_solver_mumps = "MUMPS",
+    direct_solver_superlu_dist = "SuperLU_dist",
+    direct_solver_size = "Direct solver size",
+    pressure_operator = "Pressure operator",
+    pressure_operator_matrix = "Matrix",
+    pressure_operator_matrix_free = "MatrixFree",
+    reassembly_pressure_tolerance = "Reassembly pressure tolerance",
+    reassembly_saturation_tolerance = "Reassembly saturation tolerance",
+    reassembly_interval = "Reassembly interval",
+    pressure_preconditioner = "Pressure preconditioner",
+    pressure_preconditioner_amg = "AMG",
+    pressure_preconditioner_gmg = "GMG",
+    saturation_solver = "Saturation solver",
+    saturation_solver_explicit = "Explicit",
+    saturation_solver_reordering = "Reordering",
+    saturation_solver_adaptive = "AIM",
+    implicit_cfl = "Implicit CFL",
+    saturation_solver_lts = "LTS",
+    lts_cfl = "LTS CFL",
+    time_step_levels = "Time step levels",
+    deflation_vectors = "Deflation vectors",
+    deflation_refresh = "Deflation refresh",
+    displacement_degree = "Displacement degree",
+    mechanics_level = "Mechanics level",
+    mechanics_interval = "Mechanics interval",
+    mechanics_pressure_change = "Mechanics pressure change",
+    mechanics_lag_tolerance = "Mechanics lag tolerance",
+    pressure_guess_order = "Pressure guess order",
+    pressure_pod_basis = "Pressure POD basis",
+    compare_pressure_guess = "Compare pressure guess";
 
   // Output names
   const std::string
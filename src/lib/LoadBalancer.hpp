@@ -0,0 +1,359 @@
+#pragma once
+
+#include <deal.II/base/mpi.h>
+#include <deal.II/base/conditional_ostream.h>
+#include <deal.II/distributed/tria.h>
+#include <algorithm>
+#include <functional>
+#include <boost/signals2.hpp>
+
+// Custom modules
+#include <Model.hpp>
+
+
+namespace LoadBalancing
+{
+using namespace dealii;
+
+
+/*
+ * This class supplies cell weights to the p4est partitioner
+ * through the cell_weight signal of the triangulation and decides
+ * when the triangulation should be repartitioned.
+ * Cell costs either come from a model (well cells and hanging faces
+ * are more expensive than regular cells) or are measured
+ * in the pressure assembly.
+ */
+template <int dim>
+class LoadBalancer
+{
+ public:
+  LoadBalancer(MPI_Comm                                  &mpi_communicator_,
+               parallel::distributed::Triangulation<dim> &triangulation_,
+               const Model::Model<dim>                   &model_,
+               ConditionalOStream                        &pcout_);
+  ~LoadBalancer();
+  /*
+   * Compute model costs and reset the measured ones.
+   * Call after every mesh change and after the wells are located;
+   * mesh_changed is false after a repartition of the same mesh.
+   */
+  void reinit(const bool mesh_changed = true);
+  // storage for the measured costs (indexed by active cell index)
+  std::vector<double> & get_cell_costs();
+  // ratio of the maximum and the average cost of a process
+  double compute_imbalance() const;
+  // largest number of processes that own cells of the same well
+  unsigned int max_well_processes() const;
+  /*
+   * True if balancing is on and the imbalance exceeds the threshold.
+   * Call once per time step. Model costs are checked once after each
+   * reinit, measured costs once per balancing window (summed over its
+   * steps). If a repartition did not reduce the imbalance measurably,
+   * repartitioning pauses: with model costs until the mesh changes,
+   * with measured costs until the imbalance grows further or for
+   * max_stalled_windows windows
+   */
+  bool needs_repartition();
+
+ private:
+  // weight in addition to the default weight that p4est assigns to a cell
+  unsigned int
+  get_cell_weight(const typename Triangulation<dim>::cell_iterator &cell,
+                  const typename Triangulation<dim>::CellStatus     status) const;
+  // cost of an active locally-owned cell relative to a regular cell
+  double get_cell_cost(const unsigned int active_cell_index) const;
+  // start a new balancing window
+  void reset_measured_costs();
+
+  MPI_Comm                                  &mpi_communicator;
+  parallel::distributed::Triangulation<dim> &triangulation;
+  const Model::Model<dim>                   &model;
+  ConditionalOStream                        &pcout;
+  boost::signals2::connection               weight_connection;
+  std::vector<double>                       model_costs, cell_costs;
+  // average measured cost of a cell over all processes
+  double                                    average_cell_cost;
+  // hysteresis: costs not checked since reinit, steps in the balancing
+  // window, imbalance that triggered the last repartition (0 - checked
+  // since), no gain from repartitioning at stalled_imbalance
+  bool                                      costs_changed;
+  unsigned int                              n_window_steps;
+  double                                    repartitioned_imbalance;
+  bool                                      stalled;
+  double                                    stalled_imbalance;
+  unsigned int                              n_stalled_windows;
+  static const unsigned int                 max_stalled_windows = 10;
+};
+
+
+
+template <int dim>
+LoadBalancer<dim>::
+LoadBalancer(MPI_Comm                                  &mpi_communicator_,
+             parallel::distributed::Triangulation<dim> &triangulation_,
+             const Model::Model<dim>                   &model_,
+             ConditionalOStream                        &pcout_)
+    :
+    mpi_communicator(mpi_communicator_),
+    triangulation(triangulation_),
+    model(model_),
+    pcout(pcout_),
+    average_cell_cost(0),
+    costs_changed(false),
+    n_window_steps(0),
+    repartitioned_imbalance(0),
+    stalled(false),
+    stalled_imbalance(0),
+    n_stalled_windows(0)
+{
+  weight_connection =
+      triangulation.signals.cell_weight.connect
+      (std::bind(&LoadBalancer<dim>::get_cell_weight, this,
+                 std::placeholders::_1, std::placeholders::_2));
+}  // eom
+
+
+
+template <int dim>
+LoadBalancer<dim>::~LoadBalancer()
+{
+  weight_connection.disconnect();
+}  // eom
+
+
+
+template <int dim>
+void LoadBalancer<dim>::reinit(const bool mesh_changed)
+{
+  const auto & config = model.load_balancing;
+  model_costs.assign(triangulation.n_active_cells(), 0.0);
+  cell_costs.assign(triangulation.n_active_cells(), 0.0);
+  average_cell_cost = 0;
+
+  typename Triangulation<dim>::active_cell_iterator
+      cell = triangulation.begin_active(),
+      endc = triangulation.end();
+
+  for (; cell!=endc; ++cell)
+    if (cell->is_locally_owned())
+    {
+      double cost = 1.0;
+      // subfaces towards finer neighbors and faces towards coarser ones
+      for (unsigned int f=0; f<GeometryInfo<dim>::faces_per_cell; ++f)
+        if (!cell->at_boundary(f))
+        {
+          if (cell->neighbor(f)->has_children())
+            cost += config.hanging_face_weight*cell->face(f)->n_children();
+          else if (cell->neighbor_is_coarser(f))
+            cost += config.hanging_face_weight;
+        }
+      model_costs[cell->active_cell_index()] = cost;
+    }
+
+  const unsigned int this_process =
+      Utilities::MPI::this_mpi_process(mpi_communicator);
+  const unsigned int n_processes =
+      Utilities::MPI::n_mpi_processes(mpi_communicator);
+  for (const auto & well : model.wells)
+  {
+    const auto & well_cells = well.get_cells();
+    if (!config.group_well_cells)
+    {
+      for (const auto & cell : well_cells)
+        model_costs[cell->active_cell_index()] += config.well_cell_weight;
+      continue;
+    }
+
+    /* The partitioner cuts the space-filling curve at accumulated
+     * weights: the cost of the whole well goes to one cell (on the
+     * lowest process that owns some), so the other well cells are
+     * light and a cut between them is less likely
+     */
+    const unsigned int n_well_cells =
+        Utilities::MPI::sum(static_cast<unsigned int>(well_cells.size()),
+                            mpi_communicator);
+    const unsigned int first_process =
+        Utilities::MPI::min(well_cells.empty() ? n_processes : this_process,
+                            mpi_communicator);
+    if (this_process == first_process)
+      model_costs[well_cells[0]->active_cell_index()] +=
+          config.well_cell_weight*n_well_cells;
+  }
+
+  costs_changed = true;
+  n_window_steps = 0;
+  if (mesh_changed)
+    stalled = false;
+}  // eom
+
+
+
+template <int dim>
+inline
+std::vector<double> &
+LoadBalancer<dim>::get_cell_costs()
+{
+  return cell_costs;
+}  // eom
+
+
+
+template <int dim>
+inline
+double
+LoadBalancer<dim>::get_cell_cost(const unsigned int active_cell_index) const
+{
+  if (model.load_balancing.type == Model::LoadBalancingType::MeasuredBalancing
+      && average_cell_cost > 0)
+    return cell_costs[active_cell_index] / average_cell_cost;
+  else
+    return model_costs[active_cell_index];
+}  // eom
+
+
+
+template <int dim>
+inline
+void
+LoadBalancer<dim>::reset_measured_costs()
+{
+  if (model.load_balancing.type == Model::LoadBalancingType::MeasuredBalancing)
+    std::fill(cell_costs.begin(), cell_costs.end(), 0.0);
+}  // eom
+
+
+
+template <int dim>
+double LoadBalancer<dim>::compute_imbalance() const
+{
+  double local_cost = 0;
+  if (model.load_balancing.type == Model::LoadBalancingType::MeasuredBalancing)
+    for (const auto & cost : cell_costs)
+      local_cost += cost;
+  else
+    for (const auto & cost : model_costs)
+      local_cost += cost;
+
+  const double max_cost = Utilities::MPI::max(local_cost, mpi_communicator);
+  const double average_cost =
+      Utilities::MPI::sum(local_cost, mpi_communicator) /
+      Utilities::MPI::n_mpi_processes(mpi_communicator);
+
+  if (average_cost == 0.0)
+    return 1.0;
+  return max_cost / average_cost;
+}  // eom
+
+
+
+template <int dim>
+unsigned int LoadBalancer<dim>::max_well_processes() const
+{
+  unsigned int max_processes = 0;
+  for (const auto & well : model.wells)
+  {
+    const unsigned int owns_cells = well.get_cells().empty() ? 0 : 1;
+    max_processes = std::max(max_processes,
+                             Utilities::MPI::sum(owns_cells, mpi_communicator));
+  }
+  return max_processes;
+}  // eom
+
+
+
+template <int dim>
+bool LoadBalancer<dim>::needs_repartition()
+{
+  const auto & config = model.load_balancing;
+  if (config.type == Model::LoadBalancingType::NoBalancing ||
+      Utilities::MPI::n_mpi_processes(mpi_communicator) == 1)
+    return false;
+  if (config.type == Model::LoadBalancingType::ModelBalancing)
+  { // model costs only change in reinit
+    if (!costs_changed || stalled)
+      return false;
+    costs_changed = false;
+  }
+  else
+  { // one step of timings is too noisy to judge a partition
+    if (++n_window_steps < config.balancing_window)
+      return false;
+    n_window_steps = 0;
+  }
+
+  const double imbalance = compute_imbalance();
+  // the excess over 1 must change by a tenth to count
+  const double min_change = 0.1;
+  if (stalled)
+  { // try again if the imbalance has grown or after a while
+    n_stalled_windows++;
+    if (imbalance - 1.0 > (1.0 + min_change)*(stalled_imbalance - 1.0) ||
+        n_stalled_windows >= max_stalled_windows)
+      stalled = false;
+    else
+    {
+      reset_measured_costs();
+      return false;
+    }
+  }
+  else if (repartitioned_imbalance > 0)
+  { // first window after a repartition: the excess must shrink
+    const bool improved = (imbalance - 1.0 <
+                           (1.0 - min_change)*(repartitioned_imbalance - 1.0));
+    repartitioned_imbalance = 0;
+    if (!improved && imbalance > config.imbalance_threshold)
+    {
+      pcout << "Load imbalance " << imbalance
+            << ": repartitioning does not reduce it" << std::endl;
+      stalled = true;
+      stalled_imbalance = imbalance;
+      n_stalled_windows = 0;
+      reset_measured_costs();
+      return false;
+    }
+  }
+
+  if (imbalance > config.imbalance_threshold)
+  {
+    pcout << "Load imbalance " << imbalance << ": repartitioning" << std::endl;
+    repartitioned_imbalance = imbalance;
+    // normalization of the measured costs for the cell weights
+    if (config.type == Model::LoadBalancingType::MeasuredBalancing)
+    {
+      double local_cost = 0;
+      for (const auto & cost : cell_costs)
+        local_cost += cost;
+      average_cell_cost =
+          Utilities::MPI::sum(local_cost, mpi_communicator) /
+          triangulation.n_global_active_cells();
+    }
+    return true;
+  }
+  reset_measured_costs();
+  return false;
+}  // eom
+
+
+
+template <int dim>
+unsigned int
+LoadBalancer<dim>::
+get_cell_weight(const typename Triangulation<dim>::cell_iterator &cell,
+                const typename Triangulation<dim>::CellStatus     status) const
+{
+  // p4est already gives each cell a default weight of 1000
+  const double default_weight = 1000;
+  if (model.load_balancing.type == Model::LoadBalancingType::NoBalancing)
+    return 0;
+  // costs are only known for unchanged active cells (not during refinement)
+  if (status != parallel::distributed::Triangulation<dim>::CELL_PERSIST
+      || !cell->active()
+      || cell->active_cell_index() >= model_costs.size())
+    return 0;
+
+  const double cost = get_cell_cost(cell->active_cell_index());
+  return static_cast<unsigned int>(std::max(0.0, default_weight*(cost - 1.0)));
+}  // eom
+
+}  // end of namespace
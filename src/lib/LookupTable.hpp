@@ -37,6 +37,13 @@ class LookupTable
                                   const std::vector<int> &cols_d,
                                   std::vector<double>    &dst) const;
  private:
+  // left end of the interpolation interval containing x
+  unsigned int find_interval(const double x) const;
+  // interpolated value of a column in the interval starting at row i
+  double column_value(const double       x,
+                      const unsigned int i,
+                      const unsigned int col) const;
+
   Vector<double> x_values;
   FullMatrix<double>     y_values;
   bool interpolate, extrapolate;
@@ -105,14 +112,61 @@ void LookupTable::set_data(const FullMatrix<double> &xy)
 }
 
 
+inline
+unsigned int LookupTable::find_interval(const double x) const
+{
+  const unsigned int size = x_values.size();
+  unsigned int i = 0;
+  if ( x >= x_values[size - 2] )     // special case: beyond right end
+    i = size - 2;
+  else
+  {
+    while ( x > x_values[i+1] )
+      i++;
+  }
+  return i;
+}  // eom
+
+
+
+inline
+double LookupTable::column_value(const double       x,
+                                 const unsigned int i,
+                                 const unsigned int col) const
+{
+  const double xL = x_values[i];
+  const double xR = x_values[i+1];
+  // points on either side (unless beyond ends)
+  double yL = y_values(i, col);
+  double yR = y_values(i+1, col);
+
+  if ( !extrapolate )  // if beyond ends of array and not extrapolating
+  {
+    if ( x < xL ) yR = yL;
+    if ( x > xR ) yL = yR;
+  }
+
+  if (interpolate)
+  {
+    const double dydx = ( yR - yL ) / ( xR - xL );  // gradient
+    return yL + dydx*( x - xL );                    // linear interpolation
+  }
+  else
+    return yL;                                      // lookup
+}  // eom
+
+
+
 double LookupTable::get_value(const double x,
                               const int    col) const
 {
-  std::vector<double> dst = {0.0};
-  std::vector<int> cols = {col};
-  get_values(x, cols, dst);
-  const double value = dst[0];
-  return value;
+  // no temporary column lists: this is called in the cell loops
+  AssertThrow(static_cast<unsigned int>(col) < y_values.n(),
+              ExcDimensionMismatch(col, y_values.n()));
+  if (x_values.size() == 1) // case with constant value
+    return y_values(0, col);
+
+  return column_value(x, find_interval(x), col);
 }  // eom
 
 
@@ -168,38 +222,13 @@ get_values_and_derivatives(const double           x,
     return;
   }
 
-  int i = 0;                      // find left end of interval for interpolation
-  if ( x >= x_values[size - 2] )     // special case: beyond right end
-    i = size - 2;
-  else
-  {
-    while ( x > x_values[i+1] )
-      i++;
-  }
-
-  double xL = x_values[i];
-  double xR = x_values[i+1];
+  // find left end of interval for interpolation
+  const unsigned int i = find_interval(x);
+  const double xL = x_values[i];
+  const double xR = x_values[i+1];
 
   for (unsigned int c=0; c<cols.size(); ++c)
-  {
-    // points on either side (unless beyond ends)
-    double yL = y_values(i, c);
-    double yR = y_values(i+1, c);
-
-    if ( !extrapolate )  // if beyond ends of array and not extrapolating
-    {
-      if ( x < xL ) yR = yL;
-      if ( x > xR ) yL = yR;
-    }
-
-    if (interpolate)
-    {
-      const double dydx = ( yR - yL ) / ( xR - xL );  // gradient
-      dst[c] = yL + dydx*( x - xL );                  // linear interpolation
-    }
-    else
-      dst[c] = yL;                                    // lookup
-  } // end loop for values
+    dst[c] = column_value(x, i, cols[c]);
 
   // get inverse derivatives
   for (unsigned int c=0; c<cols_d.size(); ++c)
@@ -35,6 +35,26 @@ void harmonic_mean(const Vector<double> &v1,
 
 
 
+// same as above with a fixed-size output that needs no heap storage
+template <int dim>
+void harmonic_mean(const Vector<double> &v1,
+                   const Vector<double> &v2,
+                   const double         dx1,
+                   const double         dx2,
+                   Tensor<1,dim>        &out)
+{
+  AssertThrow(v1.size() == dim && v2.size() == dim,
+              ExcMessage("Dimension mismatch"));
+  for (int i=0; i<dim; ++i){
+    if (v1[i] == 0.0 || v2[i] == 0.0)
+      out[i] = 0;
+    else
+      out[i] = (dx1 + dx2)/(dx1/v1[i] + dx2/v2[i]);
+  }
+}  // eom
+
+
+
 double arithmetic_mean(const double x1,
                        const double x2)
 {
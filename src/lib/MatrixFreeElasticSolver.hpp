@@ -0,0 +1,377 @@
+#pragma once
+
+#include <deal.II/base/config.h>
+#include <deal.II/base/conditional_ostream.h>
+#include <deal.II/distributed/tria.h>
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/lac/constraint_matrix.h>
+#include <deal.II/lac/trilinos_vector.h>
+
+#if DEAL_II_VERSION_GTE(9,0,0)
+#include <deal.II/base/quadrature_lib.h>
+#include <deal.II/dofs/dof_tools.h>
+#include <deal.II/lac/precondition.h>
+#include <deal.II/lac/solver_cg.h>
+#include <deal.II/lac/solver_control.h>
+#include <deal.II/multigrid/mg_constrained_dofs.h>
+#include <deal.II/multigrid/mg_transfer_matrix_free.h>
+#include <deal.II/multigrid/mg_tools.h>
+#include <deal.II/multigrid/mg_coarse.h>
+#include <deal.II/multigrid/mg_smoother.h>
+#include <deal.II/multigrid/mg_matrix.h>
+#include <deal.II/multigrid/multigrid.h>
+
+#include <ElasticOperator.hpp>
+#endif
+
+// Custom modules
+#include <Model.hpp>
+
+
+namespace SolidSolvers
+{
+using namespace dealii;
+
+
+/*
+ * Interface of the matrix-free elasticity solvers.
+ * The polynomial degree is a template parameter of the operator,
+ * so ElasticSolver picks the instance at runtime via
+ * create_matrix_free_solver.
+ */
+template <int dim>
+class MatrixFreeElasticSolverBase
+{
+ public:
+  virtual ~MatrixFreeElasticSolverBase() {}
+  /* build the matrix-free objects and the multigrid hierarchy.
+   * The dof handler must have level dofs.
+   */
+  virtual void setup(const DoFHandler<dim>  &dof_handler,
+                     const ConstraintMatrix &constraints) = 0;
+  // solve with CG; returns the number of iterations
+  virtual unsigned int solve(TrilinosWrappers::MPI::Vector       &solution,
+                             const TrilinosWrappers::MPI::Vector &rhs_vector,
+                             const double                         tolerance) = 0;
+};
+
+
+#if DEAL_II_VERSION_GTE(9,0,0)
+
+/*
+ * Matrix-free elasticity solver:
+ * CG preconditioned with a geometric multigrid V-cycle on the
+ * p4est level hierarchy, Chebyshev smoothing of the float level
+ * operators and a Chebyshev solve on the coarse mesh.
+ * Rollers are imposed on the levels as zero normal components,
+ * which requires boundaries aligned with the coordinate axes.
+ */
+template <int dim, int fe_degree>
+class MatrixFreeElasticSolver : public MatrixFreeElasticSolverBase<dim>
+{
+ public:
+  typedef ElasticOperator<dim, fe_degree, double>          SystemMatrixType;
+  typedef ElasticOperator<dim, fe_degree, float>           LevelMatrixType;
+  typedef LinearAlgebra::distributed::Vector<double>       VectorType;
+  typedef LinearAlgebra::distributed::Vector<float>        LevelVectorType;
+  typedef PreconditionChebyshev<LevelMatrixType, LevelVectorType> SmootherType;
+
+  MatrixFreeElasticSolver(MPI_Comm                &mpi_communicator_,
+                          const Model::Model<dim> &model_,
+                          ConditionalOStream      &pcout_);
+  virtual void setup(const DoFHandler<dim>  &dof_handler,
+                     const ConstraintMatrix &constraints);
+  virtual unsigned int solve(TrilinosWrappers::MPI::Vector       &solution,
+                             const TrilinosWrappers::MPI::Vector &rhs_vector,
+                             const double                         tolerance);
+
+ private:
+  // boundary ids sorted by the coordinate direction of their normals
+  void find_boundary_directions(const DoFHandler<dim> &dof_handler,
+                                std::vector< std::set<types::boundary_id> > &ids);
+
+  MPI_Comm                                  &mpi_communicator;
+  const Model::Model<dim>                   &model;
+  ConditionalOStream                        &pcout;
+  const DoFHandler<dim>                     *dof_handler;
+  const ConstraintMatrix                    *constraints;
+
+  SystemMatrixType                          system_matrix;
+  MGConstrainedDoFs                         mg_constrained_dofs;
+  MGLevelObject<LevelMatrixType>            mg_matrices;
+  MGLevelObject< MatrixFreeOperators::MGInterfaceOperator<LevelMatrixType> >
+                                            mg_interface_matrices;
+  MGTransferMatrixFree<dim, float>          mg_transfer;
+  // the V-cycle is built once per setup
+  mg::Matrix<LevelVectorType>               mg_matrix, mg_interface;
+  mg::SmootherRelaxation<SmootherType, LevelVectorType> mg_smoother;
+  MGCoarseGridApplySmoother<LevelVectorType> mg_coarse;
+  std::shared_ptr< Multigrid<LevelVectorType> > mg;
+  std::shared_ptr< PreconditionMG<dim, LevelVectorType,
+                                  MGTransferMatrixFree<dim, float> > >
+                                            preconditioner;
+  VectorType                                solution_mf, rhs_mf;
+};
+
+
+
+template <int dim, int fe_degree>
+MatrixFreeElasticSolver<dim, fe_degree>::
+MatrixFreeElasticSolver(MPI_Comm                &mpi_communicator_,
+                        const Model::Model<dim> &model_,
+                        ConditionalOStream      &pcout_)
+    :
+    mpi_communicator(mpi_communicator_),
+    model(model_),
+    pcout(pcout_),
+    dof_handler(NULL),
+    constraints(NULL)
+{}  // eom
+
+
+
+template <int dim, int fe_degree>
+void
+MatrixFreeElasticSolver<dim, fe_degree>::
+find_boundary_directions(const DoFHandler<dim> &dof_handler_,
+                         std::vector< std::set<types::boundary_id> > &ids)
+{
+  // -1: not seen on this process, dim: not aligned
+  std::map<types::boundary_id, int> directions;
+  for (const auto & id : dof_handler_.get_triangulation().get_boundary_ids())
+    directions[id] = -1;
+
+  typename DoFHandler<dim>::active_cell_iterator
+      cell = dof_handler_.begin_active(),
+      endc = dof_handler_.end();
+
+  for (; cell!=endc; ++cell)
+    if (cell->is_locally_owned() && cell->at_boundary())
+      for (unsigned int f=0; f<GeometryInfo<dim>::faces_per_cell; ++f)
+        if (cell->at_boundary(f))
+        {
+          const Tensor<1,dim> d = cell->face(f)->center() - cell->center();
+          int direction = 0;
+          for (int c=1; c<dim; ++c)
+            if (std::abs(d[c]) > std::abs(d[direction]))
+              direction = c;
+          for (int c=0; c<dim; ++c)
+            if (c != direction && std::abs(d[c]) > 1e-10*d.norm())
+              direction = dim;
+
+          int & known = directions[cell->face(f)->boundary_id()];
+          if (known == -1)
+            known = direction;
+          else if (known != direction)
+            known = dim;
+        }
+
+  ids.assign(dim, std::set<types::boundary_id>());
+  for (const auto & it : directions)
+  {
+    // the processes may have seen different faces of the boundary
+    const int direction = Utilities::MPI::max(it.second, mpi_communicator);
+    const unsigned int n_mismatch =
+        Utilities::MPI::sum((it.second != -1 && it.second != direction) ? 1u : 0u,
+                            mpi_communicator);
+    AssertThrow(direction >= 0 && direction < dim && n_mismatch == 0,
+                ExcMessage("Matrix-free elasticity solver requires "
+                           "boundaries normal to the coordinate axes"));
+    ids[direction].insert(it.first);
+  }
+}  // eom
+
+
+
+template <int dim, int fe_degree>
+void
+MatrixFreeElasticSolver<dim, fe_degree>::
+setup(const DoFHandler<dim>  &dof_handler_,
+      const ConstraintMatrix &constraints_)
+{
+  dof_handler = &dof_handler_;
+  constraints = &constraints_;
+  const auto & triangulation = dof_handler->get_triangulation();
+
+  preconditioner.reset();
+  mg.reset();
+  system_matrix.clear();
+  mg_matrices.clear_elements();
+
+  { // active level operator
+    typename MatrixFree<dim, double>::AdditionalData additional_data;
+    additional_data.tasks_parallel_scheme =
+        MatrixFree<dim, double>::AdditionalData::none;
+    additional_data.mapping_update_flags =
+        update_gradients | update_JxW_values | update_quadrature_points;
+    std::shared_ptr< MatrixFree<dim, double> >
+        system_mf_storage(new MatrixFree<dim, double>());
+    system_mf_storage->reinit(*dof_handler, *constraints,
+                              QGauss<1>(fe_degree + 1), additional_data);
+    system_matrix.initialize(system_mf_storage);
+    system_matrix.evaluate_coefficients(*model.get_young_modulus,
+                                        *model.get_poisson_ratio);
+    system_matrix.initialize_dof_vector(solution_mf);
+    system_matrix.initialize_dof_vector(rhs_mf);
+  }
+
+  { // level constraints: zero normal displacement
+    std::vector< std::set<types::boundary_id> > boundary_ids;
+    find_boundary_directions(*dof_handler, boundary_ids);
+
+    mg_constrained_dofs.initialize(*dof_handler);
+    for (int d=0; d<dim; ++d)
+      if (!boundary_ids[d].empty())
+      {
+        std::vector<bool> mask(dim, false);
+        mask[d] = true;
+        mg_constrained_dofs.make_zero_boundary_constraints(*dof_handler,
+                                                           boundary_ids[d],
+                                                           ComponentMask(mask));
+      }
+  }
+
+  const unsigned int n_levels = triangulation.n_global_levels();
+  mg_matrices.resize(0, n_levels-1);
+
+  for (unsigned int level=0; level<n_levels; ++level)
+  {
+    IndexSet relevant_dofs;
+    DoFTools::extract_locally_relevant_level_dofs(*dof_handler, level,
+                                                  relevant_dofs);
+    ConstraintMatrix level_constraints;
+    level_constraints.reinit(relevant_dofs);
+    level_constraints.add_lines(mg_constrained_dofs.get_boundary_indices(level));
+    level_constraints.close();
+
+    typename MatrixFree<dim, float>::AdditionalData additional_data;
+    additional_data.tasks_parallel_scheme =
+        MatrixFree<dim, float>::AdditionalData::none;
+    additional_data.mapping_update_flags =
+        update_gradients | update_JxW_values | update_quadrature_points;
+    additional_data.level_mg_handler = level;
+    std::shared_ptr< MatrixFree<dim, float> >
+        mg_mf_storage_level(new MatrixFree<dim, float>());
+    mg_mf_storage_level->reinit(*dof_handler, level_constraints,
+                                QGauss<1>(fe_degree + 1), additional_data);
+
+    mg_matrices[level].initialize(mg_mf_storage_level, mg_constrained_dofs, level);
+    mg_matrices[level].evaluate_coefficients(*model.get_young_modulus,
+                                             *model.get_poisson_ratio);
+    mg_matrices[level].compute_diagonal();
+  }  // end level loop
+
+  mg_transfer.clear();
+  mg_transfer.initialize_constraints(mg_constrained_dofs);
+  mg_transfer.build(*dof_handler);
+
+  MGLevelObject<typename SmootherType::AdditionalData> smoother_data;
+  smoother_data.resize(0, mg_matrices.max_level());
+  for (unsigned int level=0; level<=mg_matrices.max_level(); ++level)
+  {
+    if (level > 0)
+    {
+      smoother_data[level].smoothing_range = 15.;
+      smoother_data[level].degree = 4;
+      smoother_data[level].eig_cg_n_iterations = 10;
+    }
+    else
+    { // Chebyshev as the coarse solver
+      smoother_data[0].smoothing_range = 1e-3;
+      smoother_data[0].degree = numbers::invalid_unsigned_int;
+      smoother_data[0].eig_cg_n_iterations = mg_matrices[0].m();
+    }
+    smoother_data[level].preconditioner =
+        mg_matrices[level].get_matrix_diagonal_inverse();
+  }
+  mg_smoother.initialize(mg_matrices, smoother_data);
+
+  mg_coarse.initialize(mg_smoother);
+
+  mg_matrix.initialize(mg_matrices);
+
+  // edge matrices for the levels under local refinement
+  mg_interface_matrices.resize(0, mg_matrices.max_level());
+  for (unsigned int level=0; level<=mg_matrices.max_level(); ++level)
+    mg_interface_matrices[level].initialize(mg_matrices[level]);
+  mg_interface.initialize(mg_interface_matrices);
+
+  mg.reset(new Multigrid<LevelVectorType>(mg_matrix, mg_coarse, mg_transfer,
+                                          mg_smoother, mg_smoother));
+  mg->set_edge_matrices(mg_interface, mg_interface);
+
+  preconditioner.reset(new PreconditionMG<dim, LevelVectorType,
+                       MGTransferMatrixFree<dim, float> >
+                       (*dof_handler, *mg, mg_transfer));
+
+  pcout << "Matrix-free elasticity: "
+        << dof_handler->n_dofs() << " dofs, "
+        << n_levels << " levels" << std::endl;
+}  // eom
+
+
+
+template <int dim, int fe_degree>
+unsigned int
+MatrixFreeElasticSolver<dim, fe_degree>::
+solve(TrilinosWrappers::MPI::Vector       &solution,
+      const TrilinosWrappers::MPI::Vector &rhs_vector,
+      const double                         tolerance)
+{
+  // both vector types share the locally owned range
+  const IndexSet & owned_dofs = dof_handler->locally_owned_dofs();
+  for (const auto i : owned_dofs)
+  {
+    rhs_mf(i) = rhs_vector(i);
+    solution_mf(i) = solution(i);
+  }
+  constraints->set_zero(solution_mf);
+
+  SolverControl solver_control(1000, tolerance);
+  SolverCG<VectorType> cg(solver_control);
+  cg.solve(system_matrix, solution_mf, rhs_mf, *preconditioner);
+
+  for (const auto i : owned_dofs)
+    solution(i) = solution_mf(i);
+  solution.compress(VectorOperation::insert);
+
+  return solver_control.last_step();
+}  // eom
+
+#endif
+
+
+
+/*
+ * Instantiate the matrix-free solver for the displacement degree
+ * in the model
+ */
+template <int dim>
+MatrixFreeElasticSolverBase<dim> *
+create_matrix_free_solver(MPI_Comm                &mpi_communicator,
+                          const Model::Model<dim> &model,
+                          ConditionalOStream      &pcout)
+{
+#if DEAL_II_VERSION_GTE(9,0,0)
+  switch (model.displacement_degree)
+  {
+    case 1:
+      return new MatrixFreeElasticSolver<dim,1>(mpi_communicator, model, pcout);
+    case 2:
+      return new MatrixFreeElasticSolver<dim,2>(mpi_communicator, model, pcout);
+    case 3:
+      return new MatrixFreeElasticSolver<dim,3>(mpi_communicator, model, pcout);
+    default:
+      AssertThrow(false, ExcMessage("Matrix-free elasticity is instantiated "
+                                    "for displacement degrees 1 to 3"));
+  }
+#else
+  (void)mpi_communicator;
+  (void)model;
+  (void)pcout;
+  AssertThrow(false, ExcMessage("Matrix-free elasticity requires deal.II 9.0"));
+#endif
+  return NULL;
+}  // eom
+
+}  // end of namespace
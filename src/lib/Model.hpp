@@ -25,16 +25,90 @@ enum ModelType {SingleLiquid, SingleGas, WaterOil, WaterGas, Blackoil,
                 SingleLiquidElasticity, SingleGasElasticity,
                 WaterOilElasticity, WaterGasElasticity, BlackoilElasticity};
 
+/*
+ * Phases of the fluid model types known at compile time.
+ * Used to specialize the cell and face kernels in CellValues
+ */
+template <ModelType type> struct ModelTraits;
+
+template <> struct ModelTraits<ModelType::SingleLiquid>
+{
+  static const bool has_water = true, has_oil = false, has_gas = false;
+  static const unsigned int n_phases = 1;
+};
+
+template <> struct ModelTraits<ModelType::SingleGas>
+{
+  static const bool has_water = false, has_oil = false, has_gas = true;
+  static const unsigned int n_phases = 1;
+};
+
+template <> struct ModelTraits<ModelType::WaterOil>
+{
+  static const bool has_water = true, has_oil = true, has_gas = false;
+  static const unsigned int n_phases = 2;
+};
+
+template <> struct ModelTraits<ModelType::WaterGas>
+{
+  static const bool has_water = true, has_oil = false, has_gas = true;
+  static const unsigned int n_phases = 2;
+};
+
+template <> struct ModelTraits<ModelType::Blackoil>
+{
+  static const bool has_water = true, has_oil = true, has_gas = true;
+  static const unsigned int n_phases = 3;
+};
+
 enum PVTType {Constant, Table, Correlation};
 
 enum Phase {Water, Oil, Gas};
 
 
+enum LoadBalancingType {NoBalancing, ModelBalancing, MeasuredBalancing};
+
+// assembled matrix with AMG or matrix-free operator with geometric multigrid
+enum ElasticSolverType {AssembledAMG, MatrixFreeGMG};
+/* AMG-preconditioned CG, deflated CG that recycles a deflation space
+ * (deflated GMRES for the nonsymmetric water-oil matrix),
+ * or sparse direct solver
+ */
+enum PressureSolverType {AMGCG, DeflatedAMGCG, Direct};
+// algebraic multigrid, or multigrid on the cell hierarchy of the forest
+enum PressurePreconditionerType {AMG, CellGMG};
+/* explicit IMPES update, implicit update in upstream order,
+ * adaptive implicit: implicit only in the cells above a CFL limit,
+ * or explicit with local time steps of dt/2^l
+ */
+enum SaturationSolverType {Explicit, Reordering, Adaptive, LocalTimeStepping};
+
+
 struct ModelConfig
 {
   PVTType pvt_oil, pvt_water, pvt_gas;
 };
 
+
+struct LoadBalancingConfig
+{
+  LoadBalancingType type = LoadBalancingType::NoBalancing;
+  // cost of a well cell and of a hanging subface relative to a regular cell
+  double well_cell_weight = 10;
+  double hanging_face_weight = 0.5;
+  // max/average rank cost that triggers repartitioning
+  double imbalance_threshold = 1.1;
+  // number of steps over which the measured costs are compared
+  unsigned int balancing_window = 10;
+  /* Keep the cells of a well on few processes: the model cost of the
+   * whole well goes to its first cell. p4est cuts the space-filling
+   * curve at accumulated weights and cannot assign chosen cells to a
+   * process, so a light run of well cells is only less likely to be
+   * split; the spread is reported after each repartition
+   */
+  bool group_well_cells = false;
+};
+
 template <int dim>
 class Model
 {
@@ -79,6 +153,10 @@ class Model
 
   // querying data
   bool has_phase(const Phase &phase) const;
+  // model type without the elasticity (e.g. WaterOil for WaterOilElasticity)
+  ModelType fluid_model_type() const;
+  // true for the *Elasticity model types
+  bool has_mechanics() const;
   unsigned int n_phases() const;
   double density_sc_water() const;
   double density_sc_oil() const;
@@ -90,6 +168,11 @@ class Model
   void get_pvt_gas(const double        pressure,
                    std::vector<double> &dst) const;
   double get_time_step(const double time) const;
+  /* check whether a point lies within one of the local prerefinement
+   * boxes (extended by tolerance in each direction)
+   */
+  bool in_local_prerefinement_region(const Point<dim> &p,
+                                     const double      tolerance=0) const;
   std::vector<int> get_well_ids() const;
   void get_relative_permeability(Vector<double>      &saturation,
                                  std::vector<double> &dst) const;
@@ -118,7 +201,16 @@ class Model
   const unsigned int                     n_pvt_gas_columns = 5;
   int                                    initial_refinement_level,
     n_adaptive_steps;
+  // dim (min, max) pairs per prerefinement box and its number of levels
   std::vector<std::pair<double,double>>  local_prerefinement_region;
+  int                                    n_box_refinement_levels;
+  // static refinement around well trajectories
+  int                                    n_well_refinement_levels;
+  double                                 well_refinement_radius;
+  // static refinement along the initial water-oil contact
+  int                                    n_contact_refinement_levels;
+  double                                 contact_depth,
+                                         contact_refinement_thickness;
   Units::Units                           units;
   boost::filesystem::path                mesh_file;
   std::vector< Wellbore<dim> > wells;
@@ -127,9 +219,54 @@ class Model
     min_time_step,
     t_max;
   int                                    max_fss_steps;
+  // sequential implicit loop: relative pressure change, saturation change,
+  // and iterations before the step is cut (0 - IMPES)
+  double                                 sfi_tolerance,
+                                         sfi_saturation_tolerance;
+  int                                    max_sfi_steps;
+  double                                 biot_coefficient;
+  ElasticSolverType                      elastic_solver_type;
+  PressureSolverType                     pressure_solver_type;
+  PressurePreconditionerType             pressure_preconditioner_type;
+  SaturationSolverType                   saturation_solver_type;
+  // adaptive implicit saturation: CFL number above which a cell is implicit
+  double                                 implicit_cfl;
+  // local time stepping: CFL number of the substeps, number of levels
+  double                                 lts_cfl;
+  int                                    time_step_levels;
+  // pressure operator applied from the face list instead of a matrix
+  bool                                   matrix_free_pressure;
+  // pressure assembly: changes of the cell pressure and saturation below
+  // which a row is kept, and assemblies between full ones (1 - always full)
+  double                                 reassembly_pressure_tolerance,
+                                         reassembly_saturation_tolerance;
+  int                                    reassembly_interval;
+  // deflated CG: number of vectors and solves between refreshes
+  int                                    deflation_vectors,
+                                         deflation_refresh;
+  /* Amesos solver and the number of dofs up to which it replaces the
+   * iterative one, also with the matrix-free operator (default 0:
+   * direct solves only with the Direct pressure solver)
+   */
+  std::string                            direct_solver_name;
+  int                                    direct_solver_size;
+  int                                    displacement_degree;
+  // refinement level of the mechanics cells (-1 - active flow cells)
+  int                                    mechanics_level;
+  // multirate coupling: flow steps per mechanics solve
+  int                                    mechanics_interval;
+  // pressure change that triggers an early mechanics solve (0 - off)
+  double                                 mechanics_pressure_change,
+                                         mechanics_lag_tolerance;
+  // initial guess of the pressure solves: extrapolation order
+  // (0 - last solution), POD basis size (0 - off), cold solve for the log
+  int                                    pressure_guess_order,
+                                         pressure_pod_basis;
+  bool                                   compare_pressure_guess;
 
   ModelType                              type;
   ModelConfig                            config;
+  LoadBalancingConfig                    load_balancing;
  protected:
   std::string                            mesh_file_name,
                                          input_file_name;
@@ -143,6 +280,8 @@ class Model
                                          pvt_table_gas;
   RelativePermeability                   rel_perm;
   std::vector<Phase>                     phases;
+  ModelType                              fluid_type;
+  bool                                   mechanics;
  private:
   std::map<double, double>               timestep_table;
   std::map<std::string, int>             well_ids;
@@ -164,6 +303,44 @@ Model<dim>::Model(MPI_Comm           &mpi_communicator_,
 {
   // declare_parameters();
   verbosity = 0;
+  initial_refinement_level = 0;
+  n_adaptive_steps = 0;
+  n_box_refinement_levels = 0;
+  n_well_refinement_levels = 0;
+  well_refinement_radius = 0;
+  n_contact_refinement_levels = 0;
+  contact_depth = 0;
+  contact_refinement_thickness = 0;
+  fss_tolerance = 1e-6;
+  max_fss_steps = 20;
+  sfi_tolerance = 1e-6;
+  sfi_saturation_tolerance = 1e-4;
+  max_sfi_steps = 0;
+  biot_coefficient = 1;
+  elastic_solver_type = ElasticSolverType::AssembledAMG;
+  pressure_solver_type = PressureSolverType::AMGCG;
+  pressure_preconditioner_type = PressurePreconditionerType::AMG;
+  saturation_solver_type = SaturationSolverType::Explicit;
+  implicit_cfl = 0.9;
+  lts_cfl = 0.9;
+  time_step_levels = 6;
+  matrix_free_pressure = false;
+  reassembly_pressure_tolerance = 0;
+  reassembly_saturation_tolerance = 0;
+  reassembly_interval = 1;
+  deflation_vectors = 8;
+  deflation_refresh = 5;
+  direct_solver_name = "Amesos_Klu";
+  direct_solver_size = 0;
+  displacement_degree = 1;
+  mechanics_level = -1;
+  mechanics_interval = 1;
+  mechanics_pressure_change = 0;
+  mechanics_lag_tolerance = 0.1;
+  pressure_guess_order = 1;
+  pressure_pod_basis = 0;
+  compare_pressure_guess = false;
+  mechanics = false;
   units.set_system(Units::si_units);
 }  // eom
 
@@ -173,6 +350,7 @@ template <int dim>
 Model<dim>::~Model()
 {
   delete get_young_modulus;
+  delete get_poisson_ratio;
   delete get_permeability;
   delete get_porosity;
 }
@@ -242,6 +420,31 @@ int Model<dim>::get_well_id(const std::string& well_name) const
 
 
 
+template <int dim>
+bool Model<dim>::in_local_prerefinement_region(const Point<dim> &p,
+                                               const double      tolerance) const
+{
+  const unsigned int n_boxes = local_prerefinement_region.size() / dim;
+  for (unsigned int b=0; b<n_boxes; ++b)
+  {
+    bool inside = true;
+    for (int d=0; d<dim; ++d)
+    {
+      const auto & range = local_prerefinement_region[b*dim + d];
+      if (p[d] < range.first - tolerance || p[d] > range.second + tolerance)
+      {
+        inside = false;
+        break;
+      }
+    }
+    if (inside)
+      return true;
+  }
+  return false;
+}  // eom
+
+
+
 template <int dim>
 std::vector<int> Model<dim>::get_well_ids() const
 {
@@ -370,9 +573,26 @@ void Model<dim>::set_model_type(ModelType model_type)
   phases.clear();
   type = model_type;
 
-  if (model_type == ModelType::SingleLiquid)
+  mechanics = true;
+  if (model_type == ModelType::SingleLiquidElasticity)
+    fluid_type = ModelType::SingleLiquid;
+  else if (model_type == ModelType::SingleGasElasticity)
+    fluid_type = ModelType::SingleGas;
+  else if (model_type == ModelType::WaterOilElasticity)
+    fluid_type = ModelType::WaterOil;
+  else if (model_type == ModelType::WaterGasElasticity)
+    fluid_type = ModelType::WaterGas;
+  else if (model_type == ModelType::BlackoilElasticity)
+    fluid_type = ModelType::Blackoil;
+  else
+  {
+    fluid_type = model_type;
+    mechanics = false;
+  }
+
+  if (fluid_type == ModelType::SingleLiquid)
     phases.push_back(Phase::Water);
-  else if (model_type == WaterOil)
+  else if (fluid_type == WaterOil)
   {
     phases.push_back(Phase::Water);
     phases.push_back(Phase::Oil);
@@ -396,6 +616,24 @@ bool Model<dim>::has_phase(const Phase &phase) const
 
 
 
+template <int dim>
+inline
+ModelType Model<dim>::fluid_model_type() const
+{
+  return fluid_type;
+}  // eom
+
+
+
+template <int dim>
+inline
+bool Model<dim>::has_mechanics() const
+{
+  return mechanics;
+}  // eom
+
+
+
 template <int dim>
 inline
 unsigned int Model<dim>::n_phases() const
@@ -426,9 +664,9 @@ void Model<dim>::get_relative_permeability(Vector<double>      &saturation,
   AssertThrow(dst.size() == n_phases(),
               ExcDimensionMismatch(dst.size(), n_phases()));
 
-  if (type == SingleLiquid)
+  if (fluid_type == SingleLiquid)
     dst[0] = 1;
-  else if (type == WaterOil)
+  else if (fluid_type == WaterOil)
     rel_perm.get_values(saturation, dst);
   else
     AssertThrow(false, ExcNotImplemented());
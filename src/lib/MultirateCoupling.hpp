@@ -0,0 +1,195 @@
+#pragma once
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/lac/trilinos_vector.h>
+
+// Custom modules
+#include <Model.hpp>
+
+
+namespace Coupling
+{
+using namespace dealii;
+
+
+/*
+ * Multirate poroelastic coupling.
+ * Mechanics is solved only every few flow steps, or earlier when the
+ * pressure has changed by more than a threshold since the last
+ * mechanics solve. In between, the volumetric strain is extrapolated
+ * linearly in time from the last two mechanics solves.
+ * At each mechanics solve the extrapolation is compared to the new
+ * strain: the lag indicator is the part of the strain increment that
+ * the extrapolation missed.
+ * All vectors are DG0 vectors on the locally owned flow dofs.
+ */
+template <int dim>
+class MultirateCoupling
+{
+ public:
+  MultirateCoupling(MPI_Comm                &mpi_communicator_,
+                    const Model::Model<dim> &model_);
+  /* allocate vectors and forget the history;
+   * the next flow step solves mechanics
+   */
+  void reinit(const IndexSet &locally_owned_dofs);
+  // step counter and pressure change since the last mechanics solve
+  bool needs_update(const TrilinosWrappers::MPI::Vector &pressure);
+  // strain at the given time extrapolated from the last mechanics solves
+  void extrapolate(const double                   time,
+                   TrilinosWrappers::MPI::Vector &strain);
+  /* Record a mechanics solve and return the lag indicator:
+   * |e - e_extrapolated| / |e - e_last| (zero without extrapolation)
+   */
+  double update(const double                         time,
+                const TrilinosWrappers::MPI::Vector &strain,
+                const TrilinosWrappers::MPI::Vector &pressure);
+  // count a flow step
+  void advance();
+  // max pressure change since the last mechanics solve
+  double get_pressure_change() const;
+
+ private:
+  MPI_Comm                      &mpi_communicator;
+  const Model::Model<dim>       &model;
+  TrilinosWrappers::MPI::Vector strain_at_update,
+                                strain_rate,
+                                pressure_at_update,
+                                prediction,
+                                tmp;
+  double                        time_at_update,
+                                pressure_change;
+  int                           steps_since_update;
+  unsigned int                  n_updates;
+};
+
+
+
+template <int dim>
+MultirateCoupling<dim>::
+MultirateCoupling(MPI_Comm                &mpi_communicator_,
+                  const Model::Model<dim> &model_)
+    :
+    mpi_communicator(mpi_communicator_),
+    model(model_),
+    time_at_update(0),
+    pressure_change(0),
+    steps_since_update(0),
+    n_updates(0)
+{}  // eom
+
+
+
+template <int dim>
+void
+MultirateCoupling<dim>::reinit(const IndexSet &locally_owned_dofs)
+{
+  strain_at_update.reinit(locally_owned_dofs, mpi_communicator);
+  strain_rate.reinit(locally_owned_dofs, mpi_communicator);
+  pressure_at_update.reinit(locally_owned_dofs, mpi_communicator);
+  prediction.reinit(locally_owned_dofs, mpi_communicator);
+  tmp.reinit(locally_owned_dofs, mpi_communicator);
+  time_at_update = 0;
+  pressure_change = 0;
+  steps_since_update = model.mechanics_interval;
+  n_updates = 0;
+}  // eom
+
+
+
+template <int dim>
+bool
+MultirateCoupling<dim>::
+needs_update(const TrilinosWrappers::MPI::Vector &pressure)
+{
+  if (n_updates == 0 || steps_since_update >= model.mechanics_interval)
+    return true;
+
+  if (model.mechanics_pressure_change > 0)
+  {
+    tmp = pressure;
+    tmp -= pressure_at_update;
+    pressure_change = tmp.linfty_norm();
+    if (pressure_change > model.mechanics_pressure_change)
+      return true;
+  }
+
+  return false;
+}  // eom
+
+
+
+template <int dim>
+void
+MultirateCoupling<dim>::
+extrapolate(const double                   time,
+            TrilinosWrappers::MPI::Vector &strain)
+{
+  if (n_updates == 0)
+    return;
+
+  strain = strain_at_update;
+  if (n_updates > 1)
+    strain.add(time - time_at_update, strain_rate);
+  prediction = strain;
+}  // eom
+
+
+
+template <int dim>
+double
+MultirateCoupling<dim>::
+update(const double                         time,
+       const TrilinosWrappers::MPI::Vector &strain,
+       const TrilinosWrappers::MPI::Vector &pressure)
+{
+  double lag = 0;
+
+  // strain increment since the last mechanics solve
+  tmp = strain;
+  tmp -= strain_at_update;
+  if (n_updates > 1)
+  {
+    const double increment = tmp.linfty_norm();
+    prediction -= strain;
+    if (increment > 0)
+      lag = prediction.linfty_norm() / increment;
+  }
+
+  if (n_updates > 0 && time > time_at_update)
+  {
+    strain_rate = tmp;
+    strain_rate /= (time - time_at_update);
+  }
+
+  strain_at_update = strain;
+  pressure_at_update = pressure;
+  time_at_update = time;
+  pressure_change = 0;
+  steps_since_update = 0;
+  n_updates++;
+
+  return lag;
+}  // eom
+
+
+
+template <int dim>
+inline
+void
+MultirateCoupling<dim>::advance()
+{
+  steps_since_update++;
+}  // eom
+
+
+
+template <int dim>
+inline
+double
+MultirateCoupling<dim>::get_pressure_change() const
+{
+  return pressure_change;
+}  // eom
+
+}  // end of namespace
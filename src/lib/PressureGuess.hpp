@@ -0,0 +1,225 @@
+#pragma once
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/lac/trilinos_vector.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+#include <algorithm>
+#include <cmath>
+
+// Custom modules
+#include <Model.hpp>
+
+
+namespace FluidSolvers
+{
+using namespace dealii;
+
+
+/*
+ * Initial guess for the pressure solves.
+ * The guess is the polynomial extrapolation in time through the last
+ * two (linear) or three (quadratic) pressure solutions; the Lagrange
+ * weights account for variable time steps.
+ * With a POD basis the guess is then corrected by the Galerkin
+ * projection of its error onto the span of the last few solutions:
+ * x += V (V^T r), with V orthonormal in the matrix inner product
+ * and r = b - A x.
+ * All vectors are DG0 vectors on the locally owned flow dofs.
+ */
+template <int dim>
+class PressureGuess
+{
+ public:
+  PressureGuess(MPI_Comm                &mpi_communicator_,
+                const Model::Model<dim> &model_);
+  // allocate vectors and forget the history
+  void reinit(const IndexSet &locally_owned_dofs);
+  // false if there is no history or the guess is switched off
+  bool active() const;
+  // extrapolate the last solutions to the given time
+  void predict(const double                   time,
+               TrilinosWrappers::MPI::Vector &solution);
+  /* correct the guess with the POD basis of the last solutions;
+   * MatrixType is a sparse matrix or an operator with vmult and residual
+   */
+  template <typename MatrixType>
+  void project(const MatrixType                     &matrix,
+               const TrilinosWrappers::MPI::Vector  &rhs,
+               TrilinosWrappers::MPI::Vector        &solution);
+  // store a converged solution
+  void record(const double                         time,
+              const TrilinosWrappers::MPI::Vector &solution);
+
+ private:
+  // stored solution that was recorded n steps ago
+  unsigned int slot(const unsigned int n) const;
+
+  MPI_Comm                                   &mpi_communicator;
+  const Model::Model<dim>                    &model;
+  // ring buffer of the last solutions and their times
+  std::vector<TrilinosWrappers::MPI::Vector> history;
+  std::vector<double>                        times;
+  unsigned int                               n_stored, last;
+  // orthonormal basis and its matrix products
+  std::vector<TrilinosWrappers::MPI::Vector> basis, matrix_basis;
+  TrilinosWrappers::MPI::Vector              residual;
+};
+
+
+
+template <int dim>
+PressureGuess<dim>::
+PressureGuess(MPI_Comm                &mpi_communicator_,
+              const Model::Model<dim> &model_)
+    :
+    mpi_communicator(mpi_communicator_),
+    model(model_),
+    n_stored(0),
+    last(0)
+{}  // eom
+
+
+
+template <int dim>
+void
+PressureGuess<dim>::reinit(const IndexSet &locally_owned_dofs)
+{
+  const unsigned int n_pod = model.pressure_pod_basis;
+  const unsigned int size =
+      std::max(static_cast<unsigned int>(model.pressure_guess_order + 1), n_pod);
+
+  history.resize(size);
+  times.assign(size, 0);
+  for (auto & vector : history)
+    vector.reinit(locally_owned_dofs, mpi_communicator);
+
+  basis.resize(n_pod);
+  matrix_basis.resize(n_pod);
+  for (unsigned int i=0; i<n_pod; ++i)
+  {
+    basis[i].reinit(locally_owned_dofs, mpi_communicator);
+    matrix_basis[i].reinit(locally_owned_dofs, mpi_communicator);
+  }
+  residual.reinit(locally_owned_dofs, mpi_communicator);
+
+  n_stored = 0;
+  last = 0;
+}  // eom
+
+
+
+template <int dim>
+inline
+unsigned int
+PressureGuess<dim>::slot(const unsigned int n) const
+{
+  return (last + history.size() - n) % history.size();
+}  // eom
+
+
+
+template <int dim>
+inline
+bool
+PressureGuess<dim>::active() const
+{
+  return (n_stored > 0 &&
+          (model.pressure_guess_order > 0 || model.pressure_pod_basis > 0));
+}  // eom
+
+
+
+template <int dim>
+void
+PressureGuess<dim>::predict(const double                   time,
+                            TrilinosWrappers::MPI::Vector &solution)
+{
+  const unsigned int n_points =
+      std::min(n_stored, static_cast<unsigned int>(model.pressure_guess_order + 1));
+  if (n_points == 0)
+    return;
+
+  // Lagrange weights of the points at the new time
+  solution = 0;
+  for (unsigned int j=0; j<n_points; ++j)
+  {
+    double weight = 1;
+    for (unsigned int m=0; m<n_points; ++m)
+      if (m != j)
+        weight *= (time - times[slot(m)]) / (times[slot(j)] - times[slot(m)]);
+    solution.add(weight, history[slot(j)]);
+  }
+}  // eom
+
+
+
+template <int dim>
+template <typename MatrixType>
+void
+PressureGuess<dim>::
+project(const MatrixType                     &matrix,
+        const TrilinosWrappers::MPI::Vector  &rhs,
+        TrilinosWrappers::MPI::Vector        &solution)
+{
+  const unsigned int n_snapshots =
+      std::min(n_stored, static_cast<unsigned int>(model.pressure_pod_basis));
+  if (n_snapshots == 0)
+    return;
+
+  // modified Gram-Schmidt in the matrix inner product;
+  // nearly dependent snapshots are dropped
+  unsigned int n_basis = 0;
+  for (unsigned int s=0; s<n_snapshots; ++s)
+  {
+    TrilinosWrappers::MPI::Vector &v = basis[n_basis];
+    TrilinosWrappers::MPI::Vector &Av = matrix_basis[n_basis];
+    v = history[slot(s)];
+    matrix.vmult(Av, v);
+    const double initial_norm = std::sqrt(std::abs(v*Av));
+
+    for (unsigned int i=0; i<n_basis; ++i)
+    {
+      const double c = basis[i]*Av;
+      v.add(-c, basis[i]);
+      Av.add(-c, matrix_basis[i]);
+    }
+
+    const double norm = std::sqrt(std::abs(v*Av));
+    if (norm <= 1e-8*initial_norm || norm == 0.0)
+      continue;
+    v /= norm;
+    Av /= norm;
+    n_basis++;
+  }
+
+  matrix.residual(residual, solution, rhs);
+  for (unsigned int i=0; i<n_basis; ++i)
+  {
+    const double c = basis[i]*residual;
+    solution.add(c, basis[i]);
+    residual.add(-c, matrix_basis[i]);
+  }
+}  // eom
+
+
+
+template <int dim>
+void
+PressureGuess<dim>::
+record(const double                         time,
+       const TrilinosWrappers::MPI::Vector &solution)
+{
+  if (history.empty())
+    return;
+
+  // a repeated time replaces the last solution
+  if (n_stored > 0 && time != times[last])
+    last = (last + 1) % history.size();
+  else if (n_stored > 0)
+    n_stored--;
+  history[last] = solution;
+  times[last] = time;
+  n_stored = std::min(n_stored + 1, static_cast<unsigned int>(history.size()));
+}  // eom
+
+}  // end of namespace
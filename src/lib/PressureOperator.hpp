@@ -0,0 +1,479 @@
+#pragma once
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/base/utilities.h>
+#include <deal.II/lac/trilinos_vector.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+#include <deal.II/lac/trilinos_sparsity_pattern.h>
+#include <deal.II/lac/trilinos_precondition.h>
+
+// Custom modules
+#include <FVTools.hpp>
+
+
+namespace FluidSolvers
+{
+using namespace dealii;
+
+
+/*
+ * Matrix-free TPFA pressure operator.
+ * Row i of the IMPES pressure matrix is
+ *   (A p)_i = c_i p_i + sum_faces sum_phases w_i^phase T^phase (p_i - p_j),
+ * with the cell entry c_i, the phase weights of the row cell w_i
+ * (c2o/c1w and 1 for water-oil), and the phase transmissibilities of
+ * the face. The face transmissibilities are read from the FaceList of
+ * the pressure solver, so each face is visited once per product
+ * and no matrix entries are stored.
+ * Vectors are on the locally owned dofs; the ghost values of the
+ * source are imported into an internal vector.
+ */
+class PressureOperator
+{
+ public:
+  PressureOperator(MPI_Comm &mpi_communicator_);
+  // positions of the cells and faces; call after the face list is built
+  void reinit(const FVTools::LocalIndexMap &index_map,
+              const FVTools::FaceList      &faces_,
+              const IndexSet               &locally_owned_dofs,
+              const IndexSet               &locally_relevant_dofs,
+              const unsigned int            n_phases);
+  void vmult(TrilinosWrappers::MPI::Vector       &dst,
+             const TrilinosWrappers::MPI::Vector &src) const;
+  // dst = b - A x, returns the l2 norm of dst
+  double residual(TrilinosWrappers::MPI::Vector       &dst,
+                  const TrilinosWrappers::MPI::Vector &x,
+                  const TrilinosWrappers::MPI::Vector &b) const;
+  // the diagonal entries at the owned positions
+  void compute_diagonal(std::vector<double> &diagonal) const;
+  types::global_dof_index m() const;
+
+  // set by the assembly at the owned positions
+  std::vector<double>                cell_entries;
+  // [phase][owned position]
+  std::vector< std::vector<double> > phase_weights;
+
+  const FVTools::FaceList           *faces;
+  // owned position of the face cells, invalid for ghosts
+  std::vector<unsigned int>          owned_first, owned_second;
+  // relevant position of each owned position
+  std::vector<unsigned int>          owned_to_relevant;
+
+ private:
+  MPI_Comm                              &mpi_communicator;
+  types::global_dof_index               n_dofs;
+  mutable TrilinosWrappers::MPI::Vector ghosted;
+};
+
+
+
+/*
+ * Two-level preconditioner for the matrix-free pressure operator:
+ * damped Jacobi smoothing with the diagonal, and a coarse correction
+ * on aggregates of face neighbors. The coarse matrix P^T A P with the
+ * piecewise constant P is assembled directly from the face list (faces
+ * inside an aggregate cancel), so it is a fraction of the fine matrix.
+ * The coarse problem is approximated by one AMG cycle.
+ * Aggregates do not cross subdomain boundaries, so the transfers
+ * are local.
+ */
+class PressureOperatorPreconditioner
+{
+ public:
+  PressureOperatorPreconditioner(MPI_Comm &mpi_communicator_);
+  // aggregates and coarse sparsity pattern, once per mesh
+  void reinit(const PressureOperator &pressure_operator,
+              const IndexSet         &locally_owned_dofs,
+              const IndexSet         &locally_relevant_dofs);
+  // diagonal, coarse matrix, and coarse AMG, once per assembly
+  void initialize(const PressureOperator &pressure_operator);
+  void vmult(TrilinosWrappers::MPI::Vector       &dst,
+             const TrilinosWrappers::MPI::Vector &src) const;
+
+ private:
+  // x += omega D^{-1} (b - A x)
+  void smooth(TrilinosWrappers::MPI::Vector       &x,
+              const TrilinosWrappers::MPI::Vector &b) const;
+
+  MPI_Comm                              &mpi_communicator;
+  const PressureOperator                *pressure_operator_;
+  std::vector<double>                   diagonal_inverse;
+  // coarse dof (global) of each owned position and of each face cell
+  std::vector<types::global_dof_index>  aggregate, aggregate_first, aggregate_second;
+  IndexSet                              coarse_owned;
+  TrilinosWrappers::SparseMatrix        coarse_matrix;
+  TrilinosWrappers::PreconditionAMG     coarse_solver;
+  mutable TrilinosWrappers::MPI::Vector r, coarse_rhs, coarse_solution;
+};
+
+
+
+inline
+PressureOperator::PressureOperator(MPI_Comm &mpi_communicator_)
+    :
+    faces(NULL),
+    mpi_communicator(mpi_communicator_),
+    n_dofs(0)
+{}  // eom
+
+
+
+inline
+void
+PressureOperator::reinit(const FVTools::LocalIndexMap &index_map,
+                         const FVTools::FaceList      &faces_,
+                         const IndexSet               &locally_owned_dofs,
+                         const IndexSet               &locally_relevant_dofs,
+                         const unsigned int            n_phases)
+{
+  faces = &faces_;
+  n_dofs = locally_owned_dofs.size();
+  const unsigned int n_owned = locally_owned_dofs.n_elements();
+
+  cell_entries.assign(n_owned, 0);
+  phase_weights.assign(n_phases, std::vector<double>(n_owned, 0));
+
+  // owned position of each relevant position
+  std::vector<unsigned int> relevant_to_owned(locally_relevant_dofs.n_elements(),
+                                              numbers::invalid_unsigned_int);
+  owned_to_relevant.resize(n_owned);
+  for (unsigned int k=0; k<index_map.cell_dofs.size(); ++k)
+  {
+    owned_to_relevant[index_map.cell_owned[k]] = index_map.cell_relevant[k];
+    relevant_to_owned[index_map.cell_relevant[k]] = index_map.cell_owned[k];
+  }
+
+  const unsigned int n_faces = faces->first.size();
+  owned_first.resize(n_faces);
+  owned_second.resize(n_faces);
+  for (unsigned int f=0; f<n_faces; ++f)
+  {
+    owned_first[f] = relevant_to_owned[faces->first[f]];
+    owned_second[f] = relevant_to_owned[faces->second[f]];
+  }
+
+  ghosted.reinit(locally_owned_dofs, locally_relevant_dofs, mpi_communicator);
+}  // eom
+
+
+
+inline
+types::global_dof_index
+PressureOperator::m() const
+{
+  return n_dofs;
+}  // eom
+
+
+
+inline
+void
+PressureOperator::vmult(TrilinosWrappers::MPI::Vector       &dst,
+                        const TrilinosWrappers::MPI::Vector &src) const
+{
+  AssertThrow(faces != NULL, ExcMessage("Call reinit first"));
+  ghosted = src;
+  const double *p = FVTools::local_values(ghosted);
+  double *y = dst.trilinos_vector()[0];
+  const unsigned int n_phases = phase_weights.size();
+
+  for (unsigned int i=0; i<cell_entries.size(); ++i)
+    y[i] = cell_entries[i]*p[owned_to_relevant[i]];
+
+  for (unsigned int f=0; f<owned_first.size(); ++f)
+  {
+    const double dp = p[faces->first[f]] - p[faces->second[f]];
+    const unsigned int a = owned_first[f];
+    const unsigned int b = owned_second[f];
+    for (unsigned int phase=0; phase<n_phases; ++phase)
+    {
+      const double flux = faces->transmissibility[phase][f]*dp;
+      if (a != numbers::invalid_unsigned_int)
+        y[a] += phase_weights[phase][a]*flux;
+      if (b != numbers::invalid_unsigned_int)
+        y[b] -= phase_weights[phase][b]*flux;
+    }
+  }
+}  // eom
+
+
+
+inline
+double
+PressureOperator::residual(TrilinosWrappers::MPI::Vector       &dst,
+                           const TrilinosWrappers::MPI::Vector &x,
+                           const TrilinosWrappers::MPI::Vector &b) const
+{
+  vmult(dst, x);
+  dst.sadd(-1., b);
+  return dst.l2_norm();
+}  // eom
+
+
+
+inline
+void
+PressureOperator::compute_diagonal(std::vector<double> &diagonal) const
+{
+  diagonal = cell_entries;
+  const unsigned int n_phases = phase_weights.size();
+  for (unsigned int f=0; f<owned_first.size(); ++f)
+    for (unsigned int phase=0; phase<n_phases; ++phase)
+    {
+      const double T = faces->transmissibility[phase][f];
+      if (owned_first[f] != numbers::invalid_unsigned_int)
+        diagonal[owned_first[f]] += phase_weights[phase][owned_first[f]]*T;
+      if (owned_second[f] != numbers::invalid_unsigned_int)
+        diagonal[owned_second[f]] += phase_weights[phase][owned_second[f]]*T;
+    }
+}  // eom
+
+
+
+inline
+PressureOperatorPreconditioner::
+PressureOperatorPreconditioner(MPI_Comm &mpi_communicator_)
+    :
+    mpi_communicator(mpi_communicator_),
+    pressure_operator_(NULL)
+{}  // eom
+
+
+
+inline
+void
+PressureOperatorPreconditioner::
+reinit(const PressureOperator &pressure_operator,
+       const IndexSet         &locally_owned_dofs,
+       const IndexSet         &locally_relevant_dofs)
+{
+  const unsigned int n_owned = locally_owned_dofs.n_elements();
+  const std::vector<unsigned int> &first = pressure_operator.owned_first;
+  const std::vector<unsigned int> &second = pressure_operator.owned_second;
+  const unsigned int n_faces = first.size();
+
+  // owned neighbors of the owned cells
+  std::vector<unsigned int> offsets(n_owned + 1, 0), neighbors;
+  for (unsigned int f=0; f<n_faces; ++f)
+    if (first[f] != numbers::invalid_unsigned_int &&
+        second[f] != numbers::invalid_unsigned_int)
+    {
+      offsets[first[f] + 1]++;
+      offsets[second[f] + 1]++;
+    }
+  for (unsigned int i=0; i<n_owned; ++i)
+    offsets[i+1] += offsets[i];
+  neighbors.resize(offsets[n_owned]);
+  {
+    std::vector<unsigned int> position(offsets.begin(), offsets.end() - 1);
+    for (unsigned int f=0; f<n_faces; ++f)
+      if (first[f] != numbers::invalid_unsigned_int &&
+          second[f] != numbers::invalid_unsigned_int)
+      {
+        neighbors[position[first[f]]++] = second[f];
+        neighbors[position[second[f]]++] = first[f];
+      }
+  }
+
+  // greedy aggregation: a cell with all neighbors free takes them,
+  // the remaining cells join a neighboring aggregate
+  const unsigned int invalid = numbers::invalid_unsigned_int;
+  std::vector<unsigned int> local_aggregate(n_owned, invalid);
+  unsigned int n_local = 0;
+  for (unsigned int i=0; i<n_owned; ++i)
+  {
+    if (local_aggregate[i] != invalid)
+      continue;
+    bool free = true;
+    for (unsigned int n=offsets[i]; n<offsets[i+1]; ++n)
+      free = free && (local_aggregate[neighbors[n]] == invalid);
+    if (!free)
+      continue;
+    local_aggregate[i] = n_local;
+    for (unsigned int n=offsets[i]; n<offsets[i+1]; ++n)
+      local_aggregate[neighbors[n]] = n_local;
+    n_local++;
+  }
+  for (unsigned int i=0; i<n_owned; ++i)
+    if (local_aggregate[i] == invalid)
+    {
+      for (unsigned int n=offsets[i]; n<offsets[i+1]; ++n)
+        if (local_aggregate[neighbors[n]] != invalid)
+        {
+          local_aggregate[i] = local_aggregate[neighbors[n]];
+          break;
+        }
+      if (local_aggregate[i] == invalid)
+        local_aggregate[i] = n_local++;
+    }
+
+  // contiguous global numbering of the aggregates
+  unsigned int offset = 0;
+  MPI_Exscan(&n_local, &offset, 1, MPI_UNSIGNED, MPI_SUM, mpi_communicator);
+  if (Utilities::MPI::this_mpi_process(mpi_communicator) == 0)
+    offset = 0;
+  coarse_owned = IndexSet(Utilities::MPI::sum(n_local, mpi_communicator));
+  coarse_owned.add_range(offset, offset + n_local);
+  coarse_owned.compress();
+
+  aggregate.resize(n_owned);
+  for (unsigned int i=0; i<n_owned; ++i)
+    aggregate[i] = offset + local_aggregate[i];
+
+  // aggregates of the face cells, ghosts included
+  const FVTools::FaceList &faces = *pressure_operator.faces;
+  TrilinosWrappers::MPI::Vector owned_aggregate(locally_owned_dofs, mpi_communicator),
+      relevant_aggregate(locally_owned_dofs, locally_relevant_dofs, mpi_communicator);
+  for (unsigned int i=0; i<n_owned; ++i)
+    owned_aggregate[locally_owned_dofs.nth_index_in_set(i)] = aggregate[i];
+  owned_aggregate.compress(VectorOperation::insert);
+  relevant_aggregate = owned_aggregate;
+  const double *aggregate_values = FVTools::local_values(relevant_aggregate);
+  aggregate_first.resize(n_faces);
+  aggregate_second.resize(n_faces);
+  for (unsigned int f=0; f<n_faces; ++f)
+  {
+    aggregate_first[f] =
+        static_cast<types::global_dof_index>(aggregate_values[faces.first[f]]);
+    aggregate_second[f] =
+        static_cast<types::global_dof_index>(aggregate_values[faces.second[f]]);
+  }
+
+  { // coarse matrix: rows of the owned face cells
+    coarse_matrix.clear();
+    TrilinosWrappers::SparsityPattern pattern(coarse_owned, mpi_communicator);
+    for (unsigned int i=0; i<n_owned; ++i)
+      pattern.add(aggregate[i], aggregate[i]);
+    for (unsigned int f=0; f<n_faces; ++f)
+    {
+      if (first[f] != numbers::invalid_unsigned_int)
+        pattern.add(aggregate_first[f], aggregate_second[f]);
+      if (second[f] != numbers::invalid_unsigned_int)
+        pattern.add(aggregate_second[f], aggregate_first[f]);
+    }
+    pattern.compress();
+    coarse_matrix.reinit(pattern);
+  }
+
+  diagonal_inverse.resize(n_owned);
+  r.reinit(locally_owned_dofs, mpi_communicator);
+  coarse_rhs.reinit(coarse_owned, mpi_communicator);
+  coarse_solution.reinit(coarse_owned, mpi_communicator);
+  pressure_operator_ = NULL;
+}  // eom
+
+
+
+inline
+void
+PressureOperatorPreconditioner::
+initialize(const PressureOperator &pressure_operator)
+{
+  AssertThrow(aggregate.size() == pressure_operator.cell_entries.size(),
+              ExcMessage("Call reinit first"));
+  pressure_operator_ = &pressure_operator;
+
+  pressure_operator.compute_diagonal(diagonal_inverse);
+  for (auto & value : diagonal_inverse)
+    value = 1./value;
+
+  // Galerkin coarse matrix of the piecewise constant prolongation
+  const std::vector<unsigned int> &first = pressure_operator.owned_first;
+  const std::vector<unsigned int> &second = pressure_operator.owned_second;
+  const FVTools::FaceList &faces = *pressure_operator.faces;
+  const unsigned int n_phases = pressure_operator.phase_weights.size();
+  coarse_matrix = 0;
+  for (unsigned int i=0; i<aggregate.size(); ++i)
+    coarse_matrix.add(aggregate[i], aggregate[i],
+                      pressure_operator.cell_entries[i]);
+  for (unsigned int f=0; f<first.size(); ++f)
+  {
+    const unsigned int a = first[f], b = second[f];
+    // faces inside an aggregate cancel
+    if (aggregate_first[f] == aggregate_second[f])
+      continue;
+    double entry_a = 0, entry_b = 0;
+    for (unsigned int phase=0; phase<n_phases; ++phase)
+    {
+      const double T = faces.transmissibility[phase][f];
+      if (a != numbers::invalid_unsigned_int)
+        entry_a += pressure_operator.phase_weights[phase][a]*T;
+      if (b != numbers::invalid_unsigned_int)
+        entry_b += pressure_operator.phase_weights[phase][b]*T;
+    }
+    if (a != numbers::invalid_unsigned_int)
+    {
+      coarse_matrix.add(aggregate_first[f], aggregate_first[f], entry_a);
+      coarse_matrix.add(aggregate_first[f], aggregate_second[f], -entry_a);
+    }
+    if (b != numbers::invalid_unsigned_int)
+    {
+      coarse_matrix.add(aggregate_second[f], aggregate_second[f], entry_b);
+      coarse_matrix.add(aggregate_second[f], aggregate_first[f], -entry_b);
+    }
+  }
+  coarse_matrix.compress(VectorOperation::add);
+
+  TrilinosWrappers::PreconditionAMG::AdditionalData data_amg;
+  data_amg.elliptic = true;
+  coarse_solver.initialize(coarse_matrix, data_amg);
+}  // eom
+
+
+
+inline
+void
+PressureOperatorPreconditioner::
+smooth(TrilinosWrappers::MPI::Vector       &x,
+       const TrilinosWrappers::MPI::Vector &b) const
+{
+  // Jacobi weight for diagonally dominant TPFA rows
+  const double omega = 2./3.;
+  pressure_operator_->residual(r, x, b);
+  double *x_values = x.trilinos_vector()[0];
+  const double *r_values = FVTools::local_values(r);
+  for (unsigned int i=0; i<diagonal_inverse.size(); ++i)
+    x_values[i] += omega*diagonal_inverse[i]*r_values[i];
+}  // eom
+
+
+
+inline
+void
+PressureOperatorPreconditioner::
+vmult(TrilinosWrappers::MPI::Vector       &dst,
+      const TrilinosWrappers::MPI::Vector &src) const
+{
+  AssertThrow(pressure_operator_ != NULL, ExcMessage("Call initialize first"));
+  const unsigned int n_owned = aggregate.size();
+  const types::global_dof_index coarse_start =
+      (coarse_owned.n_elements() > 0) ? coarse_owned.nth_index_in_set(0) : 0;
+
+  // pre-smoothing from zero
+  dst = 0;
+  smooth(dst, src);
+  smooth(dst, src);
+
+  // coarse correction, the transfers are local
+  pressure_operator_->residual(r, dst, src);
+  {
+    coarse_rhs = 0;
+    double *rc = coarse_rhs.trilinos_vector()[0];
+    const double *r_values = FVTools::local_values(r);
+    for (unsigned int i=0; i<n_owned; ++i)
+      rc[aggregate[i] - coarse_start] += r_values[i];
+  }
+  coarse_solver.vmult(coarse_solution, coarse_rhs);
+  {
+    const double *xc = FVTools::local_values(coarse_solution);
+    double *x_values = dst.trilinos_vector()[0];
+    for (unsigned int i=0; i<n_owned; ++i)
+      x_values[i] += xc[aggregate[i] - coarse_start];
+  }
+
+  // post-smoothing
+  smooth(dst, src);
+  smooth(dst, src);
+}  // eom
+
+}  // end of namespace
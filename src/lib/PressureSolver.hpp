@@ -16,11 +16,21 @@
 #include <deal.II/lac/trilinos_sparse_matrix.h>
 #include <deal.II/lac/trilinos_solver.h>
 #include <deal.II/lac/trilinos_precondition.h>
+#include <deal.II/lac/solver_cg.h>
+#include <chrono>
+#include <memory>
 
 // Custom modules
 #include <Model.hpp>
 #include <CellValues/CellValuesBase.hpp>
 #include <ExtraFEData.hpp>
+#include <FVTools.hpp>
+#include <GhostExchange.hpp>
+#include <DeflatedCG.hpp>
+#include <DeflatedGMRES.hpp>
+#include <CellMultigrid.hpp>
+#include <DirectSolver.hpp>
+#include <PressureOperator.hpp>
 
 namespace FluidSolvers
 {
@@ -42,18 +52,80 @@ class PressureSolver
    * and allocate memory for solution vectors
    */
   void setup_dofs();
-  // Fill system matrix and rhs vector
-  void assemble_system(CellValues::CellValuesBase<dim>                  &cell_values,
-                       CellValues::CellValuesBase<dim>                  &neighbor_values,
+  /* Fill system matrix and rhs vector.
+   * If a pending ghost update of the saturations is given,
+   * it is completed after the interior cells are assembled.
+   * Rows of cells whose pressure and saturation, and those of their
+   * neighbors, changed less than the reassembly tolerances since the
+   * last evaluation are kept; only the old pressure term of their rhs
+   * is updated. All rows are evaluated every model.reassembly_interval
+   * calls, after setup_dofs, when the time step changes, and with
+   * mechanics; the rows of well cells always.
+   * If the wells are given, their productivities are evaluated in the
+   * same sweep (instead of Model::update_well_productivities); the rows
+   * of the well cells are then assembled after the sweep, once the well
+   * totals are summed over the processes
+   */
+  template <Model::ModelType type>
+  void assemble_system(CellValues::CellValuesBase<dim,type>             &cell_values,
+                       CellValues::CellValuesBase<dim,type>             &neighbor_values,
                        const double                                      time_step,
-                       const std::vector<TrilinosWrappers::MPI::Vector> &saturation);
-  // solve linear system syste_matrix*solution= rhs_vector
-  unsigned int solve();
+                       const std::vector<TrilinosWrappers::MPI::Vector> &saturation,
+                       Communication::GhostExchange                     *saturation_exchange = NULL,
+                       std::vector< Model::Wellbore<dim> >              *wells = NULL);
+  /* solve linear system syste_matrix*solution= rhs_vector,
+   * return the number of iterations (0 for the direct solver).
+   * The direct solver is used with the Direct pressure solver and for
+   * systems of at most model.direct_solver_size dofs (0 by default, so
+   * only if the input sets it), with either pressure operator.
+   * With reuse_preconditioner the preconditioner of the last solve
+   * is kept if the matrix has the same sparsity pattern (for the
+   * repeated solves within a time step)
+   */
+  unsigned int solve(const bool reuse_preconditioner = false);
+  /* iterations of a solve from the current solution in a scratch
+   * vector without the recycled deflation space, for the comparison
+   * with the warm start; solution and deflation space are not changed
+   */
+  unsigned int count_cold_iterations();
+
+ private:
+  // solve into dst, with the deflation space if deflate is set
+  unsigned int solve(TrilinosWrappers::MPI::Vector &dst,
+                     const bool                     reuse_preconditioner,
+                     const bool                     deflate);
+  // deflated CG or, for the nonsymmetric water-oil matrix, deflated GMRES
+  template <typename MatrixType, typename Preconditioner>
+  void solve_deflated(const MatrixType              &matrix,
+                      TrilinosWrappers::MPI::Vector &dst,
+                      const Preconditioner          &preconditioner,
+                      SolverControl                 &solver_control);
+  // copy the phase face terms of the last update_face_values
+  template <Model::ModelType type>
+  void store_face_values(const CellValues::CellValuesBase<dim,type> &values,
+                         const unsigned int                          face);
+  // flag the owned cells that contain well segments
+  void find_well_cells();
+  // cell entry and phase weights of a row of the matrix-free operator
+  template <Model::ModelType type>
+  void store_cell_values(const CellValues::CellValuesBase<dim,type> &values,
+                         const double                                cell_entry,
+                         const unsigned int                          position);
+
+ public:
   // accessing private members
   const TrilinosWrappers::SparseMatrix& get_system_matrix();
   const TrilinosWrappers::MPI::Vector&  get_rhs_vector();
   const DoFHandler<dim> &               get_dof_handler();
   const FE_DGQ<dim> &                   get_fe();
+  /* Faces with the phase transmissibilities and gravity terms
+   * of the last assembly, for the phase fluxes in the transport
+   */
+  const FVTools::FaceList &             get_faces() const;
+  // the operator of the last assembly with the matrix-free pressure
+  const PressureOperator &              get_operator() const;
+  // true if the system is the face list operator and has no matrix
+  bool                                  matrix_free() const;
 
  private:
   MPI_Comm                                  &mpi_communicator;
@@ -66,11 +138,59 @@ class PressureSolver
   // Matrices and vectors
   TrilinosWrappers::SparseMatrix            system_matrix;
   std::vector<IndexSet>                     owned_partitioning;
+  // locally owned cells: interior cells first, then subdomain boundary
+  std::vector<typename DoFHandler<dim>::active_cell_iterator> owned_cells;
+  unsigned int                              n_interior_cells;
+  std::unique_ptr< FVTools::ScratchData<dim> > scratch;
+  // dof indices of the cells and face neighbors in the loops
+  FVTools::LocalIndexMap                    index_map;
+  FVTools::FaceList                         faces;
+  // entries of the cells in the CSR arrays of system_matrix
+  FVTools::MatrixPositions                  matrix_positions;
+  /* keep their deflation spaces between the solves: CG for the
+   * symmetric single-phase matrix, GMRES for the water-oil one
+   */
+  LinearSolvers::DeflatedCG                 deflated_cg;
+  LinearSolvers::DeflatedGMRES              deflated_gmres;
+  // aggregates are kept until the mesh changes
+  LinearSolvers::CellMultigrid<dim>         multigrid;
+  // keeps the symbolic factorization until the matrix is reinitialized
+  LinearSolvers::DirectSolver               direct_solver;
+  // matrix-free pressure operator and its preconditioner
+  PressureOperator                          pressure_operator;
+  PressureOperatorPreconditioner            operator_preconditioner;
+  /* matrix-free pressure, unless the system is small enough for
+   * the direct solver, which needs the matrix (set in setup_dofs)
+   */
+  bool                                      matrix_free_system;
+  // AMG of the last solve; false after setup_dofs
+  TrilinosWrappers::PreconditionAMG         amg_preconditioner;
+  bool                                      preconditioner_ready;
+  /* incremental assembly: pressure and saturation of the last
+   * evaluation (relevant dofs), mass entry over dt and rhs without the
+   * old pressure term (owned cells), and assemblies since the last full one
+   */
+  std::vector<double>                       reference_pressure,
+                                            reference_saturation,
+                                            cell_mass_entry,
+                                            cell_rhs_entry;
+  std::vector<bool>                         well_cell;
+  // well cells whose rows wait for the well totals, and their saturations
+  std::vector<unsigned int>                 deferred_rows;
+  Vector<double>                            well_saturation;
+  // owned cell of an owned dof
+  std::vector<unsigned int>                 owned_cell;
+  unsigned int                              n_partial_assemblies;
+  double                                    assembled_time_step;
 
  public:
   TrilinosWrappers::MPI::Vector solution, old_solution, rhs_vector;
   TrilinosWrappers::MPI::Vector relevant_solution;
   IndexSet                      locally_owned_dofs, locally_relevant_dofs;
+  // if set, assembly time of each cell is added here (by active cell index)
+  std::vector<double>           *cell_costs;
+  // cell volumetric strains (current iterate and last time step) in coupled models
+  const TrilinosWrappers::MPI::Vector *volumetric_strain, *old_volumetric_strain;
 };
 
 
@@ -86,7 +206,18 @@ PressureSolver(MPI_Comm                                  &mpi_communicator_,
     dof_handler(triangulation_),
     fe(0), // since we want finite volumes
     model(model_),
-    pcout(pcout_)
+    pcout(pcout_),
+    n_interior_cells(0),
+    multigrid(mpi_communicator_),
+    pressure_operator(mpi_communicator_),
+    operator_preconditioner(mpi_communicator_),
+    matrix_free_system(false),
+    preconditioner_ready(false),
+    n_partial_assemblies(0),
+    assembled_time_step(0),
+    cell_costs(NULL),
+    volumetric_strain(NULL),
+    old_volumetric_strain(NULL)
 {}  // eom
 
 
@@ -104,17 +235,63 @@ void PressureSolver<dim>::setup_dofs()
   locally_owned_dofs.clear();
   locally_relevant_dofs.clear();
   locally_owned_dofs = dof_handler.locally_owned_dofs();
-  DoFTools::extract_locally_relevant_dofs(dof_handler,
-                                          locally_relevant_dofs);
+  // the TPFA stencil only needs the face neighbors as ghosts
+  FVTools::extract_face_relevant_dofs(dof_handler, locally_relevant_dofs);
+  n_interior_cells = FVTools::sort_subdomain_cells(dof_handler, owned_cells);
+  FVTools::build_local_index_map<dim>(owned_cells, locally_owned_dofs,
+                                      locally_relevant_dofs, index_map);
+  FVTools::build_face_list(index_map, locally_owned_dofs,
+                           model.n_phases(), faces);
+  scratch.reset(new FVTools::ScratchData<dim>(fe, model.n_phases()));
+  { // incremental assembly starts with a full one
+    const unsigned int n_cells = owned_cells.size();
+    reference_pressure.assign(locally_relevant_dofs.n_elements(), 0);
+    reference_saturation.assign(locally_relevant_dofs.n_elements(), 0);
+    cell_mass_entry.resize(n_cells);
+    cell_rhs_entry.resize(n_cells);
+    well_cell.assign(n_cells, false);
+    deferred_rows.reserve(n_cells);
+    well_saturation.reinit(model.n_phases());
+    owned_cell.resize(locally_owned_dofs.n_elements());
+    for (unsigned int k=0; k<n_cells; ++k)
+      owned_cell[index_map.cell_owned[k]] = k;
+    n_partial_assemblies = 0;
+  }
+  direct_solver.reinit(model.direct_solver_name);
+  deflated_cg.reinit(locally_owned_dofs, mpi_communicator,
+                     model.deflation_vectors, model.deflation_refresh);
+  deflated_gmres.reinit(locally_owned_dofs, mpi_communicator,
+                        model.deflation_vectors, model.deflation_refresh);
+  if (model.pressure_preconditioner_type == Model::PressurePreconditionerType::CellGMG)
+  {
+    multigrid.reinit(owned_cells, index_map.cell_dofs, locally_owned_dofs);
+    pcout << "Pressure multigrid levels " << multigrid.n_levels() << std::endl;
+  }
 
+  // the AMG refers to the old matrix
+  amg_preconditioner.clear();
+  preconditioner_ready = false;
+  system_matrix.clear();
+  matrix_free_system = (model.matrix_free_pressure &&
+                        model.pressure_solver_type != Model::PressureSolverType::Direct &&
+                        dof_handler.n_dofs() >
+                        static_cast<types::global_dof_index>(model.direct_solver_size));
+  if (matrix_free_system)
+  { // face list operator, no matrix
+    pressure_operator.reinit(index_map, faces, locally_owned_dofs,
+                             locally_relevant_dofs, model.n_phases());
+    operator_preconditioner.reinit(pressure_operator, locally_owned_dofs,
+                                   locally_relevant_dofs);
+  }
+  else
   { // system matrix
-    system_matrix.clear();
     TrilinosWrappers::SparsityPattern
         sparsity_pattern(locally_owned_dofs, mpi_communicator);
     DoFTools::make_flux_sparsity_pattern(dof_handler,
                                          sparsity_pattern);
     sparsity_pattern.compress();
     system_matrix.reinit(sparsity_pattern);
+    FVTools::build_matrix_positions(system_matrix, index_map, matrix_positions);
   }
   { // vectors
     solution.reinit(locally_owned_dofs, mpi_communicator);
@@ -128,86 +305,133 @@ void PressureSolver<dim>::setup_dofs()
 
 
 template <int dim>
+template <Model::ModelType type>
 void
 PressureSolver<dim>::
-assemble_system(CellValues::CellValuesBase<dim>                  &cell_values,
-                CellValues::CellValuesBase<dim>                  &neighbor_values,
+assemble_system(CellValues::CellValuesBase<dim,type>             &cell_values,
+                CellValues::CellValuesBase<dim,type>             &neighbor_values,
                 const double                                      time_step,
-                const std::vector<TrilinosWrappers::MPI::Vector> &saturation)
+                const std::vector<TrilinosWrappers::MPI::Vector> &saturation,
+                Communication::GhostExchange                     *saturation_exchange,
+                std::vector< Model::Wellbore<dim> >              *wells)
 {
-  // Only one integration point in FVM
-  QGauss<dim>       quadrature_formula(1);
-  QGauss<dim-1>     face_quadrature_formula(1);
-
-  FEValues<dim> fe_values(fe, quadrature_formula, update_values);
-  FEValues<dim> fe_values_neighbor(fe, quadrature_formula, update_values);
-
-  // the following two objects only get geometry data
-  FEFaceValues<dim> fe_face_values(fe, face_quadrature_formula,
-                                   update_normal_vectors);
-  // We need JxW flag for subfaces since there is no
-  // method to determine sub face area in triangulation class
-  FESubfaceValues<dim> fe_subface_values(fe, face_quadrature_formula,
-                                         update_normal_vectors |
-                                         update_JxW_values);
-
-  const unsigned int dofs_per_cell = fe.dofs_per_cell;
-  std::vector<types::global_dof_index>
-      dof_indices(dofs_per_cell),
-      dof_indices_neighbor(dofs_per_cell);
-
-  // objects to store local data
-  Tensor<1, dim>       normal;
-  std::vector<double>  p_values(quadrature_formula.size()),
-                       p_old_values(quadrature_formula.size());
-  std::vector< std::vector<double> >  s_values(model.n_phases()-1);
-  for (auto & c: s_values)
-    c.resize(face_quadrature_formula.size());
+  AssertThrow(scratch, ExcMessage("Call setup_dofs first"));
+  FEFaceValues<dim>    &fe_face_values = scratch->fe_face_values;
+  FESubfaceValues<dim> &fe_subface_values = scratch->fe_subface_values;
   // this one stores both saturation values and geomechanics
-  std::vector<double>  extra_values(model.n_phases() - 1);
+  std::vector<double>  &extra_values = scratch->extra_values;
+  AssertThrow(extra_values.size() == Model::ModelTraits<type>::n_phases - 1,
+              ExcDimensionMismatch(extra_values.size(),
+                                   Model::ModelTraits<type>::n_phases - 1));
+
+  /* One dof per cell: the cell values are read from the local arrays
+   * of the vectors (owned and ghost entries) at the positions
+   * cached in index_map. The ghost entries are written in place
+   * by the ghost exchange, so the pointers stay valid */
+  const double *p_values = FVTools::local_values(relevant_solution);
+  const double *p_old_values = FVTools::local_values(old_solution);
+  const double *s_values[Model::ModelTraits<type>::n_phases];
+  for (unsigned int c=0; c<Model::ModelTraits<type>::n_phases - 1; ++c)
+  {
+    AssertThrow(saturation[c].trilinos_vector().MyLength() ==
+                static_cast<int>(locally_relevant_dofs.n_elements()),
+                ExcMessage("Saturation is not a vector on the relevant dofs"));
+    s_values[c] = FVTools::local_values(saturation[c]);
+  }
+  const double *e_values = NULL, *e_old_values = NULL;
+  if (volumetric_strain != NULL)
+  {
+    e_values = FVTools::local_values(*volumetric_strain);
+    e_old_values = FVTools::local_values(*old_volumetric_strain);
+  }
 
+  Tensor<1, dim>       normal;
   const unsigned int q_point = 0;
 
-  typename DoFHandler<dim>::active_cell_iterator
-      cell = dof_handler.begin_active(),
-      endc = dof_handler.end();
+  const bool matrix_free = matrix_free_system;
 
-  system_matrix = 0;
+  // rows to evaluate: all of them, or those around changed cells
+  const bool incremental = (model.reassembly_interval > 1);
+  const bool full_assembly = (!incremental ||
+                              n_partial_assemblies == 0 ||
+                              time_step != assembled_time_step ||
+                              volumetric_strain != NULL);
+  const bool two_phase = (Model::ModelTraits<type>::n_phases > 1);
+  const auto changed = [&](const unsigned int position)
+  {
+    return (std::abs(p_values[position] - reference_pressure[position]) >
+            model.reassembly_pressure_tolerance ||
+            (two_phase &&
+             std::abs(s_values[0][position] - reference_saturation[position]) >
+             model.reassembly_saturation_tolerance));
+  };
+  if (full_assembly && (incremental || wells != NULL))
+    find_well_cells();
+
+  if (!matrix_free && full_assembly)
+    system_matrix = 0;
   rhs_vector = 0;
 
-  for (; cell!=endc; ++cell)
+  const auto assemble_row = [&](const unsigned int k)
   {
+    const auto & cell = owned_cells[k];
     if (cell->is_locally_owned())
     {
-      fe_values.reinit(cell);
-      fe_values.get_function_values(old_solution, p_old_values);
-      fe_values.get_function_values(relevant_solution, p_values);
-      for (unsigned int c=0; c<model.n_phases() - 1; ++c)
-      {
-        fe_values.get_function_values(saturation[c], s_values[c]);
-        extra_values[c] = s_values[c][q_point];
-      }
+      // timed only when the load balancer measures the costs
+      std::chrono::steady_clock::time_point cell_start;
+      if (cell_costs != NULL)
+        cell_start = std::chrono::steady_clock::now();
+      const unsigned int i = index_map.cell_dofs[k];
+      const unsigned int i_local = index_map.cell_relevant[k];
+      unsigned int n = index_map.neighbor_offsets[k];
+      for (unsigned int c=0; c<Model::ModelTraits<type>::n_phases - 1; ++c)
+        extra_values[c] = s_values[c][i_local];
 
       // std::cout << "cell: " << i << std::endl;
-      const double pressure_value = p_values[q_point];
-      const double pressure_value_old = p_old_values[q_point];
+      const double pressure_value = p_values[i_local];
+      const double pressure_value_old = p_old_values[i_local];
+
+      bool evaluate = full_assembly || well_cell[k] || changed(i_local);
+      for (unsigned int m=n; m<index_map.neighbor_offsets[k+1] && !evaluate; ++m)
+        evaluate = changed(index_map.neighbor_relevant[m]);
+      if (!evaluate)
+      { // the stored row is still valid
+        rhs_vector[i] += cell_mass_entry[k]*pressure_value_old + cell_rhs_entry[k];
+        return;
+      }
 
       cell_values.update(cell, pressure_value, extra_values);
       cell_values.update_wells(cell);
+      if (volumetric_strain != NULL)
+        cell_values.update_strain(e_values[index_map.cell_owned[k]],
+                                  e_old_values[index_map.cell_owned[k]]);
 
       // const double B_ii = cell_values.get_mass_matrix_entry();
       // double matrix_ii = B_ii/time_step + cell_values.get_J();
       // double rhs_i = B_ii/time_step*p_old + cell_values.get_Q();
       // double t_entry = 0;
       // new API
+      // the row is filled in place, see FVTools::MatrixPositions
+      double *row = matrix_free ? NULL : matrix_positions.rows[k];
+      if (!matrix_free && !full_assembly)
+      { // the row is rewritten
+        row[matrix_positions.diagonal[k]] = 0;
+        for (unsigned int m=n; m<index_map.neighbor_offsets[k+1]; ++m)
+          row[matrix_positions.neighbor[m]] = 0;
+      }
       double matrix_ii = cell_values.get_matrix_cell_entry(time_step);
+      if (matrix_free)
+        store_cell_values(cell_values, matrix_ii, index_map.cell_owned[k]);
       double rhs_i = cell_values.get_rhs_cell_entry(time_step,
                                                     pressure_value_old);
+      if (incremental)
+      { // the old pressure changes every step, the rest is kept
+        cell_mass_entry[k] = cell_values.get_mass_matrix_entry()/time_step;
+        cell_rhs_entry[k] = -cell_mass_entry[k]*pressure_value_old;
+      }
       // for debugging only
       // double face_entry = 0;
 
-      cell->get_dof_indices(dof_indices);
-      const unsigned int i = dof_indices[q_point];
       // std::cout << "ind " << i
       //           << "\tcell" <<cell->center()
       //           << "\tBii/time_step = " << B_ii/time_step
@@ -224,16 +448,16 @@ assemble_system(CellValues::CellValuesBase<dim>                  &cell_values,
              cell->neighbor_is_coarser(f))
           {
             const auto & neighbor = cell->neighbor(f);
-            fe_values.reinit(neighbor);
             fe_face_values.reinit(cell, f);
 
-            fe_values.get_function_values(relevant_solution, p_values);
-            for (unsigned int c=0; c<model.n_phases() - 1; ++c)
-            {
-              fe_values.get_function_values(saturation[c], s_values[c]);
-              extra_values[c] = s_values[c][q_point];
-            }
-            const double p_neighbor = p_values[q_point];
+            const unsigned int j_local = index_map.neighbor_relevant[n];
+            const unsigned int j_position = matrix_free ? 0 : matrix_positions.neighbor[n];
+            const unsigned int face = faces.neighbor_face[n];
+            const bool reversed = faces.neighbor_reversed[n];
+            ++n;
+            for (unsigned int c=0; c<Model::ModelTraits<type>::n_phases - 1; ++c)
+              extra_values[c] = s_values[c][j_local];
+            const double p_neighbor = p_values[j_local];
 
             normal = fe_face_values.normal_vector(q_point);
             const double dS = cell->face(f)->measure();  // face area
@@ -242,9 +466,16 @@ assemble_system(CellValues::CellValuesBase<dim>                  &cell_values,
             neighbor_values.update(neighbor, p_neighbor, extra_values);
             cell_values.update_face_values(neighbor_values, normal, dS);
 
+            // face terms for the transport, see FVTools::FaceList
+            if (face != numbers::invalid_unsigned_int && !reversed)
+              store_face_values(cell_values, face);
+            else if (face != numbers::invalid_unsigned_int)
+            {
+              neighbor_values.update_face_values(cell_values, -normal, dS);
+              store_face_values(neighbor_values, face);
+            }
+
             // distribute
-            neighbor->get_dof_indices(dof_indices_neighbor);
-            const unsigned int j = dof_indices_neighbor[q_point];
             // const double T_face = cell_values.get_T_face();
             // matrix_ii += T_face;
             // t_entry += T_face;
@@ -253,7 +484,8 @@ assemble_system(CellValues::CellValuesBase<dim>                  &cell_values,
             const double face_entry = cell_values.get_matrix_face_entry();
             matrix_ii += face_entry;
             rhs_i += cell_values.get_rhs_face_entry();
-            system_matrix.add(i, j, -face_entry);
+            if (!matrix_free)
+              row[j_position] -= face_entry;
           }
           else if ((cell->neighbor(f)->level() == cell->level()) &&
                    (cell->neighbor(f)->has_children() == true))
@@ -265,18 +497,18 @@ assemble_system(CellValues::CellValuesBase<dim>                  &cell_values,
               const auto & neighbor
                   = cell->neighbor_child_on_subface(f, subface);
 
-              fe_values.reinit(neighbor);
               fe_subface_values.reinit(cell, f, subface);
               // fe_face_values.reinit(cell, f);
 
-              fe_values.get_function_values(relevant_solution, p_values);
-              for (unsigned int c=0; c<model.n_phases() - 1; ++c)
-              {
-                fe_values.get_function_values(saturation[c], s_values[c]);
-                extra_values[c] = s_values[c][0];
-              }
+              const unsigned int j_local = index_map.neighbor_relevant[n];
+              const unsigned int j_position = matrix_free ? 0 : matrix_positions.neighbor[n];
+              const unsigned int face = faces.neighbor_face[n];
+              const bool reversed = faces.neighbor_reversed[n];
+              ++n;
+              for (unsigned int c=0; c<Model::ModelTraits<type>::n_phases - 1; ++c)
+                extra_values[c] = s_values[c][j_local];
 
-              const double p_neighbor = p_values[q_point];
+              const double p_neighbor = p_values[j_local];
               normal = fe_subface_values.normal_vector(q_point);
               const double dS = fe_subface_values.JxW(q_point);
 
@@ -285,9 +517,15 @@ assemble_system(CellValues::CellValuesBase<dim>                  &cell_values,
               // update face values
               cell_values.update_face_values(neighbor_values, normal, dS);
 
+              if (face != numbers::invalid_unsigned_int && !reversed)
+                store_face_values(cell_values, face);
+              else if (face != numbers::invalid_unsigned_int)
+              {
+                neighbor_values.update_face_values(cell_values, -normal, dS);
+                store_face_values(neighbor_values, face);
+              }
+
               // distribute
-              neighbor->get_dof_indices(dof_indices_neighbor);
-              const unsigned int j = dof_indices_neighbor[q_point];
               // const double T_face = cell_values.get_T_face();
               // matrix_ii += T_face;
               // t_entry += T_face;
@@ -296,15 +534,24 @@ assemble_system(CellValues::CellValuesBase<dim>                  &cell_values,
               const double face_entry = cell_values.get_matrix_face_entry();
               matrix_ii += face_entry;
               rhs_i += cell_values.get_rhs_face_entry();
-              system_matrix.add(i, j, -face_entry);
+              if (!matrix_free)
+                row[j_position] -= face_entry;
             }
           } // end case neighbor is finer
 
         } // end if face not at boundary
       }  // end face loop
 
-      system_matrix.add(i, i, matrix_ii);
+      if (!matrix_free)
+        row[matrix_positions.diagonal[k]] += matrix_ii;
       rhs_vector[i] += rhs_i;
+      if (incremental)
+        cell_rhs_entry[k] += rhs_i;
+
+      if (cell_costs != NULL)
+        (*cell_costs)[cell->active_cell_index()] +=
+            std::chrono::duration<double>
+            (std::chrono::steady_clock::now() - cell_start).count();
 
       // pcout << "i = " << i << std::endl;
       // if (i == 0)
@@ -340,36 +587,247 @@ assemble_system(CellValues::CellValuesBase<dim>                  &cell_values,
 
       // std::cout << "------------------------------\n";
     } // end local cells
+  };  // end assemble_row
+
+  deferred_rows.clear();
+  for (unsigned int k=0; k<owned_cells.size(); ++k)
+  {
+    // boundary cells need the ghost values
+    if (k == n_interior_cells && saturation_exchange != NULL &&
+        saturation_exchange->in_progress())
+      saturation_exchange->finish();
+
+    if (wells != NULL && well_cell[k])
+    { // productivities now, the row when the well totals are known
+      const unsigned int i_local = index_map.cell_relevant[k];
+      if (two_phase)
+      {
+        well_saturation[0] = s_values[0][i_local];
+        well_saturation[1] = 1.0 - s_values[0][i_local];
+      }
+      for (auto & well : *wells)
+        well.update_cell_productivity(owned_cells[k], p_values[i_local],
+                                      well_saturation);
+      deferred_rows.push_back(k);
+      continue;
+    }
+    assemble_row(k);
   } // end cells loop
-  system_matrix.compress(VectorOperation::add);
+
+  // no boundary cells on this process
+  if (saturation_exchange != NULL && saturation_exchange->in_progress())
+    saturation_exchange->finish();
+
+  if (wells != NULL)
+  { // the rows of the well cells
+    for (auto & well : *wells)
+      well.sum_productivities();
+    for (const auto k : deferred_rows)
+      assemble_row(k);
+  }
+
+  if (incremental)
+  { // values of the evaluation for the cells that changed
+    for (unsigned int position=0; position<reference_pressure.size(); ++position)
+      if (full_assembly || changed(position))
+      {
+        reference_pressure[position] = p_values[position];
+        if (two_phase)
+          reference_saturation[position] = s_values[0][position];
+      }
+    assembled_time_step = time_step;
+    n_partial_assemblies = (n_partial_assemblies + 1) % model.reassembly_interval;
+  }
+
+  /* Rows are assembled by their owners, so the compress
+   * only synchronizes and exchanges no matrix entries */
+  if (!matrix_free)
+    system_matrix.compress(VectorOperation::add);
   rhs_vector.compress(VectorOperation::add);
 } // eom
 
 
+template <int dim>
+template <Model::ModelType type>
+inline
+void
+PressureSolver<dim>::
+store_face_values(const CellValues::CellValuesBase<dim,type> &values,
+                  const unsigned int                          face)
+{
+  typedef Model::ModelTraits<type> Traits;
+  unsigned int phase = 0;
+  if (Traits::has_water)
+  {
+    faces.transmissibility[phase][face] = values.T_w_face;
+    faces.gravity[phase][face] = values.G_w_face;
+    faces.unit_transmissibility[phase][face] = values.T_w_unit_face;
+    faces.unit_gravity[phase][face] = values.G_w_unit_face;
+    phase++;
+  }
+  if (Traits::has_oil)
+  {
+    faces.transmissibility[phase][face] = values.T_o_face;
+    faces.gravity[phase][face] = values.G_o_face;
+    faces.unit_transmissibility[phase][face] = values.T_o_unit_face;
+    faces.unit_gravity[phase][face] = values.G_o_unit_face;
+    phase++;
+  }
+  if (Traits::has_gas)
+  {
+    faces.transmissibility[phase][face] = values.T_g_face;
+    faces.gravity[phase][face] = values.G_g_face;
+  }
+} // eom
+
+
+
+template <int dim>
+void
+PressureSolver<dim>::find_well_cells()
+{
+  std::fill(well_cell.begin(), well_cell.end(), false);
+  std::vector<types::global_dof_index> dof_indices(fe.dofs_per_cell);
+  for (const auto & well : model.wells)
+    for (const auto & cell : well.get_cells())
+      if (cell->is_locally_owned())
+      {
+        cell->get_dof_indices(dof_indices);
+        well_cell[owned_cell[locally_owned_dofs.index_within_set(dof_indices[0])]] = true;
+      }
+}  // eom
+
+
+
+template <int dim>
+template <Model::ModelType type>
+inline
+void
+PressureSolver<dim>::
+store_cell_values(const CellValues::CellValuesBase<dim,type> &values,
+                  const double                                cell_entry,
+                  const unsigned int                          position)
+{
+  pressure_operator.cell_entries[position] = cell_entry;
+  if (type == Model::ModelType::SingleLiquid)
+    pressure_operator.phase_weights[0][position] = 1;
+  else if (type == Model::ModelType::WaterOil)
+  {
+    // see CellValuesBase::get_matrix_face_entry
+    pressure_operator.phase_weights[0][position] = values.c2o/values.c1w;
+    pressure_operator.phase_weights[1][position] = 1;
+  }
+  else
+    AssertThrow(false, ExcNotImplemented());
+} // eom
+
+
+
+template <int dim>
+unsigned int
+PressureSolver<dim>::solve(const bool reuse_preconditioner)
+{
+  return solve(solution, reuse_preconditioner,
+               model.pressure_solver_type == Model::PressureSolverType::DeflatedAMGCG);
+}  // eom
+
+
+
+template <int dim>
+template <typename MatrixType, typename Preconditioner>
+void
+PressureSolver<dim>::solve_deflated(const MatrixType              &matrix,
+                                    TrilinosWrappers::MPI::Vector &dst,
+                                    const Preconditioner          &preconditioner,
+                                    SolverControl                 &solver_control)
+{
+  if (model.fluid_model_type() == Model::ModelType::SingleLiquid)
+    deflated_cg.solve(matrix, dst, rhs_vector, preconditioner, solver_control);
+  else
+    deflated_gmres.solve(matrix, dst, rhs_vector, preconditioner, solver_control);
+}  // eom
+
+
+
+template <int dim>
+unsigned int
+PressureSolver<dim>::count_cold_iterations()
+{
+  TrilinosWrappers::MPI::Vector cold_solution(solution);
+  return solve(cold_solution, /* reuse_preconditioner = */ false,
+               /* deflate = */ false);
+}  // eom
+
+
+
 template <int dim>
 unsigned int
-PressureSolver<dim>::solve()
+PressureSolver<dim>::solve(TrilinosWrappers::MPI::Vector &dst,
+                           const bool                     reuse_preconditioner,
+                           const bool                     deflate)
 {
   double tol = 1e-10*rhs_vector.l2_norm();
   if (tol == 0.0)
     tol = 1e-10;
   SolverControl solver_control(1000, tol);
+  const bool setup_preconditioner = !(reuse_preconditioner && preconditioner_ready);
 
+  // small systems: direct solve, no iterations
+  if (model.pressure_solver_type == Model::PressureSolverType::Direct ||
+      dof_handler.n_dofs() <= static_cast<types::global_dof_index>(model.direct_solver_size))
+  {
+    direct_solver.solve(system_matrix, dst, rhs_vector);
+    return 0;
+  }
+
+  if (matrix_free_system)
+  { // iterative solver with the face list operator
+    if (setup_preconditioner)
+      operator_preconditioner.initialize(pressure_operator);
+    preconditioner_ready = true;
+    if (deflate)
+      solve_deflated(pressure_operator, dst, operator_preconditioner, solver_control);
+    else
+    {
+      SolverCG<TrilinosWrappers::MPI::Vector> solver(solver_control);
+      solver.solve(pressure_operator, dst, rhs_vector,
+                   operator_preconditioner);
+    }
+    return solver_control.last_step();
+  }
+
+  if (model.pressure_preconditioner_type == Model::PressurePreconditionerType::CellGMG)
+  { // iterative solver with geometric multigrid
+    if (setup_preconditioner)
+      multigrid.initialize(system_matrix);
+    preconditioner_ready = true;
+    if (deflate)
+      solve_deflated(system_matrix, dst, multigrid, solver_control);
+    else
+    {
+      SolverCG<TrilinosWrappers::MPI::Vector> solver(solver_control);
+      solver.solve(system_matrix, dst, rhs_vector, multigrid);
+    }
+  }
+  else
   { // iterative solver
-    TrilinosWrappers::SolverCG::AdditionalData additional_data_cg;
-    TrilinosWrappers::SolverCG
-        solver(solver_control, additional_data_cg);
-    TrilinosWrappers::PreconditionAMG::AdditionalData additional_data_amg;
-    TrilinosWrappers::PreconditionAMG preconditioner;
-    preconditioner.initialize(system_matrix, additional_data_amg);
-    solver.solve(system_matrix, solution, rhs_vector, preconditioner);
+    if (setup_preconditioner)
+    {
+      TrilinosWrappers::PreconditionAMG::AdditionalData additional_data_amg;
+      amg_preconditioner.initialize(system_matrix, additional_data_amg);
+    }
+    preconditioner_ready = true;
+    if (deflate)
+      solve_deflated(system_matrix, dst, amg_preconditioner, solver_control);
+    else
+    {
+      TrilinosWrappers::SolverCG::AdditionalData additional_data_cg;
+      TrilinosWrappers::SolverCG
+          solver(solver_control, additional_data_cg);
+      solver.solve(system_matrix, dst, rhs_vector, amg_preconditioner);
+    }
   }
 
-  // { // direct solver
-  //   TrilinosWrappers::SolverDirect
-  //       solver(solver_control, TrilinosWrappers::SolverDirect::AdditionalData());
-  //   solver.solve(system_matrix, solution, rhs_vector);
-  // }
   return solver_control.last_step();
 } // eom
 
@@ -407,4 +865,34 @@ PressureSolver<dim>::get_fe()
 {
   return fe;
 }  // eom
+
+
+template <int dim>
+inline
+const FVTools::FaceList &
+PressureSolver<dim>::get_faces() const
+{
+  return faces;
+}  // eom
+
+
+
+template <int dim>
+inline
+const PressureOperator &
+PressureSolver<dim>::get_operator() const
+{
+  return pressure_operator;
+}  // eom
+
+
+
+template <int dim>
+inline
+bool
+PressureSolver<dim>::matrix_free() const
+{
+  return matrix_free_system;
+}  // eom
+
 }  // end of namespace
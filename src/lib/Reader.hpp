@@ -82,17 +82,6 @@ namespace Parsers {
       std::cout << input_text << std::endl;
     // Keywords::Keywords kwds;
     SyntaxParser parser(input_text);
-    { // Mesh
-      parser.enter_subsection(Keywords::section_mesh);
-      model.initial_refinement_level =
-        parser.get_int(Keywords::global_refinement_steps, 0);
-      model.n_adaptive_steps =
-        parser.get_int(Keywords::adaptive_refinement_steps, 0);
-      model.mesh_file =
-        boost::filesystem::path(fname).parent_path() /
-        parser.get(Keywords::mesh_file);
-      // std::cout << model.mesh_file << std::endl;
-    }
     {  // equation data
       parser.enter_subsection(Keywords::section_equation_data);
       std::string model_type_str = parser.get(Keywords::model_type);
@@ -103,6 +92,10 @@ namespace Parsers {
         model_type = Model::ModelType::SingleLiquid;
       else if (model_type_str == Keywords::model_water_oil)
         model_type = Model::ModelType::WaterOil;
+      else if (model_type_str == Keywords::model_single_liquid_elasticity)
+        model_type = Model::ModelType::SingleLiquidElasticity;
+      else if (model_type_str == Keywords::model_water_oil_elasticity)
+        model_type = Model::ModelType::WaterOilElasticity;
       // else if (model_type_str == Keywords::model_single_gas)
       //   model_type = Model::ModelType::SingleGas;
       // else if (model_type_str == Keywords::model_water_gas)
@@ -138,6 +131,20 @@ namespace Parsers {
           get_function(Keywords::porosity, no_anisotropy, parser);
       }
 
+      if (model.has_mechanics())
+      { // elastic properties
+        const int dim = 3;
+        std::vector<double> no_anisotropy_vector{1,1,1};
+        Tensor<1,dim> no_anisotropy = Parsers::convert<dim>(no_anisotropy_vector);
+        model.get_young_modulus =
+          get_function(Keywords::young_modulus,
+                       no_anisotropy*model.units.stiffness(), parser);
+        model.get_poisson_ratio =
+          get_function(Keywords::poisson_ratio, no_anisotropy, parser);
+        model.biot_coefficient =
+            parser.get_double(Keywords::biot_coefficient, 1.0);
+      }
+
       if (model.has_phase(Model::Phase::Water))
       {
         auto tmp = parser.get_matrix(Keywords::pvt_water, ";", ",");
@@ -180,7 +187,7 @@ namespace Parsers {
         model.set_density_sc_o(rho_o);
       }  // end two-phase case
 
-      if (model.type == Model::WaterOil)
+      if (model.fluid_model_type() == Model::WaterOil)
       {
         // Relative permeability
         const auto & rel_perm_water =
@@ -196,9 +203,90 @@ namespace Parsers {
                            rel_perm_water[2], rel_perm_oil[2]);
       }
 
-
     } // end equation data
 
+    { // Mesh (after equation data since the regions need units)
+      parser.enter_subsection(Keywords::section_mesh);
+      model.initial_refinement_level =
+        parser.get_int(Keywords::global_refinement_steps, 0);
+      model.n_adaptive_steps =
+        parser.get_int(Keywords::adaptive_refinement_steps, 0);
+      model.mesh_file =
+        boost::filesystem::path(fname).parent_path() /
+        parser.get(Keywords::mesh_file);
+      // std::cout << model.mesh_file << std::endl;
+      const int dim = 3;
+      const double length = model.units.length();
+
+      { // boxes: xmin, xmax, ymin, ymax, zmin, zmax; ...
+        std::vector<double> no_boxes;
+        const auto boxes =
+            parser.get_double_list(Keywords::local_refinement_regions, ",;",
+                                   no_boxes);
+        AssertThrow(boxes.size() % (2*dim) == 0,
+                    ExcMessage("Wrong entry in " + Keywords::local_refinement_regions));
+        model.local_prerefinement_region.clear();
+        for (unsigned int i=0; i<boxes.size(); i+=2)
+          model.local_prerefinement_region.push_back
+              (std::make_pair(boxes[i]*length, boxes[i+1]*length));
+        model.n_box_refinement_levels =
+          parser.get_int(Keywords::box_refinement_steps, 0);
+      }
+      { // n_levels, radius
+        std::vector<double> no_refinement = {0, 0};
+        const auto entry =
+            parser.get_double_list(Keywords::well_refinement, ",",
+                                   no_refinement);
+        AssertThrow(entry.size() == 2,
+                    ExcMessage("Wrong entry in " + Keywords::well_refinement));
+        model.n_well_refinement_levels = static_cast<int>(entry[0]);
+        model.well_refinement_radius = entry[1]*length;
+      }
+      { // contact depth, n_levels, thickness
+        // the depth is compared with the z coordinate of the cell
+        // centers (center[2]), so it is an elevation in the mesh frame
+        std::vector<double> no_refinement = {0, 0, 0};
+        const auto entry =
+            parser.get_double_list(Keywords::contact_refinement, ",",
+                                   no_refinement);
+        AssertThrow(entry.size() == 3,
+                    ExcMessage("Wrong entry in " + Keywords::contact_refinement));
+        model.contact_depth = entry[0]*length;
+        model.n_contact_refinement_levels = static_cast<int>(entry[1]);
+        model.contact_refinement_thickness = entry[2]*length;
+      }
+      { // load balancing
+        const std::string type_str =
+            parser.get(Keywords::load_balancing, Keywords::load_balancing_none);
+        auto & config = model.load_balancing;
+        if (boost::trim_copy(type_str) == Keywords::load_balancing_none)
+          config.type = Model::LoadBalancingType::NoBalancing;
+        else if (boost::trim_copy(type_str) == Keywords::load_balancing_model)
+          config.type = Model::LoadBalancingType::ModelBalancing;
+        else if (boost::trim_copy(type_str) == Keywords::load_balancing_measured)
+          config.type = Model::LoadBalancingType::MeasuredBalancing;
+        else
+          AssertThrow(false, ExcMessage("Wrong entry in " + Keywords::load_balancing));
+
+        std::vector<double> default_weights = {config.well_cell_weight,
+                                               config.hanging_face_weight};
+        const auto weights =
+            parser.get_double_list(Keywords::cell_weights, ",", default_weights);
+        config.well_cell_weight = weights[0];
+        config.hanging_face_weight = weights[1];
+        config.imbalance_threshold =
+            parser.get_double(Keywords::imbalance_threshold,
+                              config.imbalance_threshold);
+        const int window = parser.get_int(Keywords::balancing_window,
+                                          config.balancing_window);
+        AssertThrow(window > 0,
+                    ExcMessage("Wrong entry in " + Keywords::balancing_window));
+        config.balancing_window = window;
+        config.group_well_cells =
+            (parser.get_int(Keywords::group_well_cells, 0) != 0);
+      }
+    }
+
     {  // wells
       parser.enter_subsection(Keywords::section_wells);
       assign_wells(Keywords::well_parameters, parser);
@@ -212,6 +300,168 @@ namespace Parsers {
       model.t_max =
           parser.get_double(Keywords::t_max) *
           model.units.time();
+      // fixed-stress split
+      model.fss_tolerance =
+          parser.get_double(Keywords::fss_tolerance, model.fss_tolerance);
+      model.max_fss_steps =
+          parser.get_int(Keywords::max_fss_steps, model.max_fss_steps);
+      // sequential implicit loop
+      model.sfi_tolerance =
+          parser.get_double(Keywords::sfi_tolerance, model.sfi_tolerance);
+      model.sfi_saturation_tolerance =
+          parser.get_double(Keywords::sfi_saturation_tolerance,
+                            model.sfi_saturation_tolerance);
+      model.max_sfi_steps =
+          parser.get_int(Keywords::max_sfi_steps, model.max_sfi_steps);
+      AssertThrow(model.max_sfi_steps >= 0,
+                  ExcMessage("Wrong entry in " + Keywords::max_sfi_steps));
+      AssertThrow(model.max_sfi_steps == 0 || !model.has_mechanics(),
+                  ExcMessage(Keywords::max_sfi_steps +
+                             " cannot be used with mechanics (see FSS)"));
+      AssertThrow(model.max_sfi_steps == 0 || model.n_phases() > 1,
+                  ExcMessage(Keywords::max_sfi_steps +
+                             " needs a saturation equation"));
+      // elasticity
+      const std::string elastic_solver_str =
+          parser.get(Keywords::elastic_solver, Keywords::elastic_solver_amg);
+      if (boost::trim_copy(elastic_solver_str) == Keywords::elastic_solver_amg)
+        model.elastic_solver_type = Model::ElasticSolverType::AssembledAMG;
+      else if (boost::trim_copy(elastic_solver_str) ==
+               Keywords::elastic_solver_matrix_free)
+        model.elastic_solver_type = Model::ElasticSolverType::MatrixFreeGMG;
+      else
+        AssertThrow(false, ExcMessage("Wrong entry in " + Keywords::elastic_solver));
+      // pressure
+      const std::string pressure_solver_str =
+          parser.get(Keywords::pressure_solver, Keywords::pressure_solver_cg);
+      if (boost::trim_copy(pressure_solver_str) == Keywords::pressure_solver_cg)
+        model.pressure_solver_type = Model::PressureSolverType::AMGCG;
+      else if (boost::trim_copy(pressure_solver_str) ==
+               Keywords::pressure_solver_deflated_cg)
+        model.pressure_solver_type = Model::PressureSolverType::DeflatedAMGCG;
+      else if (boost::trim_copy(pressure_solver_str) ==
+               Keywords::pressure_solver_direct)
+        model.pressure_solver_type = Model::PressureSolverType::Direct;
+      else
+        AssertThrow(false, ExcMessage("Wrong entry in " + Keywords::pressure_solver));
+      const std::string pressure_preconditioner_str =
+          parser.get(Keywords::pressure_preconditioner,
+                     Keywords::pressure_preconditioner_amg);
+      if (boost::trim_copy(pressure_preconditioner_str) ==
+          Keywords::pressure_preconditioner_amg)
+        model.pressure_preconditioner_type = Model::PressurePreconditionerType::AMG;
+      else if (boost::trim_copy(pressure_preconditioner_str) ==
+               Keywords::pressure_preconditioner_gmg)
+        model.pressure_preconditioner_type = Model::PressurePreconditionerType::CellGMG;
+      else
+        AssertThrow(false, ExcMessage("Wrong entry in " +
+                                      Keywords::pressure_preconditioner));
+      const std::string direct_solver_str =
+          boost::trim_copy(parser.get(Keywords::direct_solver,
+                                      Keywords::direct_solver_klu));
+      if (direct_solver_str == Keywords::direct_solver_klu)
+        model.direct_solver_name = "Amesos_Klu";
+      else if (direct_solver_str == Keywords::direct_solver_mumps)
+        model.direct_solver_name = "Amesos_Mumps";
+      else if (direct_solver_str == Keywords::direct_solver_superlu_dist)
+        model.direct_solver_name = "Amesos_Superludist";
+      else
+        AssertThrow(false, ExcMessage("Wrong entry in " + Keywords::direct_solver));
+      model.direct_solver_size =
+          parser.get_int(Keywords::direct_solver_size, model.direct_solver_size);
+      AssertThrow(model.direct_solver_size >= 0,
+                  ExcMessage("Wrong entry in " + Keywords::direct_solver_size));
+      const std::string pressure_operator_str =
+          boost::trim_copy(parser.get(Keywords::pressure_operator,
+                                      Keywords::pressure_operator_matrix));
+      if (pressure_operator_str == Keywords::pressure_operator_matrix)
+        model.matrix_free_pressure = false;
+      else if (pressure_operator_str == Keywords::pressure_operator_matrix_free)
+        model.matrix_free_pressure = true;
+      else
+        AssertThrow(false, ExcMessage("Wrong entry in " + Keywords::pressure_operator));
+      AssertThrow(!model.matrix_free_pressure ||
+                  (model.pressure_solver_type != Model::PressureSolverType::Direct &&
+                   model.pressure_preconditioner_type ==
+                   Model::PressurePreconditionerType::AMG),
+                  ExcMessage("The matrix-free pressure operator works only "
+                             "with CG or DeflatedCG and its own preconditioner"));
+      // incremental pressure assembly
+      model.reassembly_pressure_tolerance =
+          parser.get_double(Keywords::reassembly_pressure_tolerance, 0) *
+          model.units.pressure();
+      model.reassembly_saturation_tolerance =
+          parser.get_double(Keywords::reassembly_saturation_tolerance,
+                            model.reassembly_saturation_tolerance);
+      model.reassembly_interval =
+          parser.get_int(Keywords::reassembly_interval, model.reassembly_interval);
+      AssertThrow(model.reassembly_interval >= 1,
+                  ExcMessage("Wrong entry in " + Keywords::reassembly_interval));
+      AssertThrow(model.reassembly_pressure_tolerance >= 0 &&
+                  model.reassembly_saturation_tolerance >= 0,
+                  ExcMessage("Wrong entry in reassembly tolerances"));
+      // saturation
+      const std::string saturation_solver_str =
+          boost::trim_copy(parser.get(Keywords::saturation_solver,
+                                      Keywords::saturation_solver_explicit));
+      if (saturation_solver_str == Keywords::saturation_solver_explicit)
+        model.saturation_solver_type = Model::SaturationSolverType::Explicit;
+      else if (saturation_solver_str == Keywords::saturation_solver_reordering)
+        model.saturation_solver_type = Model::SaturationSolverType::Reordering;
+      else if (saturation_solver_str == Keywords::saturation_solver_adaptive)
+        model.saturation_solver_type = Model::SaturationSolverType::Adaptive;
+      else if (saturation_solver_str == Keywords::saturation_solver_lts)
+        model.saturation_solver_type = Model::SaturationSolverType::LocalTimeStepping;
+      else
+        AssertThrow(false, ExcMessage("Wrong entry in " + Keywords::saturation_solver));
+      model.implicit_cfl =
+          parser.get_double(Keywords::implicit_cfl, model.implicit_cfl);
+      AssertThrow(model.implicit_cfl > 0,
+                  ExcMessage("Wrong entry in " + Keywords::implicit_cfl));
+      model.lts_cfl = parser.get_double(Keywords::lts_cfl, model.lts_cfl);
+      AssertThrow(model.lts_cfl > 0,
+                  ExcMessage("Wrong entry in " + Keywords::lts_cfl));
+      model.time_step_levels =
+          parser.get_int(Keywords::time_step_levels, model.time_step_levels);
+      AssertThrow(model.time_step_levels >= 1 && model.time_step_levels <= 16,
+                  ExcMessage("Wrong entry in " + Keywords::time_step_levels));
+      model.deflation_vectors =
+          parser.get_int(Keywords::deflation_vectors, model.deflation_vectors);
+      AssertThrow(model.deflation_vectors >= 0,
+                  ExcMessage("Wrong entry in " + Keywords::deflation_vectors));
+      model.deflation_refresh =
+          parser.get_int(Keywords::deflation_refresh, model.deflation_refresh);
+      AssertThrow(model.deflation_refresh >= 1,
+                  ExcMessage("Wrong entry in " + Keywords::deflation_refresh));
+      model.displacement_degree =
+          parser.get_int(Keywords::displacement_degree, model.displacement_degree);
+      AssertThrow(model.displacement_degree >= 1,
+                  ExcMessage("Wrong entry in " + Keywords::displacement_degree));
+      model.mechanics_level =
+          parser.get_int(Keywords::mechanics_level, model.mechanics_level);
+      // multirate coupling
+      model.mechanics_interval =
+          parser.get_int(Keywords::mechanics_interval, model.mechanics_interval);
+      AssertThrow(model.mechanics_interval >= 1,
+                  ExcMessage("Wrong entry in " + Keywords::mechanics_interval));
+      model.mechanics_pressure_change =
+          parser.get_double(Keywords::mechanics_pressure_change, 0) *
+          model.units.pressure();
+      model.mechanics_lag_tolerance =
+          parser.get_double(Keywords::mechanics_lag_tolerance,
+                            model.mechanics_lag_tolerance);
+      // initial guess of the pressure solves
+      model.pressure_guess_order =
+          parser.get_int(Keywords::pressure_guess_order, model.pressure_guess_order);
+      AssertThrow(model.pressure_guess_order >= 0 &&
+                  model.pressure_guess_order <= 2,
+                  ExcMessage("Wrong entry in " + Keywords::pressure_guess_order));
+      model.pressure_pod_basis =
+          parser.get_int(Keywords::pressure_pod_basis, model.pressure_pod_basis);
+      AssertThrow(model.pressure_pod_basis >= 0,
+                  ExcMessage("Wrong entry in " + Keywords::pressure_pod_basis));
+      model.compare_pressure_guess =
+          (parser.get_int(Keywords::compare_pressure_guess, 0) != 0);
     }
   } // eom
 
@@ -338,13 +588,13 @@ namespace Parsers {
         schedule_entry.control.value *= model.units.pressure();
       }
 
-      if (   model.type == Model::WaterOil
-          || model.type == Model::SingleLiquid)
+      if (   model.fluid_model_type() == Model::WaterOil
+          || model.fluid_model_type() == Model::SingleLiquid)
       {
         if (schedule_entry.control.type != Schedule::pressure_control)
           schedule_entry.control.value *= model.units.fluid_rate();  //
       }
-      else if (model.type == Model::Blackoil)
+      else if (model.fluid_model_type() == Model::Blackoil)
       {
         if (schedule_entry.control.type == Schedule::flow_control_total
             || schedule_entry.control.type == Schedule::flow_control_phase_1
@@ -0,0 +1,710 @@
+#pragma once
+
+#include <deal.II/base/exceptions.h>
+#include <deal.II/lac/vector.h>
+#include <FVTools.hpp>
+#include <Model.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace FluidSolvers
+{
+using namespace dealii;
+
+
+/*
+ * Implicit water saturation update of the IMPES step by reordering
+ * (Natvig and Lie, JCP 227, 2008; Kwok and Tchelepi, JCP 227, 2007).
+ * The total face fluxes u_t are fixed by the pressure solution, and the
+ * water flux of a face is
+ *   F_w = lambda_w/(lambda_w + lambda_o) * (u_t + lambda_o*(gamma_o - gamma_w)),
+ * with the mobility of each phase taken from its upstream cell and
+ * gamma the gravity term of a phase per unit mobility.
+ * With single-point upstream weighting and no capillary pressure the
+ * implicit system is then triangular once the cells are sorted along
+ * the upstream directions: each cell is a scalar equation for Sw that
+ * is solved with Newton's method safeguarded by bisection.
+ * Counter-current flow under gravity makes two cells upstream of each
+ * other; these cycles are the strongly connected components of the
+ * upstream graph (Tarjan's algorithm), solved by nonlinear
+ * Gauss-Seidel sweeps over their cells.
+ * The ordering is local to the process. A face to a ghost cell carries
+ * one water flux of the old saturations, which the process on the other
+ * side computes the same way, so mass is conserved across subdomains.
+ * In the adaptive implicit mode only the cells whose CFL number
+ * exceeds a limit are implicit; the other cells are updated
+ * explicitly, with the fluxes from their upstream cells at the new
+ * (implicit) or old (explicit) saturation, so mass is conserved.
+ * The same fluxes drive the explicit update with local time steps
+ * (solve_local_steps).
+ */
+template <int dim>
+class ReorderedTransport
+{
+ public:
+  ReorderedTransport(const Model::Model<dim> &model_);
+  // faces of the owned cells; call when the mesh changes
+  void reinit(const FVTools::LocalIndexMap &index_map,
+              const FVTools::FaceList      &faces,
+              const unsigned int            n_relevant_dofs);
+  /*
+   * Water saturation at the end of the step.
+   * old_saturation holds the values on the relevant dofs,
+   * cell_increment and cell_mass the explicit cell terms and the water
+   * mass coefficients of the owned cells (see SaturationSolver).
+   * Cells with a CFL number up to implicit_cfl are explicit
+   * (0 - all cells are implicit)
+   */
+  void solve(const FVTools::FaceList   &faces,
+             const double               time_step,
+             const double              *pressure,
+             const double              *old_saturation,
+             const std::vector<double> &cell_increment,
+             const std::vector<double> &cell_mass,
+             const double               implicit_cfl = 0);
+  /*
+   * Explicit water saturation at the end of the step with local time
+   * steps: a cell of level l makes 2^l steps of dt/2^l, with the
+   * smallest level that brings its CFL number below cfl_limit.
+   * A face is evaluated at the finer level of its two cells and its
+   * fluxes are summed until the coarser cell completes its step, so
+   * both cells see the same flux integral. Returns the number of levels
+   */
+  unsigned int solve_local_steps(const FVTools::FaceList   &faces,
+                                 const double               time_step,
+                                 const double              *pressure,
+                                 const double              *old_saturation,
+                                 const std::vector<double> &cell_increment,
+                                 const std::vector<double> &cell_mass,
+                                 const double               cfl_limit,
+                                 const unsigned int         max_levels);
+  // new saturation on the relevant dofs (ghosts are not updated)
+  const std::vector<double> & get_saturation() const;
+  // number of owned cells solved implicitly in the last step
+  unsigned int n_implicit_cells() const;
+
+ private:
+  void relative_permeability(const double  Sw,
+                             double       &k_rw,
+                             double       &k_ro);
+  // water flux from the first to the second cell of a face
+  double water_flux(const unsigned int face,
+                    const double       Sw_first,
+                    const double       Sw_second);
+  // residual of the mass balance of owned cell k at saturation Sw
+  double residual(const unsigned int k,
+                  const double       Sw);
+  // solve the equation of cell k with fixed neighbors, returns the change
+  double solve_cell(const unsigned int k);
+  // throughput of cell k: derivative of its water outflow times dt/mass
+  double cfl_number(const unsigned int k);
+  // fixed face data and the cells that can be upstream
+  void setup_faces(const FVTools::FaceList &faces,
+                   const double            *pressure);
+  // data of the step shared by the implicit and explicit updates
+  void setup_step(const FVTools::FaceList   &faces,
+                  const double               time_step,
+                  const double              *pressure,
+                  const double              *old_saturation,
+                  const std::vector<double> &cell_increment,
+                  const std::vector<double> &cell_mass);
+  // strongly connected components, downstream components first
+  void find_components();
+
+  const Model::Model<dim>    &model;
+  Vector<double>              phase_saturation;
+  std::vector<double>         phase_permeability;
+  double                      Sw_min, Sw_max;
+  // owned cells
+  std::vector<unsigned int>   cell_relevant;
+  std::vector<double>         cell_rhs, cell_factor, explicit_saturation;
+  std::vector<bool>           implicit;
+  unsigned int                n_implicit;
+  // interior faces of cell k are in [cell_face_offsets[k], cell_face_offsets[k+1])
+  std::vector<unsigned int>   cell_face_offsets, cell_faces, cell_neighbor;
+  std::vector<bool>           cell_first;
+  // owned cell of a relevant dof (invalid for ghosts)
+  std::vector<unsigned int>   relevant_cell;
+  // face data: total flux, unit mobilities, gravity difference,
+  // and the sides that can be upstream (bit 0 - first, bit 1 - second)
+  std::vector<double>         total_flux, mobility_w, mobility_o, gravity_difference;
+  std::vector<unsigned char>  upstream;
+  // components in the order found and their cells
+  std::vector<unsigned int>   component_offsets, component_cells;
+  // Tarjan's algorithm
+  std::vector<unsigned int>   visit_index, low_link, cell_stack;
+  std::vector<bool>           on_stack;
+  std::vector< std::pair<unsigned int,unsigned int> > call_stack;
+  // cell terms with the fixed fluxes to ghost cells,
+  // local time steps: levels and their cells and interior faces,
+  // and summed face fluxes of the owned cells
+  std::vector<unsigned int>   cell_level;
+  std::vector< std::vector<unsigned int> > level_cells, level_faces;
+  std::vector<double>         cell_source, flux_sum;
+  std::vector<double>         saturation;
+
+  static const unsigned int   max_newton_steps = 50,
+                              max_sweeps = 100;
+  static constexpr double     tolerance = 1e-10,
+                              derivative_step = 1e-7;
+};
+
+
+
+template <int dim>
+ReorderedTransport<dim>::
+ReorderedTransport(const Model::Model<dim> &model_)
+    :
+    model(model_),
+    phase_saturation(2),
+    phase_permeability(2),
+    Sw_min(0),
+    Sw_max(1),
+    n_implicit(0)
+{}  // eom
+
+
+
+template <int dim>
+void
+ReorderedTransport<dim>::reinit(const FVTools::LocalIndexMap &index_map,
+                                const FVTools::FaceList      &faces,
+                                const unsigned int            n_relevant_dofs)
+{
+  cell_relevant = index_map.cell_relevant;
+  const unsigned int n_cells = cell_relevant.size();
+
+  relevant_cell.assign(n_relevant_dofs, numbers::invalid_unsigned_int);
+  for (unsigned int k=0; k<n_cells; ++k)
+    relevant_cell[cell_relevant[k]] = k;
+
+  /* faces are stored once: collect the interior ones for both of their
+   * cells; faces to ghost cells have fixed fluxes (see setup_step)
+   */
+  cell_face_offsets.assign(n_cells + 1, 0);
+  for (unsigned int f=0; f<faces.n_interior_faces; ++f)
+  {
+    cell_face_offsets[relevant_cell[faces.first[f]] + 1]++;
+    cell_face_offsets[relevant_cell[faces.second[f]] + 1]++;
+  }
+  for (unsigned int k=0; k<n_cells; ++k)
+    cell_face_offsets[k+1] += cell_face_offsets[k];
+
+  const unsigned int n_entries = cell_face_offsets[n_cells];
+  cell_faces.resize(n_entries);
+  cell_neighbor.resize(n_entries);
+  cell_first.resize(n_entries);
+  std::vector<unsigned int> position(cell_face_offsets.begin(),
+                                     cell_face_offsets.end() - 1);
+  for (unsigned int f=0; f<faces.n_interior_faces; ++f)
+    for (unsigned int side=0; side<2; ++side)
+    {
+      const unsigned int a = (side == 0) ? faces.first[f] : faces.second[f];
+      const unsigned int b = (side == 0) ? faces.second[f] : faces.first[f];
+      const unsigned int k = relevant_cell[a];
+      cell_faces[position[k]] = f;
+      cell_neighbor[position[k]] = b;
+      cell_first[position[k]] = (side == 0);
+      position[k]++;
+    }
+
+  const unsigned int n_faces = faces.first.size();
+  total_flux.resize(n_faces);
+  mobility_w.resize(n_faces);
+  mobility_o.resize(n_faces);
+  gravity_difference.resize(n_faces);
+  upstream.resize(n_faces);
+
+  cell_rhs.resize(n_cells);
+  cell_factor.resize(n_cells);
+  explicit_saturation.resize(n_cells);
+  cell_level.resize(n_cells);
+  cell_source.resize(n_cells);
+  flux_sum.resize(n_cells);
+  implicit.assign(n_cells, true);
+  visit_index.resize(n_cells);
+  low_link.resize(n_cells);
+  on_stack.assign(n_cells, false);
+  saturation.resize(n_relevant_dofs);
+}  // eom
+
+
+
+template <int dim>
+inline
+void
+ReorderedTransport<dim>::relative_permeability(const double  Sw,
+                                               double       &k_rw,
+                                               double       &k_ro)
+{
+  phase_saturation[0] = Sw;
+  phase_saturation[1] = 1.0 - Sw;
+  model.get_relative_permeability(phase_saturation, phase_permeability);
+  k_rw = phase_permeability[0];
+  k_ro = phase_permeability[1];
+}  // eom
+
+
+
+template <int dim>
+void
+ReorderedTransport<dim>::setup_faces(const FVTools::FaceList &faces,
+                                     const double            *pressure)
+{
+  // largest relative permeabilities bound the mobilities for the upstream test
+  double k_rw_max, k_ro_max, k_rw, k_ro;
+  relative_permeability(Sw_max, k_rw_max, k_ro);
+  relative_permeability(Sw_min, k_rw, k_ro_max);
+
+  for (unsigned int f=0; f<faces.first.size(); ++f)
+  {
+    const double dp = pressure[faces.first[f]] - pressure[faces.second[f]];
+    total_flux[f] =
+        faces.transmissibility[0][f]*dp - faces.gravity[0][f] +
+        faces.transmissibility[1][f]*dp - faces.gravity[1][f];
+
+    mobility_w[f] = faces.unit_transmissibility[0][f];
+    mobility_o[f] = faces.unit_transmissibility[1][f];
+    if (mobility_w[f] > 0 && mobility_o[f] > 0)
+      gravity_difference[f] =
+          faces.unit_gravity[1][f]/mobility_o[f] - faces.unit_gravity[0][f]/mobility_w[f];
+    else
+      gravity_difference[f] = 0;
+
+    /* water moves along u_t + lambda_o*dg and oil along u_t - lambda_w*dg:
+     * a side is a possible upstream if one of them can point away from it
+     */
+    const double u_t = total_flux[f];
+    const double dg = gravity_difference[f];
+    const double water = u_t + k_ro_max*mobility_o[f]*dg;
+    const double oil = u_t - k_rw_max*mobility_w[f]*dg;
+    upstream[f] = 0;
+    if (std::max(u_t, std::max(water, oil)) > 0)
+      upstream[f] |= 1;
+    if (std::min(u_t, std::min(water, oil)) < 0)
+      upstream[f] |= 2;
+  }
+}  // eom
+
+
+
+template <int dim>
+double
+ReorderedTransport<dim>::water_flux(const unsigned int face,
+                                    const double       Sw_first,
+                                    const double       Sw_second)
+{
+  const double u_t = total_flux[face];
+  const double dg = gravity_difference[face];
+  double k_rw[2], k_ro[2];
+  relative_permeability(Sw_first, k_rw[0], k_ro[0]);
+  relative_permeability(Sw_second, k_rw[1], k_ro[1]);
+
+  /* the phase that moves with the gravity term flows along u_t;
+   * its mobility then fixes the direction of the other phase
+   */
+  double lambda_w, lambda_o;
+  if (u_t*dg >= 0)
+  {
+    lambda_w = mobility_w[face]*k_rw[(u_t + dg >= 0) ? 0 : 1];
+    lambda_o = mobility_o[face]*k_ro[(u_t - lambda_w*dg >= 0) ? 0 : 1];
+  }
+  else
+  {
+    lambda_o = mobility_o[face]*k_ro[(u_t >= 0) ? 0 : 1];
+    lambda_w = mobility_w[face]*k_rw[(u_t + lambda_o*dg >= 0) ? 0 : 1];
+  }
+
+  const double lambda = lambda_w + lambda_o;
+  if (lambda <= 0)
+    return 0;
+  return lambda_w/lambda*(u_t + lambda_o*dg);
+}  // eom
+
+
+
+template <int dim>
+double
+ReorderedTransport<dim>::residual(const unsigned int k,
+                                  const double       Sw)
+{
+  double outflow = 0;
+  for (unsigned int n=cell_face_offsets[k]; n<cell_face_offsets[k+1]; ++n)
+    if (cell_first[n])
+      outflow += water_flux(cell_faces[n], Sw, saturation[cell_neighbor[n]]);
+    else
+      outflow -= water_flux(cell_faces[n], saturation[cell_neighbor[n]], Sw);
+
+  return Sw - cell_rhs[k] + cell_factor[k]*outflow;
+}  // eom
+
+
+
+template <int dim>
+double
+ReorderedTransport<dim>::solve_cell(const unsigned int k)
+{
+  double &Sw = saturation[cell_relevant[k]];
+  const double Sw_start = Sw;
+
+  // saturations outside of the mobile range are clipped,
+  // as in the explicit update
+  double lower = Sw_min, upper = Sw_max;
+  if (residual(k, lower) >= 0)
+    Sw = lower;
+  else if (residual(k, upper) <= 0)
+    Sw = upper;
+  else
+  {
+    double x = std::max(lower, std::min(Sw, upper));
+    for (unsigned int step=0; step<max_newton_steps; ++step)
+    {
+      const double r = residual(k, x);
+      if (std::abs(r) < tolerance)
+        break;
+      // keep the root bracketed
+      if (r > 0)
+        upper = x;
+      else
+        lower = x;
+      if (upper - lower < tolerance)
+        break;
+
+      const double derivative = (residual(k, x + derivative_step) - r)/derivative_step;
+      const double x_newton = x - r/derivative;
+      if (derivative > 0 && x_newton > lower && x_newton < upper)
+        x = x_newton;
+      else
+        x = 0.5*(lower + upper);
+    }
+    Sw = x;
+  }
+
+  return std::abs(Sw - Sw_start);
+}  // eom
+
+
+
+template <int dim>
+double
+ReorderedTransport<dim>::cfl_number(const unsigned int k)
+{
+  const double Sw = saturation[cell_relevant[k]];
+  // one-sided difference that stays in the mobile range
+  const double step = (Sw + derivative_step <= Sw_max) ? derivative_step : -derivative_step;
+  return (residual(k, Sw + step) - residual(k, Sw))/step - 1.0;
+}  // eom
+
+
+
+template <int dim>
+void
+ReorderedTransport<dim>::find_components()
+{
+  const unsigned int n_cells = cell_relevant.size();
+  const unsigned int unvisited = numbers::invalid_unsigned_int;
+  std::fill(visit_index.begin(), visit_index.end(), unvisited);
+  component_offsets.assign(1, 0);
+  component_cells.clear();
+  unsigned int counter = 0;
+
+  // explicit stacks: the upstream paths can be as long as the mesh
+  for (unsigned int root=0; root<n_cells; ++root)
+  {
+    if (visit_index[root] != unvisited || !implicit[root])
+      continue;
+    visit_index[root] = low_link[root] = counter++;
+    cell_stack.push_back(root);
+    on_stack[root] = true;
+    call_stack.push_back(std::make_pair(root, cell_face_offsets[root]));
+
+    while (!call_stack.empty())
+    {
+      const unsigned int u = call_stack.back().first;
+      const unsigned int n = call_stack.back().second;
+      if (n < cell_face_offsets[u+1])
+      {
+        call_stack.back().second++;
+        // edges go from a cell to the owned cells downstream of it
+        const unsigned char side = cell_first[n] ? 1 : 2;
+        if (!(upstream[cell_faces[n]] & side))
+          continue;
+        const unsigned int v = relevant_cell[cell_neighbor[n]];
+        if (!implicit[v])
+          continue;
+
+        if (visit_index[v] == unvisited)
+        {
+          visit_index[v] = low_link[v] = counter++;
+          cell_stack.push_back(v);
+          on_stack[v] = true;
+          call_stack.push_back(std::make_pair(v, cell_face_offsets[v]));
+        }
+        else if (on_stack[v])
+          low_link[u] = std::min(low_link[u], visit_index[v]);
+      }
+      else
+      {
+        call_stack.pop_back();
+        if (!call_stack.empty())
+        {
+          const unsigned int parent = call_stack.back().first;
+          low_link[parent] = std::min(low_link[parent], low_link[u]);
+        }
+        if (low_link[u] == visit_index[u])
+        { // u is the root of a component
+          unsigned int w;
+          do
+          {
+            w = cell_stack.back();
+            cell_stack.pop_back();
+            on_stack[w] = false;
+            component_cells.push_back(w);
+          } while (w != u);
+          component_offsets.push_back(component_cells.size());
+        }
+      }
+    }
+  }
+}  // eom
+
+
+
+template <int dim>
+void
+ReorderedTransport<dim>::
+setup_step(const FVTools::FaceList   &faces,
+           const double               time_step,
+           const double              *pressure,
+           const double              *old_saturation,
+           const std::vector<double> &cell_increment,
+           const std::vector<double> &cell_mass)
+{
+  AssertThrow(faces.first.size() == total_flux.size(),
+              ExcMessage("Call reinit first"));
+  AssertThrow(faces.unit_transmissibility.size() == 2,
+              ExcMessage("Reordered transport needs two phases"));
+
+  Sw_min = model.residual_saturation_water();
+  Sw_max = 1.0 - model.residual_saturation_oil();
+
+  std::copy(old_saturation, old_saturation + saturation.size(), saturation.begin());
+  for (unsigned int k=0; k<cell_relevant.size(); ++k)
+  {
+    cell_source[k] = cell_increment[k];
+    cell_factor[k] = time_step/cell_mass[k];
+  }
+
+  setup_faces(faces, pressure);
+
+  // faces to ghost cells: one flux of the old saturations
+  for (unsigned int f=faces.n_interior_faces; f<faces.first.size(); ++f)
+  {
+    const double flux = water_flux(f, saturation[faces.first[f]],
+                                   saturation[faces.second[f]]);
+    const unsigned int a = relevant_cell[faces.first[f]];
+    if (a != numbers::invalid_unsigned_int)
+      cell_source[a] -= cell_factor[a]*flux;
+    else
+    {
+      const unsigned int b = relevant_cell[faces.second[f]];
+      cell_source[b] += cell_factor[b]*flux;
+    }
+  }
+
+  for (unsigned int k=0; k<cell_relevant.size(); ++k)
+    cell_rhs[k] = old_saturation[cell_relevant[k]] + cell_source[k];
+}  // eom
+
+
+
+template <int dim>
+void
+ReorderedTransport<dim>::solve(const FVTools::FaceList   &faces,
+                               const double               time_step,
+                               const double              *pressure,
+                               const double              *old_saturation,
+                               const std::vector<double> &cell_increment,
+                               const std::vector<double> &cell_mass,
+                               const double               implicit_cfl)
+{
+  setup_step(faces, time_step, pressure, old_saturation,
+             cell_increment, cell_mass);
+
+  // implicit set of this step
+  n_implicit = 0;
+  for (unsigned int k=0; k<cell_relevant.size(); ++k)
+  {
+    implicit[k] = (implicit_cfl <= 0 || cfl_number(k) > implicit_cfl);
+    if (implicit[k])
+      n_implicit++;
+  }
+
+  find_components();
+
+  // Tarjan's algorithm finds the downstream components first
+  for (unsigned int c=component_offsets.size()-1; c>0; --c)
+  {
+    const unsigned int begin = component_offsets[c-1];
+    const unsigned int end = component_offsets[c];
+    if (end - begin == 1)
+    {
+      solve_cell(component_cells[begin]);
+      continue;
+    }
+
+    for (unsigned int sweep=0; sweep<max_sweeps; ++sweep)
+    {
+      double change = 0;
+      for (unsigned int i=begin; i<end; ++i)
+        change = std::max(change, solve_cell(component_cells[i]));
+      if (change < tolerance)
+        break;
+    }
+  }
+
+  /* explicit cells see their own saturation at the old and the implicit
+   * neighbors at the new value: all updates are computed before any is stored
+   */
+  if (n_implicit == cell_relevant.size())
+    return;
+  for (unsigned int k=0; k<cell_relevant.size(); ++k)
+    if (!implicit[k])
+    {
+      const double Sw = saturation[cell_relevant[k]];
+      explicit_saturation[k] =
+          std::max(Sw_min, std::min(Sw - residual(k, Sw), Sw_max));
+    }
+  for (unsigned int k=0; k<cell_relevant.size(); ++k)
+    if (!implicit[k])
+      saturation[cell_relevant[k]] = explicit_saturation[k];
+}  // eom
+
+
+
+template <int dim>
+unsigned int
+ReorderedTransport<dim>::
+solve_local_steps(const FVTools::FaceList   &faces,
+                  const double               time_step,
+                  const double              *pressure,
+                  const double              *old_saturation,
+                  const std::vector<double> &cell_increment,
+                  const std::vector<double> &cell_mass,
+                  const double               cfl_limit,
+                  const unsigned int         max_levels)
+{
+  AssertThrow(max_levels >= 1 && max_levels <= 16,
+              ExcMessage("Wrong number of time step levels"));
+  setup_step(faces, time_step, pressure, old_saturation,
+             cell_increment, cell_mass);
+  const unsigned int n_cells = cell_relevant.size();
+
+  // level of each cell from its CFL number with the full step
+  for (unsigned int k=0; k<n_cells; ++k)
+  {
+    const double cfl = cfl_number(k);
+    unsigned int level = 0;
+    while (level + 1 < max_levels && cfl > cfl_limit*(1u << level))
+      level++;
+    cell_level[k] = level;
+  }
+
+  // neighbors differ by one level at most
+  for (bool changed=true; changed; )
+  {
+    changed = false;
+    for (unsigned int k=0; k<n_cells; ++k)
+      for (unsigned int n=cell_face_offsets[k]; n<cell_face_offsets[k+1]; ++n)
+      {
+        const unsigned int v = relevant_cell[cell_neighbor[n]];
+        if (cell_level[v] + 1 < cell_level[k])
+        {
+          cell_level[v] = cell_level[k] - 1;
+          changed = true;
+        }
+      }
+  }
+
+  unsigned int top = 0;
+  for (unsigned int k=0; k<n_cells; ++k)
+    top = std::max(top, cell_level[k]);
+  level_cells.resize(top + 1);
+  level_faces.resize(top + 1);
+  for (unsigned int l=0; l<=top; ++l)
+  {
+    level_cells[l].clear();
+    level_faces[l].clear();
+  }
+
+  // cell_source holds the cell terms with the fluxes to ghost cells
+  for (unsigned int k=0; k<n_cells; ++k)
+  {
+    level_cells[cell_level[k]].push_back(k);
+    flux_sum[k] = 0;
+  }
+  for (unsigned int f=0; f<faces.n_interior_faces; ++f)
+    level_faces[std::max(cell_level[relevant_cell[faces.first[f]]],
+                         cell_level[relevant_cell[faces.second[f]]])].push_back(f);
+
+  const unsigned int n_substeps = 1u << top;
+  for (unsigned int s=0; s<n_substeps; ++s)
+  {
+    // faces of the levels that start a step, as fractions of dt
+    for (unsigned int l=0; l<=top; ++l)
+    {
+      const unsigned int stride = 1u << (top - l);
+      if (s % stride != 0)
+        continue;
+      const double fraction = static_cast<double>(stride)/n_substeps;
+      for (const unsigned int f : level_faces[l])
+      {
+        const double flux = fraction*water_flux(f, saturation[faces.first[f]],
+                                                saturation[faces.second[f]]);
+        flux_sum[relevant_cell[faces.first[f]]] += flux;
+        flux_sum[relevant_cell[faces.second[f]]] -= flux;
+      }
+    }
+
+    // cells of the levels that complete a step
+    for (unsigned int l=0; l<=top; ++l)
+    {
+      const unsigned int stride = 1u << (top - l);
+      if ((s + 1) % stride != 0)
+        continue;
+      const double fraction = static_cast<double>(stride)/n_substeps;
+      for (const unsigned int k : level_cells[l])
+      {
+        double &Sw = saturation[cell_relevant[k]];
+        Sw += fraction*cell_source[k] - cell_factor[k]*flux_sum[k];
+        Sw = std::max(Sw_min, std::min(Sw, Sw_max));
+        flux_sum[k] = 0;
+      }
+    }
+  }
+
+  return top + 1;
+}  // eom
+
+
+
+template <int dim>
+inline
+const std::vector<double> &
+ReorderedTransport<dim>::get_saturation() const
+{
+  return saturation;
+}  // eom
+
+
+
+template <int dim>
+inline
+unsigned int
+ReorderedTransport<dim>::n_implicit_cells() const
+{
+  return n_implicit;
+}  // eom
+
+}  // end of namespace
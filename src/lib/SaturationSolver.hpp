@@ -1,8 +1,15 @@
 #pragma once
 
+#include <deal.II/base/mpi.h>
 #include <deal.II/lac/trilinos_vector.h>
 #include <deal.II/dofs/dof_handler.h>
 #include <CellValues/CellValuesSaturation.hpp>
+#include <FVTools.hpp>
+#include <GhostExchange.hpp>
+#include <ReorderedTransport.hpp>
+#include <algorithm>
+#include <cmath>
+#include <memory>
 
 
 namespace FluidSolvers
@@ -10,6 +17,22 @@ namespace FluidSolvers
 using namespace dealii;
 
 
+// reductions of the saturation update
+struct SaturationSummary
+{
+  SaturationSummary()
+      :
+      water_in_place(0),
+      min_saturation(0),
+      max_saturation(0)
+  {}
+  // water volume at surface conditions
+  double water_in_place;
+  // range of the water saturation
+  double min_saturation, max_saturation;
+};
+
+
 template <int dim>
 class SaturationSolver
 {
@@ -24,15 +47,34 @@ class SaturationSolver
    */
   void setup_dofs(IndexSet &locally_owned_dofs,
                   IndexSet &locally_relevant_dofs);
-  void
   /*
-   * update current solution with IMPES method
+   * update current solution with IMPES method.
+   * The water fluxes use the face transmissibilities stored by the
+   * pressure assembly and the new pressure; with the reordering
+   * solver they are implicit in the saturation, with the adaptive
+   * implicit solver in the cells above the CFL limit; the local time
+   * stepping solver substeps the cells by their CFL number
+   * (see ReorderedTransport).
+   * In the sequential implicit loop the step starts from old_solution.
+   * The explicit update sums the face fluxes in one pass over the
+   * faces and evaluates the cell terms in the pass that updates the cells.
+   * If a pending ghost update of the pressure is given,
+   * it is completed after the interior cells are updated.
+   * The update sweep also reduces the summary of the new saturation
+   * (see get_summary).
+   * Returns the largest water saturation change relative to
+   * relevant_solution (the last iterate) over all processes
    */
-  solve(CellValues::CellValuesSaturation<dim> &cell_values,
-        CellValues::CellValuesBase<dim>       &neighbor_values,
-        const double                           time_step,
-        const TrilinosWrappers::MPI::Vector   &pressure_solution,
-        const TrilinosWrappers::MPI::Vector   &old_pressure_solution);
+  template <Model::ModelType type>
+  double
+  solve(CellValues::CellValuesSaturation<dim,type> &cell_values,
+        const FVTools::FaceList                    &faces,
+        const double                                time_step,
+        const TrilinosWrappers::MPI::Vector        &pressure_solution,
+        const TrilinosWrappers::MPI::Vector        &old_pressure_solution,
+        Communication::GhostExchange               *pressure_exchange = NULL);
+  // summary of the last solve over all processes
+  const SaturationSummary & get_summary() const;
 
   // Variabled
   const unsigned int                        n_phases;
@@ -41,10 +83,27 @@ class SaturationSolver
   const DoFHandler<dim>                     &dof_handler;
   const Model::Model<dim>                   &model;
   ConditionalOStream                        &pcout;
+  // locally owned cells: interior cells first, then subdomain boundary
+  std::vector<typename DoFHandler<dim>::active_cell_iterator> owned_cells;
+  unsigned int                              n_interior_cells;
+  std::unique_ptr< FVTools::ScratchData<dim> > scratch;
+  // dof indices of the cells and face neighbors in the loop
+  FVTools::LocalIndexMap                    index_map;
+  unsigned int                              n_relevant_dofs;
+  // cell terms and mass coefficient of the owned cells (implicit solvers),
+  // face flux sums on the relevant dofs
+  std::vector<double>                       cell_increment, cell_mass, outflow;
+  // implicit update; its face lists are rebuilt at the first solve
+  // after setup_dofs
+  ReorderedTransport<dim>                   reordered_transport;
+  bool                                      transport_needs_reinit;
+  SaturationSummary                         summary;
  public:
   std::vector<TrilinosWrappers::MPI::Vector>
   solution, relevant_solution, old_solution;
   TrilinosWrappers::MPI::Vector rhs_vector;
+  // cell volumetric strains (current and last time step) in coupled models
+  const TrilinosWrappers::MPI::Vector *volumetric_strain, *old_volumetric_strain;
 };
 
 
@@ -59,7 +118,13 @@ SaturationSolver(MPI_Comm                   &mpi_communicator_,
     mpi_communicator(mpi_communicator_),
     dof_handler(dof_handler_),
     model(model_),
-    pcout(pcout_)
+    pcout(pcout_),
+    n_interior_cells(0),
+    n_relevant_dofs(0),
+    reordered_transport(model_),
+    transport_needs_reinit(true),
+    volumetric_strain(NULL),
+    old_volumetric_strain(NULL)
 {}
 
 
@@ -85,186 +150,192 @@ SaturationSolver<dim>::setup_dofs(IndexSet &locally_owned_dofs,
 
   rhs_vector.reinit(locally_owned_dofs, locally_relevant_dofs,
                     mpi_communicator, /* omit-zeros=*/ true);
+
+  n_interior_cells = FVTools::sort_subdomain_cells(dof_handler, owned_cells);
+  FVTools::build_local_index_map<dim>(owned_cells, locally_owned_dofs,
+                                      locally_relevant_dofs, index_map);
+  n_relevant_dofs = locally_relevant_dofs.n_elements();
+  cell_increment.resize(owned_cells.size());
+  cell_mass.resize(owned_cells.size());
+  outflow.resize(n_relevant_dofs);
+  transport_needs_reinit = true;
+  scratch.reset(new FVTools::ScratchData<dim>(dof_handler.get_fe(), n_phases));
 }  // eom
 
 
 
 template <int dim>
-void
+template <Model::ModelType type>
+double
 SaturationSolver<dim>::
-solve(CellValues::CellValuesSaturation<dim> &cell_values,
-      CellValues::CellValuesBase<dim>       &neighbor_values,
-      const double                           time_step,
-      const TrilinosWrappers::MPI::Vector   &pressure_solution,
-      const TrilinosWrappers::MPI::Vector   &old_pressure_solution)
+solve(CellValues::CellValuesSaturation<dim,type> &cell_values,
+      const FVTools::FaceList                    &faces,
+      const double                                time_step,
+      const TrilinosWrappers::MPI::Vector        &pressure_solution,
+      const TrilinosWrappers::MPI::Vector        &old_pressure_solution,
+      Communication::GhostExchange               *pressure_exchange)
 {
-  // Only one integration point in FVM
-  QGauss<dim>       quadrature_formula(1);
-  QGauss<dim-1>     face_quadrature_formula(1);
-
-  const auto & fe = dof_handler.get_fe();
-  FEValues<dim> fe_values(fe, quadrature_formula, update_values);
-  FEValues<dim> fe_values_neighbor(fe, quadrature_formula, update_values);
-
-  // the following two objects only get geometry data
-  FEFaceValues<dim> fe_face_values(fe, face_quadrature_formula,
-                                   update_normal_vectors);
-  // We need JxW flag for subfaces since there is no
-  // method to determine sub face area in triangulation class
-  FESubfaceValues<dim> fe_subface_values(fe, face_quadrature_formula,
-                                         update_normal_vectors |
-                                         update_JxW_values);
-
-  const unsigned int dofs_per_cell = fe.dofs_per_cell;
-  std::vector<types::global_dof_index>
-      dof_indices(dofs_per_cell),
-      dof_indices_neighbor(dofs_per_cell);
-
-  // objects to store local data
-  Tensor<1, dim>       normal;
-  std::vector<double>  p_values(quadrature_formula.size()),
-                       p_old_values(quadrature_formula.size());
-
-  std::vector< std::vector<double> >  s_values(model.n_phases()-1);
-  for (auto & c: s_values)
-    c.resize(face_quadrature_formula.size());
-
-  std::vector<double>  extra_values(model.n_phases() - 1);
+  AssertThrow(scratch, ExcMessage("Call setup_dofs first"));
+  AssertThrow(Model::ModelTraits<type>::n_phases > 1,
+              ExcMessage("No saturation equation in a single-phase model"));
+  std::vector<double>  &extra_values = scratch->extra_values;
+  AssertThrow(extra_values.size() == Model::ModelTraits<type>::n_phases - 1,
+              ExcDimensionMismatch(extra_values.size(),
+                                   Model::ModelTraits<type>::n_phases - 1));
+  AssertThrow(pressure_solution.trilinos_vector().MyLength() ==
+              static_cast<int>(n_relevant_dofs) &&
+              old_pressure_solution.trilinos_vector().MyLength() ==
+              static_cast<int>(n_relevant_dofs),
+              ExcMessage("Pressure is not a vector on the relevant dofs"));
+  AssertThrow(faces.neighbor_face.size() == index_map.neighbor_dofs.size(),
+              ExcMessage("Face list does not match the cells of the solver"));
+
+  // one dof per cell: cell values are read from the local arrays
+  // at the positions cached in index_map
+  const double *p_values = FVTools::local_values(pressure_solution);
+  const double *p_old_values = FVTools::local_values(old_pressure_solution);
+  const double *s_values[Model::ModelTraits<type>::n_phases];
+  for (unsigned int c=0; c<Model::ModelTraits<type>::n_phases - 1; ++c)
+    s_values[c] = FVTools::local_values(relevant_solution[c]);
+  /* saturation at the start of the step: the sequential implicit loop
+   * keeps it in old_solution, relevant_solution holds the last iterate
+   */
+  const double *s_old_values = (model.max_sfi_steps > 0) ?
+                               FVTools::local_values(old_solution[0]) : s_values[0];
+  const double *e_values = NULL, *e_old_values = NULL;
+  if (volumetric_strain != NULL)
+  {
+    e_values = FVTools::local_values(*volumetric_strain);
+    e_old_values = FVTools::local_values(*old_volumetric_strain);
+  }
 
   const double So_rw = model.residual_saturation_oil();
   const double Sw_crit = model.residual_saturation_water();
-  const unsigned int q_point = 0;
 
-  typename DoFHandler<dim>::active_cell_iterator
-      cell = dof_handler.begin_active(),
-      endc = dof_handler.end();
+  // cell terms: wells, compressibility, and strain (no ghosts needed)
+  const auto update_cell_terms = [&](const unsigned int k,
+                                     double            &increment,
+                                     double            &mass)
+  {
+    const auto & cell = owned_cells[k];
+    const unsigned int i_local = index_map.cell_relevant[k];
+    for (unsigned int c=0; c<Model::ModelTraits<type>::n_phases - 1; ++c)
+      extra_values[c] = s_values[c][i_local];
+
+    const double p_old = p_old_values[i_local];
+    const double p = p_values[i_local];
+
+    cell_values.update(cell, p, extra_values);
+    if (volumetric_strain != NULL)
+      cell_values.update_strain(e_values[index_map.cell_owned[k]],
+                                e_old_values[index_map.cell_owned[k]]);
+    cell_values.update_wells(cell, p);
+
+    increment = cell_values.get_rhs_cell_entry(time_step, p, p_old, 0);
+    mass = cell_values.c1w;
+  };
+
+  /* saturation change, saturation range and water in place of the
+   * updated cells; the maxima are reduced together
+   */
+  double maxima[3] = {0, -1, -1}, water_in_place = 0;
+  double &max_change = maxima[0], &max_Sw = maxima[1], &minus_min_Sw = maxima[2];
+  const auto add_to_summary = [&](const double Sw, const double mass)
+  {
+    water_in_place += Sw*mass;
+    max_Sw = std::max(max_Sw, Sw);
+    minus_min_Sw = std::max(minus_min_Sw, -Sw);
+  };
+  const auto reduce_summary = [&]()
+  {
+    MPI_Allreduce(MPI_IN_PLACE, maxima, 3, MPI_DOUBLE, MPI_MAX, mpi_communicator);
+    summary.water_in_place = Utilities::MPI::sum(water_in_place, mpi_communicator);
+    summary.max_saturation = max_Sw;
+    summary.min_saturation = -minus_min_Sw;
+    return max_change;
+  };
+
+  if (model.saturation_solver_type != Model::SaturationSolverType::Explicit)
+  {
+    for (unsigned int k=0; k<owned_cells.size(); ++k)
+      update_cell_terms(k, cell_increment[k], cell_mass[k]);
 
-  for (; cell!=endc; ++cell)
-    if (cell->is_locally_owned())
+    // upstream cells on the subdomain boundary are ghosts
+    if (pressure_exchange != NULL && pressure_exchange->in_progress())
+      pressure_exchange->finish();
+    if (transport_needs_reinit)
     {
-      fe_values.reinit(cell);
-      fe_values.get_function_values(old_pressure_solution, p_old_values);
-      fe_values.get_function_values(pressure_solution, p_values);
-      for (unsigned int c=0; c<model.n_phases() - 1; ++c)
-      {
-        fe_values.get_function_values(relevant_solution[c], s_values[c]);
-        extra_values[c] = s_values[c][0];
-      }
-
-      const double p_old = p_old_values[q_point];
-      const double p = p_values[q_point];
-      const double Sw_old = extra_values[q_point];
-
-      // std::cout << "value1 c1w = " << cell_values.c1p << std::endl;
-      // std::cout << "value1 c1p = " << cell_values.c1w << std::endl;
-      cell_values.update(cell, p, extra_values);
-      // std::cout << "value2 c1p = " << cell_values.c1p << std::endl;
-      // std::cout << "value2 c1w = " << cell_values.c1w << std::endl;
-      // std::cout << "value2 c1p/c1w = " << cell_values.c1p / cell_values.c1w << std::endl;
-      // std::cout << "value_weird c1p/c1w = " << cell_values.get_B(0) << std::endl;
-      cell_values.update_wells(cell, p);
-
-      double solution_increment =
-          cell_values.get_rhs_cell_entry(time_step, p, p_old, 0);
-      // double solution_increment =
-      //     -
-      //     cell_values.get_B(0) * (p - p_old)
-      //     +
-      //     // -
-      //     // cell_values.get_E() * ( div_e - div_e_old )
-      //     +
-      //     time_step * cell_values.get_Q(0)
-      //     ;
-
-      cell->get_dof_indices(dof_indices);
-      const unsigned int i = dof_indices[q_point];
-
-      for (unsigned int f=0; f<GeometryInfo<dim>::faces_per_cell; ++f)
-      {
-        if (cell->at_boundary(f) == false)
-        {
-          if((cell->neighbor(f)->level() == cell->level() &&
-              cell->neighbor(f)->has_children() == false) ||
-             cell->neighbor_is_coarser(f))
-          {
-            const auto & neighbor = cell->neighbor(f);
-            fe_values.reinit(neighbor);
-            fe_face_values.reinit(cell, f);
-
-            fe_values.get_function_values(pressure_solution, p_values);
-            for (unsigned int c=0; c<model.n_phases() - 1; ++c)
-            {
-              fe_values.get_function_values(relevant_solution[c], s_values[c]);
-              extra_values[c] = s_values[c][q_point];
-            }
-            const double p_neighbor = p_values[q_point];
-
-            normal = fe_face_values.normal_vector(q_point);
-            const double dS = cell->face(f)->measure();  // face area
-
-            // assemble local matrix and distribute
-            neighbor_values.update(neighbor, p_neighbor, extra_values);
-            cell_values.update_face_values(neighbor_values, normal, dS);
-
-            solution_increment += cell_values.get_rhs_face_entry(time_step, 0);
-            // time_step *
-            //     (
-            //         cell_values.get_T_face(0)
-            //         -
-            //         cell_values.get_G_face(0)
-            //      )
-            //     ;
-
-            // if (i == 0)
-            // {
-            //   pcout << "Tw = " << time_step*cell_values.get_T_face(0) << std::endl;
-            //   pcout << "To = " << time_step*cell_values.get_T_face(1) << std::endl;
-            // }
-
-          }
-          else if ((cell->neighbor(f)->level() == cell->level()) &&
-                   (cell->neighbor(f)->has_children() == true))
-          {
-            for (unsigned int subface=0;
-                 subface<cell->face(f)->n_children(); ++subface)
-            {
-              // compute parameters
-              const auto & neighbor
-                  = cell->neighbor_child_on_subface(f, subface);
-
-              fe_values.reinit(neighbor);
-              // fe_face_values.reinit(cell, f);
-              fe_subface_values.reinit(cell, f, subface);
-
-              fe_values.get_function_values(pressure_solution, p_values);
-              const double p_neighbor = p_values[q_point];
-              for (unsigned int c=0; c<model.n_phases()-1; ++c)
-                fe_values.get_function_values(relevant_solution[c], s_values[c]);
-
-              normal = fe_subface_values.normal_vector(q_point); // 0 is gauss point
-              const double dS = fe_subface_values.JxW(q_point);
-
-              // update neighbor
-              neighbor_values.update(neighbor, p_neighbor, extra_values);
-
-              // update face values
-              cell_values.update_face_values(neighbor_values, normal, dS);
-
-              // distribute
-              solution_increment += cell_values.get_rhs_face_entry(time_step, 0);
-              // solution_increment +=
-              //     time_step *
-              //     (
-              //         cell_values.get_T_face(0)
-              //         -
-              //         cell_values.get_G_face(0)
-              //      )
-              //     ;
-            }
-          } // end case neighbor is finer
-
-        } // end if face not at boundary
-      }  // end face loop
+      reordered_transport.reinit(index_map, faces, n_relevant_dofs);
+      transport_needs_reinit = false;
+    }
+
+    if (model.saturation_solver_type == Model::SaturationSolverType::LocalTimeStepping)
+    {
+      const unsigned int n_levels =
+          reordered_transport.solve_local_steps(faces, time_step, p_values, s_old_values,
+                                                cell_increment, cell_mass,
+                                                model.lts_cfl, model.time_step_levels);
+      pcout << "Saturation time step levels "
+            << Utilities::MPI::max(n_levels, mpi_communicator)
+            << std::endl;
+    }
+    else
+    {
+      const bool adaptive =
+          (model.saturation_solver_type == Model::SaturationSolverType::Adaptive);
+      reordered_transport.solve(faces, time_step, p_values, s_old_values,
+                                cell_increment, cell_mass,
+                                adaptive ? model.implicit_cfl : 0);
+      if (adaptive)
+        pcout << "Implicit cells "
+              << Utilities::MPI::sum(reordered_transport.n_implicit_cells(),
+                                     mpi_communicator)
+              << std::endl;
+    }
+    const std::vector<double> &Sw = reordered_transport.get_saturation();
+    for (unsigned int k=0; k<owned_cells.size(); ++k)
+    {
+      const unsigned int i = index_map.cell_dofs[k];
+      const unsigned int i_local = index_map.cell_relevant[k];
+      solution[0][i] = Sw[i_local];
+      solution[1][i] = 1.0 - Sw[i_local];
+      max_change = std::max(max_change, std::abs(Sw[i_local] - s_values[0][i_local]));
+      add_to_summary(Sw[i_local], cell_mass[k]);
+    }
+    solution[0].compress(VectorOperation::insert);
+    solution[1].compress(VectorOperation::insert);
+    return reduce_summary();
+  }
+
+  /* water fluxes through the faces with the stored transmissibilities;
+   * each face is computed once and added to both of its cells
+   */
+  const std::vector<double> &T_w = faces.transmissibility[0];
+  const std::vector<double> &G_w = faces.gravity[0];
+  const auto sum_fluxes = [&](const unsigned int begin, const unsigned int end)
+  {
+    for (unsigned int f=begin; f<end; ++f)
+    {
+      const unsigned int a = faces.first[f];
+      const unsigned int b = faces.second[f];
+      const double flux = T_w[f]*(p_values[a] - p_values[b]) - G_w[f];
+      outflow[a] += flux;
+      outflow[b] -= flux;
+    }
+  };
+
+  // cell terms, update, the saturation change and the summary in one pass
+  const auto update_cells = [&](const unsigned int begin, const unsigned int end)
+  {
+    for (unsigned int k=begin; k<end; ++k)
+    {
+      const unsigned int i = index_map.cell_dofs[k];
+      const unsigned int i_local = index_map.cell_relevant[k];
+      const double Sw_old = s_old_values[i_local];
+      double increment, mass;
+      update_cell_terms(k, increment, mass);
+
+      double solution_increment = increment - time_step*outflow[i_local]/mass;
 
       // assert that we are in bounds
       if (Sw_old + solution_increment > (1.0 - So_rw))
@@ -272,27 +343,40 @@ solve(CellValues::CellValuesSaturation<dim> &cell_values,
       else if (Sw_old + solution_increment < Sw_crit)
         solution_increment = Sw_crit - Sw_old;
 
-      // if (i == 0)
-      // {
-      //   pcout << "\nSATURATION"<< std::endl;
-      //   pcout << "dp = "<< p - p_old << std::endl;
-      //   pcout << "dSw = " << solution_increment << std::endl;
-      //   pcout << "Qw = " << time_step*cell_values.get_Q(0) << std::endl;
-      //   pcout << "Tw = " << cell_values.get_T_face(0) << std::endl;
-      //   pcout << "C1P/C1W = " << cell_values.get_B(0)
-      //         << std::endl;
-
-      //   pcout << std::endl;
-      // }
       solution[0][i] = Sw_old + solution_increment;
       solution[1][i] = 1.0 - (Sw_old + solution_increment);
-    } // end cells loop
+      max_change = std::max(max_change,
+                            std::abs(Sw_old + solution_increment - s_values[0][i_local]));
+      add_to_summary(Sw_old + solution_increment, mass);
+    }
+  };
+
+  /* the faces of the interior cells are all interior faces, so these
+   * cells are updated while the pressure ghosts are in flight
+   */
+  std::fill(outflow.begin(), outflow.end(), 0.0);
+  sum_fluxes(0, faces.n_interior_faces);
+  update_cells(0, n_interior_cells);
+
+  // subdomain boundary faces need the ghost values
+  if (pressure_exchange != NULL && pressure_exchange->in_progress())
+    pressure_exchange->finish();
+  sum_fluxes(faces.n_interior_faces, faces.first.size());
+  update_cells(n_interior_cells, owned_cells.size());
 
-  // solution[0].compress(VectorOperation::add);
-  // solution[1].compress(VectorOperation::add);
   solution[0].compress(VectorOperation::insert);
   solution[1].compress(VectorOperation::insert);
-}
+  return reduce_summary();
+}  // eom
+
+
+
+template <int dim>
+const SaturationSummary &
+SaturationSolver<dim>::get_summary() const
+{
+  return summary;
+}  // eom
 
 
 } // end of namespace
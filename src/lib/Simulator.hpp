@@ -8,15 +8,21 @@
 #include <deal.II/numerics/data_out_dof_data.h>
 #include <deal.II/grid/grid_generator.h> // to create mesh
 #include <deal.II/grid/grid_out.h>
+#include <deal.II/distributed/solution_transfer.h>
 
 // Custom modules
 #include <Model.hpp>
 #include <Reader.hpp>
 #include <OutputHelper.hpp>
+#include <LoadBalancer.hpp>
+#include <GhostExchange.hpp>
 
 // #include <Wellbore.hpp>
 #include <PressureSolver.hpp>
 #include <SaturationSolver.hpp>
+#include <ElasticSolver.hpp>
+#include <MultirateCoupling.hpp>
+#include <PressureGuess.hpp>
 #include <FEFunction/FEFunction.hpp>
 // #include <FEFunction/FEFunctionPVT.hpp>
 
@@ -36,21 +42,81 @@ class Simulator
   void read_mesh();
   void create_mesh();
   void run();
+  // accessing private members
+  const DoFHandler<dim> &               get_dof_handler();
+  const TrilinosWrappers::MPI::Vector & get_pressure() const;
+  // DG0 volumetric strain on the flow dofs of the coupled models
+  const TrilinosWrappers::MPI::Vector & get_volumetric_strain() const;
 
 
  private:
+  /* Read the input file into the model; returns the triangulation
+   * settings the input needs
+   */
+  typename parallel::distributed::Triangulation<dim>::Settings read_input();
   void refine_mesh();
+  // redistribute cells according to the load balancer weights
+  // and transfer the solution to the new partition
+  void repartition(FluidSolvers::SaturationSolver<dim> &saturation_solver);
+  // build communication plans for the ghost updates of the solution vectors
+  void setup_ghost_exchange(FluidSolvers::SaturationSolver<dim> &saturation_solver);
+  // setup elasticity dofs and allocate the coupling vectors
+  void setup_mechanics(FluidSolvers::SaturationSolver<dim> &saturation_solver);
+  /* Pressure solve from the extrapolated initial guess; with
+   * the comparison switched on the system is solved from the
+   * last solution first and both iteration counts are logged
+   */
+  unsigned int solve_pressure(const double time);
+  /* Fixed-stress split: pressure and displacements are solved in turn
+   * until the pressure change drops below the FSS tolerance
+   */
+  template <Model::ModelType type>
+  void solve_fixed_stress(CellValues::CellValuesBase<dim,type> &cell_values,
+                          CellValues::CellValuesBase<dim,type> &neighbor_values,
+                          const double                          time_step,
+                          FluidSolvers::SaturationSolver<dim>  &saturation_solver);
+  /* Sequential implicit step: pressure and saturation are solved in
+   * turn until their changes drop below the SFI tolerances.
+   * Returns the number of iterations, 0 if the loop did not converge
+   */
+  template <Model::ModelType type>
+  unsigned int
+  solve_sequential_implicit(CellValues::CellValuesBase<dim,type>       &cell_values,
+                            CellValues::CellValuesBase<dim,type>       &neighbor_values,
+                            CellValues::CellValuesSaturation<dim,type> &saturation_values,
+                            const double                                time,
+                            const double                                time_step,
+                            FluidSolvers::SaturationSolver<dim>        &saturation_solver);
+  /* IMPES time loop with the cell kernels compiled for the fluid model
+   * type; run() dispatches once to the instantiation for the model
+   */
+  template <Model::ModelType type>
+  void run_time_loop(FluidSolvers::SaturationSolver<dim> &saturation_solver);
   void field_report(const double time_step,
                     const unsigned int time_step_number,
                     const FluidSolvers::SaturationSolver<dim> &saturation_solver);
 
   MPI_Comm                                  mpi_communicator;
-  parallel::distributed::Triangulation<dim> triangulation;
+  // the input is read before the triangulation is built
   ConditionalOStream                        pcout;
   Model::Model<dim>                         model;
-  FluidSolvers::PressureSolver<dim>         pressure_solver;
   std::string                               input_file;
+  parallel::distributed::Triangulation<dim> triangulation;
+  FluidSolvers::PressureSolver<dim>         pressure_solver;
+  SolidSolvers::ElasticSolver<dim>          elastic_solver;
+  Coupling::MultirateCoupling<dim>          multirate_coupling;
+  FluidSolvers::PressureGuess<dim>          pressure_guess;
+  // DG0 vectors on the flow dofs for the coupled models
+  TrilinosWrappers::MPI::Vector             volumetric_strain,
+                                            old_volumetric_strain,
+                                            reference_pressure,
+                                            pressure_iterate;
   Output::OutputHelper<dim>                 output_helper;
+  LoadBalancing::LoadBalancer<dim>          load_balancer;
+  // ghost updates of pressure, of all saturations, and of both together
+  Communication::GhostExchange              pressure_exchange,
+                                            saturation_exchange,
+                                            field_exchange;
   // TimerOutput                               computing_timer;
 };
 
@@ -59,18 +125,44 @@ template <int dim>
 Simulator<dim>::Simulator(std::string input_file_name_)
     :
     mpi_communicator(MPI_COMM_WORLD),
-    triangulation(mpi_communicator),
     pcout(std::cout, (Utilities::MPI::this_mpi_process(mpi_communicator) == 0)),
     model(mpi_communicator, pcout),
-    pressure_solver(mpi_communicator, triangulation, model, pcout),
     input_file(input_file_name_),
-    output_helper(mpi_communicator, triangulation)
+    triangulation(mpi_communicator, Triangulation<dim>::none, read_input()),
+    pressure_solver(mpi_communicator, triangulation, model, pcout),
+    elastic_solver(mpi_communicator, triangulation, model, pcout),
+    multirate_coupling(mpi_communicator, model),
+    pressure_guess(mpi_communicator, model),
+    output_helper(mpi_communicator, triangulation),
+    load_balancer(mpi_communicator, triangulation, model, pcout)
     // ,computing_timer(mpi_communicator, pcout,
     //                 TimerOutput::summary, TimerOutput::wall_times)
 {}
 
 
 
+template <int dim>
+typename parallel::distributed::Triangulation<dim>::Settings
+Simulator<dim>::read_input()
+{
+  Parsers::Reader reader(pcout, model);
+  reader.read_input(input_file, /* verbosity= */0);
+
+  /* Level cells are needed only by the mechanics on a coarse level and
+   * by the geometric multigrid of the matrix-free elasticity. The cell
+   * multigrid of the pressure merges siblings of active cells and does
+   * not use level ownership. The hierarchy makes every refinement and
+   * repartition more expensive, so it is off otherwise.
+   */
+  if (model.has_mechanics() &&
+      (model.mechanics_level >= 0 ||
+       model.elastic_solver_type == Model::ElasticSolverType::MatrixFreeGMG))
+    return parallel::distributed::Triangulation<dim>::construct_multigrid_hierarchy;
+  return parallel::distributed::Triangulation<dim>::default_setting;
+}  // eom
+
+
+
 template <int dim>
 void Simulator<dim>::create_mesh()
 {
@@ -111,27 +203,343 @@ void Simulator<dim>::read_mesh()
 template <int dim>
 void Simulator<dim>::refine_mesh()
 {
-  typename Triangulation<dim>::active_cell_iterator
-      cell = triangulation.begin_active(),
-      endc = triangulation.end();
+  /* Static refinement before the dofs are distributed:
+   * refine globally, then refine the cells inside the local
+   * prerefinement boxes, near the well trajectories,
+   * and along the initial water-oil contact.
+   * Each criterion is applied for its own number of levels
+   */
+  if (model.initial_refinement_level > 0)
+    triangulation.refine_global(model.initial_refinement_level);
+
+  const int n_steps = std::max(model.n_box_refinement_levels,
+                               std::max(model.n_well_refinement_levels,
+                                        model.n_contact_refinement_levels));
+
+  for (int step=0; step<n_steps; ++step)
+  {
+    unsigned int n_flagged = 0;
 
-  for (;cell != endc; ++cell)
-    if (!cell->is_artificial())
-    {
-      if (
-              abs(cell->center()[0] - 1.5) < DefaultValues::small_number
-              &&
-              abs(cell->center()[1] - 2.5) < DefaultValues::small_number
-          )
+    typename Triangulation<dim>::active_cell_iterator
+        cell = triangulation.begin_active(),
+        endc = triangulation.end();
+
+    for (;cell != endc; ++cell)
+      if (cell->is_locally_owned())
       {
-        cell->set_refine_flag();
-        break;
-      }
+        const Point<dim> center = cell->center();
+        // so that the cells merely touching a region are refined as well
+        const double h = 0.5*cell->diameter();
+        bool refine = false;
+
+        if (step < model.n_box_refinement_levels)
+          refine = model.in_local_prerefinement_region(center, h);
+
+        if (!refine && step < model.n_well_refinement_levels)
+          for (const auto & well : model.wells)
+            if (well.distance(center) < model.well_refinement_radius + h)
+            {
+              refine = true;
+              break;
+            }
+
+        if (!refine && step < model.n_contact_refinement_levels)
+          refine = std::abs(center[2] - model.contact_depth) <
+              0.5*model.contact_refinement_thickness + h;
+
+        if (refine)
+        {
+          cell->set_refine_flag();
+          n_flagged++;
+        }
+      }  // end cell loop
+
+    if (Utilities::MPI::sum(n_flagged, mpi_communicator) == 0)
+      break;
+
+    triangulation.execute_coarsening_and_refinement();
+  }  // end refinement steps
+
+  pcout << "Active cells " << triangulation.n_global_active_cells() << std::endl;
+} // eom
+
+
+
+template <int dim>
+void
+Simulator<dim>::
+repartition(FluidSolvers::SaturationSolver<dim> &saturation_solver)
+{
+  const unsigned int n_phases = model.n_phases();
+  const auto & dof_handler = pressure_solver.get_dof_handler();
+
+  if (saturation_exchange.in_progress())
+    saturation_exchange.finish();
+
+  // relevant vectors to transfer: pressure and saturations
+  std::vector<const TrilinosWrappers::MPI::Vector*> old_vectors(n_phases + 1);
+  old_vectors[0] = &pressure_solver.relevant_solution;
+  for (unsigned int c=0; c<n_phases; ++c)
+    old_vectors[c+1] = &saturation_solver.relevant_solution[c];
+
+  /* coupled models: reference pressure and displacements move as well.
+   * Level displacements cannot be transferred, so with a mechanics
+   * level the strain itself is moved
+   */
+  TrilinosWrappers::MPI::Vector relevant_reference_pressure,
+                                relevant_strain;
+  parallel::distributed::SolutionTransfer<dim, TrilinosWrappers::MPI::Vector>
+      displacement_transfer(elastic_solver.get_dof_handler());
+  if (model.has_mechanics())
+  {
+    relevant_reference_pressure.reinit(pressure_solver.locally_relevant_dofs,
+                                       mpi_communicator);
+    relevant_reference_pressure = reference_pressure;
+    old_vectors.push_back(&relevant_reference_pressure);
+    if (elastic_solver.on_coarse_level())
+    {
+      relevant_strain.reinit(pressure_solver.locally_relevant_dofs,
+                             mpi_communicator);
+      relevant_strain = volumetric_strain;
+      old_vectors.push_back(&relevant_strain);
     }
+    else
+      displacement_transfer.prepare_for_coarsening_and_refinement
+          (elastic_solver.relevant_solution);
+  }
 
-  triangulation.prepare_coarsening_and_refinement();
-  triangulation.execute_coarsening_and_refinement();
-} // eom
+  parallel::distributed::SolutionTransfer<dim, TrilinosWrappers::MPI::Vector>
+      solution_transfer(dof_handler);
+  solution_transfer.prepare_for_coarsening_and_refinement(old_vectors);
+
+  // cell weights are queried from the load balancer
+  triangulation.repartition();
+
+  pressure_solver.setup_dofs();
+  saturation_solver.setup_dofs(pressure_solver.locally_owned_dofs,
+                               pressure_solver.locally_relevant_dofs);
+  if (model.has_mechanics())
+    setup_mechanics(saturation_solver);
+
+  std::vector<TrilinosWrappers::MPI::Vector*> new_vectors(n_phases + 1);
+  new_vectors[0] = &pressure_solver.solution;
+  for (unsigned int c=0; c<n_phases; ++c)
+    new_vectors[c+1] = &saturation_solver.solution[c];
+  if (model.has_mechanics())
+    new_vectors.push_back(&reference_pressure);
+  if (model.has_mechanics() && elastic_solver.on_coarse_level())
+    new_vectors.push_back(&volumetric_strain);
+  solution_transfer.interpolate(new_vectors);
+
+  if (model.has_mechanics())
+  {
+    if (!elastic_solver.on_coarse_level())
+    {
+      displacement_transfer.interpolate(elastic_solver.solution);
+      elastic_solver.relevant_solution = elastic_solver.solution;
+      elastic_solver.get_volumetric_strain(dof_handler, volumetric_strain);
+    }
+    old_volumetric_strain = volumetric_strain;
+  }
+
+  setup_ghost_exchange(saturation_solver);
+  field_exchange.update_ghosts();
+  pressure_solver.old_solution = pressure_solver.relevant_solution;
+  // the stored solutions live on the old partition
+  pressure_guess.reinit(pressure_solver.locally_owned_dofs);
+  if (model.max_sfi_steps > 0)
+  { // iterates of the sequential implicit loop
+    pressure_iterate.reinit(pressure_solver.locally_owned_dofs, mpi_communicator);
+  }
+
+  model.locate_wells(dof_handler);
+  load_balancer.reinit(/* mesh_changed = */ false);
+  if (model.load_balancing.group_well_cells)
+    pcout << "Well cells shared by up to "
+          << load_balancer.max_well_processes() << " processes" << std::endl;
+}  // eom
+
+
+
+template <int dim>
+void
+Simulator<dim>::
+setup_ghost_exchange(FluidSolvers::SaturationSolver<dim> &saturation_solver)
+{
+  pressure_exchange.reinit(pressure_solver.solution,
+                           pressure_solver.relevant_solution);
+  pressure_exchange.add_vector(pressure_solver.solution,
+                               pressure_solver.relevant_solution);
+
+  // one plan for all exchanges: they share the partitionings
+  saturation_exchange.reinit(pressure_exchange);
+  for (unsigned int c=0; c<saturation_solver.n_phases; ++c)
+    saturation_exchange.add_vector(saturation_solver.solution[c],
+                                   saturation_solver.relevant_solution[c]);
+
+  field_exchange.reinit(pressure_exchange);
+  field_exchange.add_vector(pressure_solver.solution,
+                            pressure_solver.relevant_solution);
+  for (unsigned int c=0; c<saturation_solver.n_phases; ++c)
+    field_exchange.add_vector(saturation_solver.solution[c],
+                              saturation_solver.relevant_solution[c]);
+}  // eom
+
+
+
+template <int dim>
+void
+Simulator<dim>::
+setup_mechanics(FluidSolvers::SaturationSolver<dim> &saturation_solver)
+{
+  elastic_solver.setup_dofs();
+
+  const IndexSet & owned_dofs = pressure_solver.locally_owned_dofs;
+  volumetric_strain.reinit(owned_dofs, mpi_communicator);
+  old_volumetric_strain.reinit(owned_dofs, mpi_communicator);
+  reference_pressure.reinit(owned_dofs, mpi_communicator);
+  pressure_iterate.reinit(owned_dofs, mpi_communicator);
+  multirate_coupling.reinit(owned_dofs);
+
+  pressure_solver.volumetric_strain = &volumetric_strain;
+  pressure_solver.old_volumetric_strain = &old_volumetric_strain;
+  saturation_solver.volumetric_strain = &volumetric_strain;
+  saturation_solver.old_volumetric_strain = &old_volumetric_strain;
+}  // eom
+
+
+
+template <int dim>
+unsigned int
+Simulator<dim>::solve_pressure(const double time)
+{
+  if (!pressure_guess.active())
+    return pressure_solver.solve();
+
+  /* the comparison solve works on a copy and without the deflation
+   * space, so the warm-started solve below is not affected by it
+   */
+  if (model.compare_pressure_guess)
+  {
+    const unsigned int n_cold_iterations = pressure_solver.count_cold_iterations();
+    pcout << "Pressure solver " << n_cold_iterations
+          << " iterations without warm start" << std::endl;
+  }
+
+  pressure_guess.predict(time, pressure_solver.solution);
+  if (pressure_solver.matrix_free())
+    pressure_guess.project(pressure_solver.get_operator(),
+                           pressure_solver.get_rhs_vector(),
+                           pressure_solver.solution);
+  else
+    pressure_guess.project(pressure_solver.get_system_matrix(),
+                           pressure_solver.get_rhs_vector(),
+                           pressure_solver.solution);
+  return pressure_solver.solve();
+}  // eom
+
+
+
+template <int dim>
+template <Model::ModelType type>
+void
+Simulator<dim>::
+solve_fixed_stress(CellValues::CellValuesBase<dim,type> &cell_values,
+                   CellValues::CellValuesBase<dim,type> &neighbor_values,
+                   const double                          time_step,
+                   FluidSolvers::SaturationSolver<dim>  &saturation_solver)
+{
+  const auto & flow_dof_handler = pressure_solver.get_dof_handler();
+
+  for (int fss_step=0; fss_step<model.max_fss_steps; ++fss_step)
+  {
+    pressure_iterate = pressure_solver.solution;
+
+    // the volumetric strain of the last iterate enters the flow equation
+    pressure_solver.assemble_system(cell_values, neighbor_values,
+                                    time_step,
+                                    saturation_solver.relevant_solution,
+                                    &saturation_exchange, &model.wells);
+    const unsigned int n_pressure_iterations = pressure_solver.solve();
+    pressure_exchange.update_ghosts();
+
+    elastic_solver.assemble_rhs(flow_dof_handler,
+                                pressure_solver.relevant_solution,
+                                reference_pressure);
+    const unsigned int n_iterations = elastic_solver.solve();
+    elastic_solver.get_volumetric_strain(flow_dof_handler, volumetric_strain);
+
+    // relative pressure change in the iteration
+    pressure_iterate -= pressure_solver.solution;
+    const double error = pressure_iterate.linfty_norm() /
+        pressure_solver.solution.linfty_norm();
+
+    pcout << "FSS iteration " << fss_step
+          << "\terror " << error
+          << "\tpressure iterations " << n_pressure_iterations
+          << "\telasticity iterations " << n_iterations
+          << std::endl;
+
+    if (error < model.fss_tolerance)
+      break;
+  }  // end fss loop
+}  // eom
+
+
+
+template <int dim>
+template <Model::ModelType type>
+unsigned int
+Simulator<dim>::
+solve_sequential_implicit(CellValues::CellValuesBase<dim,type>       &cell_values,
+                          CellValues::CellValuesBase<dim,type>       &neighbor_values,
+                          CellValues::CellValuesSaturation<dim,type> &saturation_values,
+                          const double                                time,
+                          const double                                time_step,
+                          FluidSolvers::SaturationSolver<dim>        &saturation_solver)
+{
+  for (int sfi_step=0; sfi_step<model.max_sfi_steps; ++sfi_step)
+  {
+    pressure_iterate = pressure_solver.solution;
+
+    // mobilities of the last saturation iterate
+    pressure_solver.assemble_system(cell_values, neighbor_values,
+                                    time_step,
+                                    saturation_solver.relevant_solution,
+                                    &saturation_exchange, &model.wells);
+    // the preconditioner of the first iteration is kept for the step
+    const unsigned int n_pressure_iterations =
+        (sfi_step == 0) ? solve_pressure(time) : pressure_solver.solve(true);
+    pressure_exchange.start();
+
+    // the saturation change in the iteration is reduced in the update sweep
+    const double saturation_error =
+        saturation_solver.solve(saturation_values,
+                                pressure_solver.get_faces(),
+                                time_step,
+                                pressure_solver.relevant_solution,
+                                pressure_solver.old_solution,
+                                &pressure_exchange);
+    saturation_exchange.start();
+
+    // relative pressure change in the iteration
+    pressure_iterate -= pressure_solver.solution;
+    const double pressure_error = pressure_iterate.linfty_norm() /
+        pressure_solver.solution.linfty_norm();
+
+    pcout << "SFI iteration " << sfi_step
+          << "\tpressure error " << pressure_error
+          << "\tsaturation error " << saturation_error
+          << "\tpressure iterations " << n_pressure_iterations
+          << std::endl;
+
+    if (pressure_error < model.sfi_tolerance &&
+        saturation_error < model.sfi_saturation_tolerance)
+      return sfi_step + 1;
+  }  // end sfi loop
+
+  return 0;
+}  // eom
 
 
 
@@ -142,6 +550,16 @@ field_report(const double time,
              const unsigned int time_step_number,
              const FluidSolvers::SaturationSolver<dim> &saturation_solver)
 {
+  // reduced by the saturation update, no pass over the cells here
+  if (model.n_phases() > 1)
+  {
+    const FluidSolvers::SaturationSummary &summary = saturation_solver.get_summary();
+    pcout << "Water in place " << summary.water_in_place
+          << ", Sw in [" << summary.min_saturation
+          << ", " << summary.max_saturation << "]"
+          << std::endl;
+  }
+
   DataOut<dim> data_out;
 
   data_out.attach_dof_handler(pressure_solver.get_dof_handler());
@@ -149,6 +567,9 @@ field_report(const double time,
                            DataOut<dim>::type_dof_data);
   data_out.add_data_vector(saturation_solver.relevant_solution[0], "Sw",
                            DataOut<dim>::type_dof_data);
+  if (model.has_mechanics())
+    data_out.add_data_vector(volumetric_strain, "volumetric_strain",
+                             DataOut<dim>::type_dof_data);
   data_out.build_patches();
 
   output_helper.write_output(time, time_step_number, data_out);
@@ -160,13 +581,12 @@ field_report(const double time,
 template <int dim>
 void Simulator<dim>::run()
 {
-  Parsers::Reader reader(pcout, model);
-  reader.read_input(input_file, /* verbosity= */0);
   output_helper.set_case_name("solution");
 
 
   read_mesh();
   // create_mesh();
+  refine_mesh();
 
   output_helper.prepare_output_directories();
 
@@ -177,107 +597,226 @@ void Simulator<dim>::run()
 
   pressure_solver.setup_dofs();
 
-  // tolerance for parameter check
-  const double tol_p  = DefaultValues::small_number;
-  { // test permeability function
-    // first and last points have 1000 md perm, others - 50 md
-    const double md = model.units.permeability();
-    const double ft = model.units.length();
-    const double k1 = model.get_permeability->value(Point<dim>(0.0, 0.0, 0.0));
-    AssertThrow(Math::relative_difference(k1, 1000*md) < tol_p,
-                ExcMessage("bug in relperm function"));
-    // std::cout << k1/md << std::endl;
-    const double k2 = model.get_permeability->value(Point<dim>(6*ft, 0.0, 0.0));
-    AssertThrow(Math::relative_difference(k2, 50*md) < tol_p,
-                ExcMessage("bug in relperm function"));
-    const double k4 = model.get_permeability->value(Point<dim>(500*ft, 0.0, 0.0));
-    AssertThrow(Math::relative_difference(k4, 50*md) < tol_p,
-                ExcMessage("bug in relperm function"));
-    // std::cout << k2/md << std::endl;
-    const double k3 = model.get_permeability->value(Point<dim>(510*ft, 0.0, 0.0));
-    AssertThrow(Math::relative_difference(k3, 1000*md) < tol_p,
-                ExcMessage("bug in relperm function"));
-    // std::cout << k3/md << std::endl;
-  }
-
   // if multiphase
   saturation_solver.setup_dofs(pressure_solver.locally_owned_dofs,
                                pressure_solver.locally_relevant_dofs);
 
 
   // initial values
-  for (unsigned int i=0; i<saturation_solver.solution[0].size(); ++i)
-  {
-    saturation_solver.solution[0][i] =model.residual_saturation_water();
-    pressure_solver.solution = 1000*model.units.pressure();
-    // pressure_solver.solution = 1e8;
+  saturation_solver.solution[0] = model.residual_saturation_water();
+  pressure_solver.solution = 1000*model.units.pressure();
+  // pressure_solver.solution = 1e8;
+
+  setup_ghost_exchange(saturation_solver);
+  field_exchange.update_ghosts();
+  pressure_guess.reinit(pressure_solver.locally_owned_dofs);
+  if (model.max_sfi_steps > 0)
+  { // iterates of the sequential implicit loop
+    pressure_iterate.reinit(pressure_solver.locally_owned_dofs, mpi_communicator);
   }
-  pressure_solver.relevant_solution = pressure_solver.solution;
-  saturation_solver.relevant_solution[0] = saturation_solver.solution[0];
 
-  model.locate_wells(pressure_solver.get_dof_handler());
+  if (model.has_mechanics())
+  { // the initial state is stress-free
+    setup_mechanics(saturation_solver);
+    reference_pressure = pressure_solver.solution;
+    volumetric_strain = 0;
+    old_volumetric_strain = 0;
+  }
 
-  CellValues::CellValuesBase<dim> cell_values_pressure(model),
-                                  neighbor_values_pressure(model);
-  CellValues::CellValuesSaturation<dim> cell_values_saturation(model);
+  model.locate_wells(pressure_solver.get_dof_handler());
 
-  FEFunction::FEFunction<dim,TrilinosWrappers::MPI::Vector>
-      pressure_function(pressure_solver.get_dof_handler(),
-                        pressure_solver.relevant_solution);
-  FEFunction::FEFunction<dim,TrilinosWrappers::MPI::Vector>
-      saturation_function(pressure_solver.get_dof_handler(),
-                          saturation_solver.relevant_solution);
+  load_balancer.reinit();
+  if (model.load_balancing.type == Model::LoadBalancingType::MeasuredBalancing)
+    pressure_solver.cell_costs = &load_balancer.get_cell_costs();
+  if (load_balancer.needs_repartition())
+    repartition(saturation_solver);
 
+  switch (model.fluid_model_type())
   {
-    Vector<double> sat(2);
-    std::vector<double> rperm(2);
-    sat[0] = 0.2;
-    sat[1] = 0.8;
-    model.get_relative_permeability(sat, rperm);
-    AssertThrow(rperm[0] < DefaultValues::small_number,
-                ExcMessage("bug in rel perm"));
-    AssertThrow(Math::relative_difference(rperm[1], 0.8)  < DefaultValues::small_number,
-                ExcMessage("bug in rel perm"));
+    case Model::ModelType::SingleLiquid:
+      run_time_loop<Model::ModelType::SingleLiquid>(saturation_solver);
+      break;
+    case Model::ModelType::WaterOil:
+      run_time_loop<Model::ModelType::WaterOil>(saturation_solver);
+      break;
+    default:
+      AssertThrow(false, ExcNotImplemented());
   }
+} // eom
+
+
+
+template <int dim>
+template <Model::ModelType type>
+void
+Simulator<dim>::
+run_time_loop(FluidSolvers::SaturationSolver<dim> &saturation_solver)
+{
+  CellValues::CellValuesBase<dim,type> cell_values_pressure(model),
+                                       neighbor_values_pressure(model);
+  CellValues::CellValuesSaturation<dim,type> cell_values_saturation(model);
 
   double time = 0;
   double time_step = model.min_time_step;
   unsigned int time_step_number = 0;
+  // halvings of the time step after unconverged sequential implicit steps
+  const unsigned int max_time_step_cuts = 8;
+  unsigned int n_time_step_cuts = 0;
 
   while(time <= model.t_max)
   {
     time += time_step;
-    pressure_solver.old_solution = pressure_solver.solution;
+    // local copy: relevant_solution is up to date after the last step
+    pressure_solver.old_solution = pressure_solver.relevant_solution;
+    if (model.has_mechanics())
+      old_volumetric_strain = volumetric_strain;
+    if (model.max_sfi_steps > 0)
+    { // the saturation of the step start is kept for the iterations
+      if (saturation_exchange.in_progress())
+        saturation_exchange.finish();
+      for (unsigned int c=0; c<saturation_solver.n_phases; ++c)
+        saturation_solver.old_solution[c] = saturation_solver.relevant_solution[c];
+    }
 
     pcout << "time " << time << std::endl;
+    // the well productivities are evaluated in the pressure assembly
     model.update_well_controls(time);
-    model.update_well_productivities(pressure_function, saturation_function);
 
+    if (model.has_mechanics() &&
+        multirate_coupling.needs_update(pressure_solver.solution))
+    { // solve for pressure and displacement
+      multirate_coupling.extrapolate(time, volumetric_strain);
+      // warm start of the first fixed-stress iteration
+      if (pressure_guess.active())
+        pressure_guess.predict(time, pressure_solver.solution);
+      solve_fixed_stress(cell_values_pressure, neighbor_values_pressure,
+                         time_step, saturation_solver);
+      const double lag = multirate_coupling.update(time, volumetric_strain,
+                                                   pressure_solver.solution);
+      pcout << "Mechanics lag " << lag << std::endl;
+      if (lag > model.mechanics_lag_tolerance)
+        pcout << "Warning: mechanics lag exceeds the tolerance "
+              << model.mechanics_lag_tolerance
+              << ", consider a smaller " << Keywords::mechanics_interval
+              << std::endl;
+      multirate_coupling.advance();
+    }
+    else if (model.has_mechanics())
+    { // solve for pressure with the extrapolated strain
+      multirate_coupling.extrapolate(time, volumetric_strain);
+      // a single pass: no fixed-stress term on top of the strain increment
+      cell_values_pressure.fixed_stress = false;
+      neighbor_values_pressure.fixed_stress = false;
+      pressure_solver.assemble_system(cell_values_pressure, neighbor_values_pressure,
+                                      time_step,
+                                      saturation_solver.relevant_solution,
+                                      &saturation_exchange, &model.wells);
+      cell_values_pressure.fixed_stress = true;
+      neighbor_values_pressure.fixed_stress = true;
+      const unsigned int n_iterations = solve_pressure(time);
+      pcout << "Pressure solver " << n_iterations << " iterations" << std::endl;
+      pressure_exchange.start();
+      multirate_coupling.advance();
+    }
+    else if (model.max_sfi_steps > 0)
+    { // solve for pressure and saturation until both converge
+      const unsigned int n_iterations =
+          solve_sequential_implicit(cell_values_pressure, neighbor_values_pressure,
+                                    cell_values_saturation, time, time_step,
+                                    saturation_solver);
+      if (n_iterations == 0)
+      { // repeat the step from the old state with half the step
+        AssertThrow(n_time_step_cuts < max_time_step_cuts,
+                    ExcMessage("Sequential implicit iterations do not converge"));
+        if (saturation_exchange.in_progress())
+          saturation_exchange.finish();
+        pressure_solver.relevant_solution = pressure_solver.old_solution;
+        pressure_solver.solution = pressure_solver.old_solution;
+        for (unsigned int c=0; c<saturation_solver.n_phases; ++c)
+        {
+          saturation_solver.relevant_solution[c] = saturation_solver.old_solution[c];
+          saturation_solver.solution[c] = saturation_solver.old_solution[c];
+        }
+        time -= time_step;
+        time_step *= 0.5;
+        n_time_step_cuts++;
+        pcout << "Time step cut to " << time_step << std::endl;
+        continue;
+      }
+      pcout << "SFI converged in " << n_iterations << " iterations" << std::endl;
+      // grow back to the input step after a cut
+      n_time_step_cuts = 0;
+      time_step = std::min(2*time_step, model.min_time_step);
+    }
+    else
     { // solve for pressure
+      // the saturation ghost update from the last step completes in here
       pressure_solver.assemble_system(cell_values_pressure, neighbor_values_pressure,
                                       time_step,
-                                      saturation_solver.relevant_solution);
-      pressure_solver.solve();
-      pressure_solver.relevant_solution = pressure_solver.solution;
+                                      saturation_solver.relevant_solution,
+                                      &saturation_exchange, &model.wells);
+      const unsigned int n_iterations = solve_pressure(time);
+      pcout << "Pressure solver " << n_iterations << " iterations" << std::endl;
+      pressure_exchange.start();
     }
 
+    pressure_guess.record(time, pressure_solver.solution);
+
+    // single-phase models have no saturation equation
+    if (Model::ModelTraits<type>::n_phases > 1 &&
+        (model.has_mechanics() || model.max_sfi_steps == 0))
     { // solve for saturation
+      // interior faces are summed while the pressure ghosts are in flight
       saturation_solver.solve(cell_values_saturation,
-                              neighbor_values_pressure,
+                              pressure_solver.get_faces(),
                               time_step,
                               pressure_solver.relevant_solution,
-                              pressure_solver.old_solution);
-      saturation_solver.relevant_solution[0] = saturation_solver.solution[0];
-      saturation_solver.relevant_solution[1] = saturation_solver.solution[1];
+                              pressure_solver.old_solution,
+                              &pressure_exchange);
+      saturation_exchange.start();
     }
-
+    else if (pressure_exchange.in_progress())
+      pressure_exchange.finish();
 
     field_report(time, time_step_number, saturation_solver);
 
+    if (load_balancer.needs_repartition())
+      repartition(saturation_solver);
+
     time_step_number++;
   } // end time loop
 
+  if (saturation_exchange.in_progress())
+    saturation_exchange.finish();
+
 } // eom
 
 
+
+template <int dim>
+const DoFHandler<dim> &
+Simulator<dim>::get_dof_handler()
+{
+  return pressure_solver.get_dof_handler();
+}  // eom
+
+
+
+template <int dim>
+const TrilinosWrappers::MPI::Vector &
+Simulator<dim>::get_pressure() const
+{
+  return pressure_solver.solution;
+}  // eom
+
+
+
+template <int dim>
+const TrilinosWrappers::MPI::Vector &
+Simulator<dim>::get_volumetric_strain() const
+{
+  return volumetric_strain;
+}  // eom
+
+
 } // end of namespace
@@ -98,7 +98,7 @@ namespace Parsers
   {
     try
     {
-      get_int(kwd);
+      return get_int(kwd);
     }
     catch (std::exception &exc)
     {
@@ -8,6 +8,7 @@
 #include <deal.II/fe/fe_values.h>
 #include <deal.II/base/quadrature_lib.h>
 #include <math.h>
+#include <limits>
 
 #include <DefaultValues.h>
 #include <Schedule.hpp>
@@ -44,11 +45,13 @@ class Wellbore : public Function<dim>
   // get current controlling parameters
   const Schedule::WellControl           & get_control();
   // get cells where the wellbore is placed
-  const  std::vector<CellIterator<dim>> & get_cells();
+  const  std::vector<CellIterator<dim>> & get_cells() const;
   // get true coordinates of the welbore
   const  std::vector< Point<dim> >      & get_locations();
   // vector of phase productivities for each cell
   std::vector< std::vector<double> >    & get_productivities();
+  // shortest distance from a point to the wellbore trajectory
+  double distance(const Point<dim> &p) const;
 
   // update methods
   /*
@@ -84,6 +87,17 @@ class Wellbore : public Function<dim>
    */
   void update_productivity(const Function<dim> &get_pressure,
                            const Function<dim> &get_saturation);
+  /*
+   * The same in two parts, for the cell sweep of the pressure assembly:
+   * productivities of one cell from its pressure and phase saturations
+   * (nothing if the well is not in the cell), then the sum over the
+   * processes, which must follow before get_J_and_Q of rate-controlled
+   * wells (collective)
+   */
+  void update_cell_productivity(const CellIterator<dim> &cell,
+                                const double             pressure,
+                                const Vector<double>    &saturation);
+  void sum_productivities();
   /*
    * This method is a modification of the deal.ii method to check
    * whether a point is inside a cell. It allows for some hard-coded
@@ -95,6 +109,10 @@ class Wellbore : public Function<dim>
 
 
  private:
+  // productivities of the i-th well cell
+  void compute_cell_productivity(const unsigned int    i,
+                                 const double          pressure,
+                                 const Vector<double> &saturation);
   // equation for the absolute (non-phase) productivity index
   double compute_productivity(const double k1, const double k2,
                               const double dx1, const double dx2,
@@ -117,8 +135,8 @@ class Wellbore : public Function<dim>
   /*
    * Same as the previous method but for a vector of cells
    */
-  std::vector< Tensor<1,dim> >
-  get_cell_sizes(const std::vector<CellIterator<dim>> &cells_) const;
+  void get_cell_sizes(const std::vector<CellIterator<dim>> &cells_,
+                      std::vector< Tensor<1,dim> >         &h) const;
 
   // Check if the list of wellbore cells contains the cell
   int find_cell(const CellIterator<dim> & cell) const;
@@ -153,6 +171,11 @@ class Wellbore : public Function<dim>
   std::vector< Tensor<1,dim> >       segment_direction;
   std::vector< std::vector<double> > productivities;
   Vector<double>                     total_productivity;
+  // cell sizes are fixed between the calls to locate()
+  std::vector< Tensor<1,dim> >       cell_sizes;
+  // scratch storage for update_productivity
+  Vector<double>                     perm, saturation;
+  std::vector<double>                rel_perm, pvt_values;
 };  // eom
 
 
@@ -171,7 +194,11 @@ Wellbore<dim>::Wellbore(const std::vector< Point<dim> >&                      lo
     relative_permeability(relative_permeability),
     pvt_tables(pvt_tables),
     n_phases(pvt_tables.size()),
-    total_productivity(n_phases)
+    total_productivity(n_phases),
+    perm(dim),
+    saturation(n_phases),
+    rel_perm(n_phases),
+    pvt_values(pvt_tables[0]->n_cols()) // size first pvt table
 {
   // AssertThrow(pvt_tables.size() == 2, ExcMessage("how many phases do you have man?"));
   AssertThrow(locations.size() > 0,
@@ -221,7 +248,7 @@ Wellbore<dim>::get_radius() const
 template <int dim>
 inline
 const std::vector<CellIterator<dim>> &
-Wellbore<dim>::get_cells()
+Wellbore<dim>::get_cells() const
 {
   return cells;
 }  // eom
@@ -311,7 +338,10 @@ void Wellbore<dim>::locate(const DoFHandler<dim>& dof_handler)
   FESubfaceValues<dim> fe_subface_values(fe, face_quadrature_formula,
                                          update_normal_vectors);
 
+  // the well can be relocated after the mesh changes
   cells.clear();
+  segment_length.clear();
+  segment_direction.clear();
 
   typename DoFHandler<dim>::active_cell_iterator
 		  cell = dof_handler.begin_active(),
@@ -343,8 +373,8 @@ void Wellbore<dim>::locate(const DoFHandler<dim>& dof_handler)
           segment_direction.push_back(direction);
           std::vector<CellIterator<dim>> cell_container(1);
           cell_container[0] = cell;
-          const std::vector<Tensor<1,dim>> h =
-              get_cell_sizes(cell_container);
+          std::vector<Tensor<1,dim>> h;
+          get_cell_sizes(cell_container, h);
           segment_length.push_back(h[0][2]);
 
           // cell = endc;
@@ -497,6 +527,10 @@ void Wellbore<dim>::locate(const DoFHandler<dim>& dof_handler)
         } // end loop segments
 
     }  // end cell loop
+
+  // storage for update_productivity, so it does not allocate
+  get_cell_sizes(cells, cell_sizes);
+  productivities.assign(cells.size(), std::vector<double>(n_phases));
 }  // eom
 
 
@@ -635,9 +669,10 @@ Wellbore<dim>::get_cell_size(FEFaceValues<dim> &fe_face_values,
 
 
 template <int dim>
-std::vector< Tensor<1,dim> >
+void
 Wellbore<dim>::
-get_cell_sizes(const std::vector<CellIterator<dim>> &cells_) const
+get_cell_sizes(const std::vector<CellIterator<dim>> &cells_,
+               std::vector< Tensor<1,dim> >         &h) const
 { // compute cell sizes for the cells in the cells_ vector
   /*
     Loop cells, loop faces, find minimum and maximum coordinate
@@ -650,7 +685,7 @@ get_cell_sizes(const std::vector<CellIterator<dim>> &cells_) const
                                    update_quadrature_points);
   // We can't do dim here, because we need all three dimensions
   // for the productivity calculation
-  std::vector< Tensor<1,dim> > h(cells.size()); //
+  h.resize(cells_.size());
   int counter = 0;
 
   for (const auto & cell : cells_)
@@ -658,8 +693,28 @@ get_cell_sizes(const std::vector<CellIterator<dim>> &cells_) const
     get_cell_size(fe_face_values, cell, h[counter]);
     counter++;
   }  // end cell loop
+}  // eom
+
+
 
-  return h;
+template <int dim>
+double
+Wellbore<dim>::distance(const Point<dim> &p) const
+{
+  if (locations.size() == 1)
+    return p.distance(locations[0]);
+
+  double result = std::numeric_limits<double>::max();
+  for (unsigned int i=1; i<locations.size(); i++)
+  {
+    const Tensor<1,dim> a = locations[i] - locations[i-1];
+    // projection of p onto the segment clipped to its end points
+    double t = scalar_product(p - locations[i-1], a) / a.norm_square();
+    t = std::max(0.0, std::min(t, 1.0));
+    const Point<dim> d = locations[i-1] + t*a;
+    result = std::min(result, p.distance(d));
+  }
+  return result;
 }  // eom
 
 
@@ -677,6 +732,45 @@ template <int dim>
 void Wellbore<dim>::
 update_productivity(const Function<dim> &get_pressure,
                     const Function<dim> &get_saturation)
+{
+  // cell sizes and productivity storage are set up in locate()
+  AssertThrow(productivities.size() == cells.size(),
+              ExcDimensionMismatch(productivities.size(), cells.size()));
+
+  for (unsigned int i=0; i<cells.size(); i++)
+  {
+    if (n_phases > 1)
+      get_saturation.vector_value(cells[i]->center(), saturation);
+    compute_cell_productivity(i, get_pressure.value(cells[i]->center()),
+                              saturation);
+  }  // end cell loop
+
+  sum_productivities();
+}  // eom
+
+
+
+template <int dim>
+void Wellbore<dim>::
+update_cell_productivity(const CellIterator<dim> &cell,
+                         const double             pressure,
+                         const Vector<double>    &cell_saturation)
+{
+  const int segment = find_cell(cell);
+  if (segment == -1)
+    return;
+  AssertThrow(productivities.size() == cells.size(),
+              ExcDimensionMismatch(productivities.size(), cells.size()));
+  compute_cell_productivity(segment, pressure, cell_saturation);
+}  // eom
+
+
+
+template <int dim>
+void Wellbore<dim>::
+compute_cell_productivity(const unsigned int    i,
+                          const double          pressure,
+                          const Vector<double> &cell_saturation)
 {
   /*
     First get cell dimensions dx dy dz
@@ -684,52 +778,41 @@ update_productivity(const Function<dim> &get_pressure,
     Then compute productivities.
     How do I normalize permeability when it's a tensor?
   */
-  Vector<double>      perm(dim);
-  Vector<double>      saturation(n_phases);
   Tensor<1,dim>       abs_productivity;
-  std::vector<double> productivity(n_phases);
-  std::vector<double> rel_perm(n_phases);
-  std::vector<double> pvt_values(pvt_tables[0]->n_cols()); // size first pvt table
-
-  productivities.clear();
-
-  const std::vector< Tensor<1,dim> > h = get_cell_sizes(cells);
-  for (unsigned int i=0; i<cells.size(); i++)
+  // cell sizes are set up in locate()
+  const std::vector< Tensor<1,dim> > &h = cell_sizes;
+
+  get_permeability.vector_value(cells[i]->center(), perm);
+  abs_productivity[0] = compute_productivity
+      (perm[1], perm[2], h[i][1], h[i][2],
+       segment_length[i]*abs(segment_direction[i][0]));
+  abs_productivity[1] = compute_productivity
+      (perm[0], perm[2], h[i][0], h[i][2],
+       segment_length[i]*abs(segment_direction[i][1]));
+  abs_productivity[2] = compute_productivity
+      (perm[0], perm[1], h[i][0], h[i][1],
+       segment_length[i]*abs(segment_direction[i][2]));
+
+  const double j_ind = abs_productivity.norm();
+
+  if (n_phases == 1)
+    rel_perm[0] = 1;
+  else // phase productivities
+    relative_permeability.get_values(cell_saturation, rel_perm);
+
+  for (int p=0; p<n_phases; ++p)
   {
-    get_permeability.vector_value(cells[i]->center(), perm);
-    abs_productivity[0] = compute_productivity
-        (perm[1], perm[2], h[i][1], h[i][2],
-         segment_length[i]*abs(segment_direction[i][0]));
-    abs_productivity[1] = compute_productivity
-        (perm[0], perm[2], h[i][0], h[i][2],
-         segment_length[i]*abs(segment_direction[i][1]));
-    abs_productivity[2] = compute_productivity
-        (perm[0], perm[1], h[i][0], h[i][1],
-         segment_length[i]*abs(segment_direction[i][2]));
-
-    const double j_ind = abs_productivity.norm();
-
-    if (n_phases == 1)
-      rel_perm[0] = 1;
-    else
-    {
-      // phase productivities
-      get_saturation.vector_value(cells[i]->center(), saturation);
-      relative_permeability.get_values(saturation, rel_perm);
-    }
-
-    const double pressure = get_pressure.value(cells[i]->center());
-    for (int p=0; p<n_phases; ++p)
-    {
-      pvt_tables[p]->get_values(pressure, pvt_values);
-      //                            volume factor viscosity
-      productivity[p] = rel_perm[p]/pvt_values[0]/pvt_values[2]*j_ind;
-    }
+    pvt_tables[p]->get_values(pressure, pvt_values);
+    //                            volume factor viscosity
+    productivities[i][p] = rel_perm[p]/pvt_values[0]/pvt_values[2]*j_ind;
+  }
+}  // eom
 
-    productivities.push_back(productivity);
 
-  }  // end cell loop
 
+template <int dim>
+void Wellbore<dim>::sum_productivities()
+{
   // get sum of productivities for normalization later on
   for (auto & p : total_productivity) p = 0;    // first set to zero
   // sum
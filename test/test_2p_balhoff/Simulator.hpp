@@ -217,9 +217,10 @@ void Simulator<dim>::run()
 
   model.locate_wells(pressure_solver.get_dof_handler());
 
-  CellValues::CellValuesBase<dim> cell_values_pressure(model),
-                                  neighbor_values_pressure(model);
-  CellValues::CellValuesSaturation<dim> cell_values_saturation(model);
+  CellValues::CellValuesBase<dim,Model::ModelType::WaterOil>
+      cell_values_pressure(model), neighbor_values_pressure(model);
+  CellValues::CellValuesSaturation<dim,Model::ModelType::WaterOil>
+      cell_values_saturation(model);
 
   FEFunction::FEFunction<dim,TrilinosWrappers::MPI::Vector>
       pressure_function(pressure_solver.get_dof_handler(),
@@ -263,7 +264,7 @@ void Simulator<dim>::run()
 
     { // solve for saturation
       saturation_solver.solve(cell_values_saturation,
-                              neighbor_values_pressure,
+                              pressure_solver.get_faces(),
                               time_step,
                               pressure_solver.relevant_solution,
                               pressure_solver.old_solution);
@@ -134,11 +134,11 @@ namespace Wings
     double time_step = model.min_time_step;
     model.update_well_controls(time);
 
-    CellValues::CellValuesBase<dim> cell_values_pressure(model),
-                                    neighbor_values_pressure(model);
+    typedef CellValues::CellValuesBase<dim,Model::ModelType::WaterOil> CellValuesWO;
+    CellValuesWO cell_values_pressure(model), neighbor_values_pressure(model);
     // pointer to cell values that are gonna be used
-    CellValues::CellValuesBase<dim>* p_cell_values = &cell_values_pressure;
-    CellValues::CellValuesBase<dim>* p_neighbor_values = &neighbor_values_pressure;
+    CellValuesWO* p_cell_values = &cell_values_pressure;
+    CellValuesWO* p_neighbor_values = &neighbor_values_pressure;
     // CellValues::CellValuesBase<dim>* p_cell_values = NULL;
     // CellValues::CellValuesBase<dim>* p_neighbor_values = NULL;
     // if (model.type == Model::ModelType::SingleLiquid)
@@ -349,12 +349,13 @@ namespace Wings
     pressure_solver.relevant_solution = pressure_solver.solution;
 
 
-    CellValues::CellValuesSaturation<dim> cell_values_saturation(model);
+    CellValues::CellValuesSaturation<dim,Model::ModelType::WaterOil>
+        cell_values_saturation(model);
 
     if (model.type != Model::ModelType::SingleLiquid)
     {
       saturation_solver.solve(cell_values_saturation,
-                              neighbor_values_pressure,
+                              pressure_solver.get_faces(),
                               time_step,
                               pressure_solver.relevant_solution,
                               pressure_solver.old_solution);
@@ -415,7 +416,7 @@ namespace Wings
     if (model.type != Model::ModelType::SingleLiquid)
     {
       saturation_solver.solve(cell_values_saturation,
-                              neighbor_values_pressure,
+                              pressure_solver.get_faces(),
                               time_step,
                               pressure_solver.relevant_solution,
                               pressure_solver.old_solution);
@@ -0,0 +1,270 @@
+/*
+  This test checks that the cell kernels of a time step do not allocate
+  memory. The input is wo-3x3.data (water-oil, three wells).
+
+  Testing:
+  the heap allocations are counted by replacing the glibc allocation
+  functions. After a warm-up step that sets up the storage, the well
+  productivity update, PressureSolver::assemble_system, and
+  SaturationSolver::solve are called with every saturation solver.
+  The calls may allocate only as much as the compress of their matrix
+  and vectors does alone.
+  Only these kernels are covered: the step is taken here, not in
+  Simulator::run_time_loop, so the time step control, the ghost
+  exchanges, the pressure guess and the output are not counted, and
+  neither are the Trilinos linear solve and compress.
+ */
+
+#include <deal.II/base/utilities.h>
+#include <deal.II/base/conditional_ostream.h>
+#include <deal.II/grid/grid_in.h>
+#include <deal.II/grid/grid_tools.h>
+#include <deal.II/distributed/tria.h>
+#include <cerrno>
+#include <cstdlib>
+
+// Custom modules
+#include <Model.hpp>
+#include <Reader.hpp>
+#include <PressureSolver.hpp>
+#include <SaturationSolver.hpp>
+#include <CellValues/CellValuesBase.hpp>
+#include <CellValues/CellValuesSaturation.hpp>
+#include <FEFunction/FEFunction.hpp>
+
+
+namespace AllocationCounter
+{
+  bool          counting = false;
+  unsigned long n_allocations = 0;
+}
+
+
+extern "C"
+{
+  void *__libc_malloc(size_t size);
+  void *__libc_calloc(size_t n, size_t size);
+  void *__libc_realloc(void *ptr, size_t size);
+  void *__libc_memalign(size_t alignment, size_t size);
+
+  void *malloc(size_t size)
+  {
+    if (AllocationCounter::counting)
+      AllocationCounter::n_allocations++;
+    return __libc_malloc(size);
+  }
+
+  void *calloc(size_t n, size_t size)
+  {
+    if (AllocationCounter::counting)
+      AllocationCounter::n_allocations++;
+    return __libc_calloc(n, size);
+  }
+
+  void *realloc(void *ptr, size_t size)
+  {
+    if (AllocationCounter::counting)
+      AllocationCounter::n_allocations++;
+    return __libc_realloc(ptr, size);
+  }
+
+  // deal.II vectors get their memory here
+  int posix_memalign(void **ptr, size_t alignment, size_t size)
+  {
+    if (AllocationCounter::counting)
+      AllocationCounter::n_allocations++;
+    *ptr = __libc_memalign(alignment, size);
+    return (*ptr == NULL) ? ENOMEM : 0;
+  }
+}
+
+
+namespace WingTest
+{
+  using namespace dealii;
+
+
+  template <int dim>
+  class TestAllocations
+  {
+  public:
+    TestAllocations(std::string);
+    void read_mesh();
+    void run();
+
+  private:
+    MPI_Comm                                  mpi_communicator;
+    parallel::distributed::Triangulation<dim> triangulation;
+    ConditionalOStream                        pcout;
+    Model::Model<dim>                         model;
+    FluidSolvers::PressureSolver<dim>         pressure_solver;
+    std::string                               input_file;
+  };
+
+
+  template <int dim>
+  TestAllocations<dim>::TestAllocations(std::string input_file_name_)
+    :
+    mpi_communicator(MPI_COMM_WORLD),
+    triangulation(mpi_communicator),
+    pcout(std::cout, (Utilities::MPI::this_mpi_process(mpi_communicator) == 0)),
+    model(mpi_communicator, pcout),
+    pressure_solver(mpi_communicator, triangulation, model, pcout),
+    input_file(input_file_name_)
+  {}
+
+
+  template <int dim>
+  void TestAllocations<dim>::read_mesh()
+  {
+    GridIn<dim> gridin;
+    gridin.attach_triangulation(triangulation);
+    std::ifstream f(model.mesh_file.string());
+    gridin.read_msh(f);
+    GridTools::scale(model.units.length(), triangulation);
+  }  // eom
+
+
+  template <int dim>
+  void TestAllocations<dim>::run()
+  {
+    Parsers::Reader reader(pcout, model);
+    reader.read_input(input_file, /* verbosity= */0);
+    read_mesh();
+
+    FluidSolvers::SaturationSolver<dim>
+        saturation_solver(mpi_communicator,
+                          pressure_solver.get_dof_handler(),
+                          model, pcout);
+    pressure_solver.setup_dofs();
+    saturation_solver.setup_dofs(pressure_solver.locally_owned_dofs,
+                                 pressure_solver.locally_relevant_dofs);
+
+    saturation_solver.solution[0] = 0.3;
+    saturation_solver.solution[1] = 0.7;
+    for (unsigned int p=0; p<saturation_solver.n_phases; ++p)
+      saturation_solver.relevant_solution[p] = saturation_solver.solution[p];
+    pressure_solver.solution = 1000*model.units.pressure();
+    pressure_solver.relevant_solution = pressure_solver.solution;
+    pressure_solver.old_solution = pressure_solver.solution;
+
+    model.update_well_controls(0);
+    model.locate_wells(pressure_solver.get_dof_handler());
+
+    const Model::ModelType type = Model::ModelType::WaterOil;
+    AssertThrow(model.fluid_model_type() == type, ExcNotImplemented());
+    CellValues::CellValuesBase<dim,type> cell_values(model),
+                                         neighbor_values(model);
+    CellValues::CellValuesSaturation<dim,type> cell_values_saturation(model);
+
+    FEFunction::FEFunction<dim,TrilinosWrappers::MPI::Vector>
+        pressure_function(pressure_solver.get_dof_handler(),
+                          pressure_solver.relevant_solution);
+    FEFunction::FEFunction<dim,TrilinosWrappers::MPI::Vector>
+        saturation_function(pressure_solver.get_dof_handler(),
+                            saturation_solver.relevant_solution);
+
+    const double time_step = model.min_time_step;
+    // allocations of the counted calls in the last step
+    unsigned long n_pressure_allocations = 0, n_saturation_allocations = 0;
+    const auto step = [&]()
+    {
+      pressure_solver.old_solution = pressure_solver.solution;
+
+      AllocationCounter::n_allocations = 0;
+      AllocationCounter::counting = true;
+      model.update_well_productivities(pressure_function, saturation_function);
+      pressure_solver.assemble_system(cell_values, neighbor_values, time_step,
+                                      saturation_solver.relevant_solution);
+      AllocationCounter::counting = false;
+      n_pressure_allocations = AllocationCounter::n_allocations;
+
+      pressure_solver.solve();
+      pressure_solver.relevant_solution = pressure_solver.solution;
+
+      AllocationCounter::n_allocations = 0;
+      AllocationCounter::counting = true;
+      saturation_solver.solve(cell_values_saturation,
+                              pressure_solver.get_faces(),
+                              time_step,
+                              pressure_solver.relevant_solution,
+                              pressure_solver.old_solution);
+      AllocationCounter::counting = false;
+      n_saturation_allocations = AllocationCounter::n_allocations;
+
+      for (unsigned int p=0; p<saturation_solver.n_phases; ++p)
+        saturation_solver.relevant_solution[p] = saturation_solver.solution[p];
+    };
+
+    /* allocations of the compress calls that end the counted ones:
+     * the assembled pressure system (on copies with the same layout)
+     * and the saturation solution
+     */
+    step();
+    TrilinosWrappers::SparseMatrix system_matrix;
+    system_matrix.copy_from(pressure_solver.get_system_matrix());
+    TrilinosWrappers::MPI::Vector rhs_vector(pressure_solver.get_rhs_vector());
+    AllocationCounter::n_allocations = 0;
+    AllocationCounter::counting = true;
+    system_matrix.compress(VectorOperation::add);
+    rhs_vector.compress(VectorOperation::add);
+    AllocationCounter::counting = false;
+    const unsigned long n_pressure_compress = AllocationCounter::n_allocations;
+
+    AllocationCounter::n_allocations = 0;
+    AllocationCounter::counting = true;
+    saturation_solver.solution[0].compress(VectorOperation::insert);
+    saturation_solver.solution[1].compress(VectorOperation::insert);
+    AllocationCounter::counting = false;
+    const unsigned long n_saturation_compress = AllocationCounter::n_allocations;
+
+    const Model::SaturationSolverType saturation_solvers[] =
+      {Model::SaturationSolverType::Explicit,
+       Model::SaturationSolverType::Reordering,
+       Model::SaturationSolverType::Adaptive,
+       Model::SaturationSolverType::LocalTimeStepping};
+    for (const auto solver_type : saturation_solvers)
+    {
+      model.saturation_solver_type = solver_type;
+      // warm-up: the first step sizes the storage
+      step();
+      step();
+
+      AssertThrow(n_pressure_allocations <= n_pressure_compress,
+                  ExcMessage(std::to_string(n_pressure_allocations - n_pressure_compress) +
+                             " heap allocations in the pressure assembly"));
+      AssertThrow(n_saturation_allocations <= n_saturation_compress,
+                  ExcMessage(std::to_string(n_saturation_allocations - n_saturation_compress) +
+                             " heap allocations in saturation solver " +
+                             std::to_string(solver_type)));
+    }
+  } // eom
+
+} // end of namespace
+
+
+int main(int argc, char *argv[])
+{
+  try
+  {
+    using namespace dealii;
+    dealii::deallog.depth_console (0);
+    Utilities::MPI::MPI_InitFinalize mpi_initialization(argc, argv, 1);
+    std::string input_file_name = SOURCE_DIR "/../data/wo-3x3.data";
+    WingTest::TestAllocations<3> problem(input_file_name);
+    problem.run();
+    return 0;
+  }
+  catch (std::exception &exc)
+    {
+      std::cerr << std::endl << std::endl
+                << "----------------------------------------------------"
+                << std::endl;
+      std::cerr << "Exception on processing: " << std::endl
+                << exc.what() << std::endl
+                << "Aborting!" << std::endl
+                << "----------------------------------------------------"
+                << std::endl;
+      return 1;
+    }
+}
@@ -0,0 +1,134 @@
+/*
+  This test runs the simulator on the single-phase coupled model
+  (SingleLiquidElasticity) with the fixed-stress split.
+  The input is column-1x1x10.data: a column of ten cells with a water
+  injector in the bottom cell. The column starts with a uniform
+  pressure, so gravity and the injection make the pressure change
+  vary along the column.
+
+  Testing:
+  Simulator::run takes the time steps, each with the fixed-stress
+  iterations. The boundary has rollers and the column is one cell
+  wide, so the displacements are vertical and the cells deform in
+  uniaxial strain like in Terzaghi's consolidation column:
+  M e = alpha (dp - mean(dp)), M = E(1-nu)/((1+nu)(1-2nu)),
+  where dp is the pressure change of the cell and the mean is taken
+  over the column (the column length does not change).
+  The volumetric strain of the simulator must satisfy this relation
+  with its final pressure.
+ */
+
+#include <deal.II/base/utilities.h>
+
+// Custom modules
+#include <Simulator.hpp>
+
+
+namespace WingTest
+{
+  using namespace dealii;
+
+
+  template <int dim>
+  class TestFixedStress
+  {
+  public:
+    TestFixedStress(std::string);
+    void run();
+
+  private:
+    MPI_Comm                                  mpi_communicator;
+    ConditionalOStream                        pcout;
+    Model::Model<dim>                         model;
+    std::string                               input_file;
+  };
+
+
+  template <int dim>
+  TestFixedStress<dim>::TestFixedStress(std::string input_file_name_)
+    :
+    mpi_communicator(MPI_COMM_WORLD),
+    pcout(std::cout, (Utilities::MPI::this_mpi_process(mpi_communicator) == 0)),
+    model(mpi_communicator, pcout),
+    input_file(input_file_name_)
+  {}
+
+
+  template <int dim>
+  void TestFixedStress<dim>::run()
+  {
+    // the model parameters of the reference
+    Parsers::Reader reader(pcout, model);
+    reader.read_input(input_file, /* verbosity= */0);
+    AssertThrow(model.has_mechanics() &&
+                model.fluid_model_type() == Model::ModelType::SingleLiquid,
+                ExcMessage("Wrong model type"));
+
+    Wings::Simulator<dim> simulator(input_file);
+    simulator.run();
+
+    const TrilinosWrappers::MPI::Vector &pressure = simulator.get_pressure();
+    const TrilinosWrappers::MPI::Vector &strain = simulator.get_volumetric_strain();
+    // the simulator starts from a uniform pressure, see Simulator::run
+    const double initial_pressure = 1000*model.units.pressure();
+
+    // mean pressure change over the cells of equal volume
+    double mean_change = pressure.mean_value() - initial_pressure;
+    AssertThrow(mean_change > 0, ExcMessage("Injection does not raise the pressure"));
+
+    std::vector<types::global_dof_index> dof_indices(1);
+    double max_strain = 0, max_error = 0;
+    typename DoFHandler<dim>::active_cell_iterator
+        cell = simulator.get_dof_handler().begin_active(),
+        endc = simulator.get_dof_handler().end();
+    for (; cell!=endc; ++cell)
+      if (cell->is_locally_owned())
+      {
+        cell->get_dof_indices(dof_indices);
+        const double E = model.get_young_modulus->value(cell->center());
+        const double nu = model.get_poisson_ratio->value(cell->center());
+        const double M = E*(1.0 - nu)/(1.0 + nu)/(1.0 - 2.0*nu);
+        const double dp = pressure[dof_indices[0]] - initial_pressure;
+        const double reference = model.biot_coefficient*(dp - mean_change)/M;
+        max_strain = std::max(max_strain, std::abs(reference));
+        max_error = std::max(max_error,
+                             std::abs(strain[dof_indices[0]] - reference));
+      }
+    max_strain = Utilities::MPI::max(max_strain, mpi_communicator);
+    max_error = Utilities::MPI::max(max_error, mpi_communicator);
+
+    AssertThrow(max_strain > 0,
+                ExcMessage("Pressure change is uniform, nothing to compare"));
+    AssertThrow(max_error < 1e-6*max_strain,
+                ExcMessage("Volumetric strain does not match the uniaxial strain: "
+                           "relative error " + std::to_string(max_error/max_strain)));
+  } // eom
+
+} // end of namespace
+
+
+int main(int argc, char *argv[])
+{
+  try
+  {
+    using namespace dealii;
+    dealii::deallog.depth_console (0);
+    Utilities::MPI::MPI_InitFinalize mpi_initialization(argc, argv, 1);
+    std::string input_file_name = SOURCE_DIR "/../data/column-1x1x10.data";
+    WingTest::TestFixedStress<3> problem(input_file_name);
+    problem.run();
+    return 0;
+  }
+  catch (std::exception &exc)
+    {
+      std::cerr << std::endl << std::endl
+                << "----------------------------------------------------"
+                << std::endl;
+      std::cerr << "Exception on processing: " << std::endl
+                << exc.what() << std::endl
+                << "Aborting!" << std::endl
+                << "----------------------------------------------------"
+                << std::endl;
+      return 1;
+    }
+}
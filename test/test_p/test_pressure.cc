@@ -172,7 +172,7 @@ namespace WingTest
     model.update_well_productivities(pressure_function, saturation_function);
     model.update_well_controls(time);
 
-    CellValues::CellValuesBase<dim>
+    CellValues::CellValuesBase<dim,Model::ModelType::SingleLiquid>
       cell_values(model), neighbor_values(model);
     pressure_solver.assemble_system(cell_values, neighbor_values, time_step,
                                     saturation_solver.relevant_solution);
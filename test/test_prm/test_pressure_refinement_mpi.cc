@@ -221,7 +221,7 @@ namespace Wings
     // pcout << "wells checked " << std::endl;
 
 
-    CellValues::CellValuesBase<dim>
+    CellValues::CellValuesBase<dim,Model::ModelType::SingleLiquid>
       cell_values(data), neighbor_values(data);
     pressure_solver.assemble_system(cell_values, neighbor_values, time_step,
                                     saturation_solver.relevant_solution);
@@ -0,0 +1,245 @@
+/*
+  This test runs a Buckley-Leverett displacement with every saturation
+  solver. The input is bl-102x1x1.data: a row of 102 cells with a water
+  injector in the first and a producer in the last cell; the test runs
+  on two processes, so the front crosses a subdomain boundary.
+
+  Testing:
+  the IMPES steps are taken like in Simulator::run_time_loop with the
+  explicit, reordering, adaptive implicit, and local time stepping
+  saturation solvers, starting from the same initial state.
+  Each solver must conserve the injected water, keep the saturation
+  within the mobile range, and place the front where the explicit
+  solver places it.
+ */
+
+#include <deal.II/base/utilities.h>
+#include <deal.II/base/conditional_ostream.h>
+#include <deal.II/grid/grid_in.h>
+#include <deal.II/grid/grid_tools.h>
+#include <deal.II/distributed/tria.h>
+
+// Custom modules
+#include <Model.hpp>
+#include <Reader.hpp>
+#include <PressureSolver.hpp>
+#include <SaturationSolver.hpp>
+#include <CellValues/CellValuesBase.hpp>
+#include <CellValues/CellValuesSaturation.hpp>
+#include <FEFunction/FEFunction.hpp>
+
+
+namespace WingTest
+{
+  using namespace dealii;
+
+
+  template <int dim>
+  class TestTransport
+  {
+  public:
+    TestTransport(std::string);
+    void read_mesh();
+    void run();
+
+  private:
+    // water volume and front position after t_max with the given solver
+    void run_solver(const Model::SaturationSolverType   solver_type,
+                    FluidSolvers::SaturationSolver<dim> &saturation_solver,
+                    double                              &water_volume,
+                    double                              &front);
+
+    MPI_Comm                                  mpi_communicator;
+    parallel::distributed::Triangulation<dim> triangulation;
+    ConditionalOStream                        pcout;
+    Model::Model<dim>                         model;
+    FluidSolvers::PressureSolver<dim>         pressure_solver;
+    std::string                               input_file;
+  };
+
+
+  template <int dim>
+  TestTransport<dim>::TestTransport(std::string input_file_name_)
+    :
+    mpi_communicator(MPI_COMM_WORLD),
+    triangulation(mpi_communicator),
+    pcout(std::cout, (Utilities::MPI::this_mpi_process(mpi_communicator) == 0)),
+    model(mpi_communicator, pcout),
+    pressure_solver(mpi_communicator, triangulation, model, pcout),
+    input_file(input_file_name_)
+  {}
+
+
+  template <int dim>
+  void TestTransport<dim>::read_mesh()
+  {
+    GridIn<dim> gridin;
+    gridin.attach_triangulation(triangulation);
+    std::ifstream f(model.mesh_file.string());
+    gridin.read_msh(f);
+    GridTools::scale(model.units.length(), triangulation);
+  }  // eom
+
+
+  template <int dim>
+  void TestTransport<dim>::
+  run_solver(const Model::SaturationSolverType   solver_type,
+             FluidSolvers::SaturationSolver<dim> &saturation_solver,
+             double                              &water_volume,
+             double                              &front)
+  {
+    model.saturation_solver_type = solver_type;
+
+    // initial state
+    saturation_solver.solution[0] = model.residual_saturation_water();
+    saturation_solver.solution[1] = 1.0 - model.residual_saturation_water();
+    for (unsigned int p=0; p<saturation_solver.n_phases; ++p)
+      saturation_solver.relevant_solution[p] = saturation_solver.solution[p];
+    pressure_solver.solution = 1000*model.units.pressure();
+    pressure_solver.relevant_solution = pressure_solver.solution;
+
+    const Model::ModelType type = Model::ModelType::WaterOil;
+    CellValues::CellValuesBase<dim,type> cell_values(model),
+                                         neighbor_values(model);
+    CellValues::CellValuesSaturation<dim,type> cell_values_saturation(model);
+
+    FEFunction::FEFunction<dim,TrilinosWrappers::MPI::Vector>
+        pressure_function(pressure_solver.get_dof_handler(),
+                          pressure_solver.relevant_solution);
+    FEFunction::FEFunction<dim,TrilinosWrappers::MPI::Vector>
+        saturation_function(pressure_solver.get_dof_handler(),
+                            saturation_solver.relevant_solution);
+
+    const double time_step = model.min_time_step;
+    double time = 0;
+    while (time < model.t_max)
+    {
+      time += time_step;
+      pressure_solver.old_solution = pressure_solver.solution;
+      model.update_well_controls(time);
+      model.update_well_productivities(pressure_function, saturation_function);
+
+      pressure_solver.assemble_system(cell_values, neighbor_values, time_step,
+                                      saturation_solver.relevant_solution);
+      pressure_solver.solve();
+      pressure_solver.relevant_solution = pressure_solver.solution;
+
+      saturation_solver.solve(cell_values_saturation,
+                              pressure_solver.get_faces(),
+                              time_step,
+                              pressure_solver.relevant_solution,
+                              pressure_solver.old_solution);
+      for (unsigned int p=0; p<saturation_solver.n_phases; ++p)
+        saturation_solver.relevant_solution[p] = saturation_solver.solution[p];
+    }
+
+    // the front is the farthest cell the water has reached
+    const double Sw_crit = model.residual_saturation_water();
+    const double Sw_max = 1.0 - model.residual_saturation_oil();
+    water_volume = 0;
+    front = 0;
+    std::vector<types::global_dof_index> dof_indices(1);
+    typename DoFHandler<dim>::active_cell_iterator
+        cell = pressure_solver.get_dof_handler().begin_active(),
+        endc = pressure_solver.get_dof_handler().end();
+    for (; cell!=endc; ++cell)
+      if (cell->is_locally_owned())
+      {
+        cell->get_dof_indices(dof_indices);
+        const double Sw = saturation_solver.solution[0][dof_indices[0]];
+        AssertThrow(Sw > Sw_crit - DefaultValues::small_number &&
+                    Sw < Sw_max + DefaultValues::small_number,
+                    ExcMessage("Saturation out of the mobile range"));
+        water_volume += (Sw - Sw_crit)*cell->measure()*
+            model.get_porosity->value(cell->center());
+        if (Sw > Sw_crit + 0.05)
+          front = std::max(front, cell->center()[0]);
+      }
+    water_volume = Utilities::MPI::sum(water_volume, mpi_communicator);
+    front = Utilities::MPI::max(front, mpi_communicator);
+  }  // eom
+
+
+  template <int dim>
+  void TestTransport<dim>::run()
+  {
+    Parsers::Reader reader(pcout, model);
+    reader.read_input(input_file, /* verbosity= */0);
+    read_mesh();
+
+    AssertThrow(model.fluid_model_type() == Model::ModelType::WaterOil,
+                ExcMessage("Wrong model type"));
+    AssertThrow(Utilities::MPI::n_mpi_processes(mpi_communicator) > 1,
+                ExcMessage("Run the test on several processes"));
+
+    FluidSolvers::SaturationSolver<dim>
+        saturation_solver(mpi_communicator,
+                          pressure_solver.get_dof_handler(),
+                          model, pcout);
+    pressure_solver.setup_dofs();
+    saturation_solver.setup_dofs(pressure_solver.locally_owned_dofs,
+                                 pressure_solver.locally_relevant_dofs);
+    model.locate_wells(pressure_solver.get_dof_handler());
+
+    // injected water volume (incompressible estimate)
+    model.update_well_controls(0);
+    const double injected =
+        std::abs(model.wells[0].get_control().value)*model.t_max;
+    // the fronts may differ by the smearing of a few cells
+    const double length = 510*model.units.length();
+    const double front_tolerance = 0.05*length;
+
+    double explicit_volume, explicit_front;
+    run_solver(Model::SaturationSolverType::Explicit, saturation_solver,
+               explicit_volume, explicit_front);
+    AssertThrow(Math::relative_difference(explicit_volume, injected) < 1e-2,
+                ExcMessage("Explicit solver does not conserve water"));
+    AssertThrow(explicit_front > 0.1*length && explicit_front < 0.9*length,
+                ExcMessage("Front is not inside the domain"));
+
+    const Model::SaturationSolverType implicit_solvers[] =
+      {Model::SaturationSolverType::Reordering,
+       Model::SaturationSolverType::Adaptive,
+       Model::SaturationSolverType::LocalTimeStepping};
+    for (const auto solver_type : implicit_solvers)
+    {
+      double water_volume, front;
+      run_solver(solver_type, saturation_solver, water_volume, front);
+      // faces between the subdomains must not create or lose water
+      AssertThrow(Math::relative_difference(water_volume, explicit_volume) < 1e-3,
+                  ExcMessage("Saturation solver " + std::to_string(solver_type) +
+                             " does not conserve water"));
+      AssertThrow(std::abs(front - explicit_front) < front_tolerance,
+                  ExcMessage("Saturation solver " + std::to_string(solver_type) +
+                             " moves the front differently"));
+    }
+  } // eom
+
+} // end of namespace
+
+
+int main(int argc, char *argv[])
+{
+  try
+  {
+    using namespace dealii;
+    dealii::deallog.depth_console (0);
+    Utilities::MPI::MPI_InitFinalize mpi_initialization(argc, argv, 1);
+    std::string input_file_name = SOURCE_DIR "/../data/bl-102x1x1.data";
+    WingTest::TestTransport<3> problem(input_file_name);
+    problem.run();
+    return 0;
+  }
+  catch (std::exception &exc)
+    {
+      std::cerr << std::endl << std::endl
+                << "----------------------------------------------------"
+                << std::endl;
+      std::cerr << "Exception on processing: " << std::endl
+                << exc.what() << std::endl
+                << "Aborting!" << std::endl
+                << "----------------------------------------------------"
+                << std::endl;
+      return 1;
+    }
+}